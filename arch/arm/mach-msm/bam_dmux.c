@@ -65,6 +65,8 @@ static uint32_t bam_dmux_write_cpy_cnt;
 static uint32_t bam_dmux_write_cpy_bytes;
 static uint32_t bam_dmux_tx_sps_failure_cnt;
 static uint32_t bam_dmux_tx_stall_cnt;
+static uint32_t bam_dmux_rx_copybreak_cnt;
+static uint32_t bam_dmux_rx_recycle_cnt;
 
 #define DBG(x...) do {		                 \
 		if (msm_bam_dmux_debug_enable)  \
@@ -102,6 +104,14 @@ static uint32_t bam_dmux_tx_stall_cnt;
 	bam_dmux_tx_stall_cnt++; \
 } while (0)
 
+#define DBG_INC_RX_COPYBREAK_CNT() do { \
+	bam_dmux_rx_copybreak_cnt++; \
+} while (0)
+
+#define DBG_INC_RX_RECYCLE_CNT() do { \
+	bam_dmux_rx_recycle_cnt++; \
+} while (0)
+
 #else
 #define DBG(x...) do { } while (0)
 #define DBG_INC_READ_CNT(x...) do { } while (0)
@@ -109,6 +119,8 @@ static uint32_t bam_dmux_tx_stall_cnt;
 #define DBG_INC_WRITE_CPY(x...) do { } while (0)
 #define DBG_INC_TX_SPS_FAILURE_CNT() do { } while (0)
 #define DBG_INC_TX_STALL_CNT() do { } while (0)
+#define DBG_INC_RX_COPYBREAK_CNT() do { } while (0)
+#define DBG_INC_RX_RECYCLE_CNT() do { } while (0)
 #endif
 
 struct bam_ch_info {
@@ -147,6 +159,7 @@ struct rx_pkt_info {
 #define A2_PHYS_SIZE		0x2000
 #define BUFFER_SIZE		2048
 #define NUM_BUFFERS		32
+#define MAX_NUM_BUFFERS		128	/* rx descriptor fifo holds 255 */
 static struct sps_bam_props a2_props;
 static u32 a2_device_handle;
 static struct sps_pipe *bam_tx_pipe;
@@ -166,6 +179,8 @@ static int polling_mode;
 static LIST_HEAD(bam_rx_pool);
 static DEFINE_MUTEX(bam_rx_pool_mutexlock);
 static int bam_rx_pool_len;
+/* grows to MAX_NUM_BUFFERS while the rx pipe is busy enough to poll */
+static int bam_rx_pool_target = NUM_BUFFERS;
 static LIST_HEAD(bam_tx_pool);
 static DEFINE_SPINLOCK(bam_tx_pool_spinlock);
 static DEFINE_MUTEX(bam_pdev_mutexlock);
@@ -179,6 +194,26 @@ struct bam_mux_hdr {
 	uint16_t pkt_len;
 };
 
+/* data packets up to this size are copied out and their buffer recycled */
+static int rx_copybreak = 256;
+
+static int rx_copybreak_set(const char *val, struct kernel_param *kp)
+{
+	int ret, copybreak;
+
+	ret = kstrtoint(val, 0, &copybreak);
+	if (ret)
+		return ret;
+	/* a copied packet still has to fit in the rx buffer */
+	if (copybreak < 0 ||
+	    copybreak > BUFFER_SIZE - (int)sizeof(struct bam_mux_hdr))
+		return -EINVAL;
+	rx_copybreak = copybreak;
+	return 0;
+}
+module_param_call(rx_copybreak, rx_copybreak_set, param_get_int,
+		  &rx_copybreak, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static void notify_all(int event, unsigned long data);
 static void bam_mux_write_done(struct work_struct *work);
 static void handle_bam_mux_cmd(struct work_struct *work);
@@ -379,7 +414,7 @@ static void queue_rx(void)
 	rx_len_cached = bam_rx_pool_len;
 	mutex_unlock(&bam_rx_pool_mutexlock);
 
-	while (rx_len_cached < NUM_BUFFERS) {
+	while (rx_len_cached < bam_rx_pool_target) {
 		if (in_global_reset)
 			goto fail;
 
@@ -442,14 +477,82 @@ fail:
 	}
 }
 
-static void bam_mux_process_data(struct sk_buff *rx_skb)
+/*
+ * Give a receive buffer whose contents have been consumed in place back to
+ * the BAM.  The buffer stays mapped, so this costs a cache sync instead of
+ * an skb allocation and a fresh dma_map_single().
+ */
+static void bam_mux_recycle_rx(struct rx_pkt_info *info)
+{
+	int ret;
+
+	mutex_lock(&bam_rx_pool_mutexlock);
+	if (in_global_reset || bam_rx_pool_len >= bam_rx_pool_target)
+		goto free;
+
+	dma_sync_single_for_device(NULL, info->dma_address, BUFFER_SIZE,
+					DMA_FROM_DEVICE);
+	list_add_tail(&info->list_node, &bam_rx_pool);
+	++bam_rx_pool_len;
+	ret = sps_transfer_one(bam_rx_pipe, info->dma_address,
+		BUFFER_SIZE, info,
+		SPS_IOVEC_FLAG_INT | SPS_IOVEC_FLAG_EOT);
+	if (ret) {
+		list_del(&info->list_node);
+		--bam_rx_pool_len;
+		DMUX_LOG_KERR("%s: sps_transfer_one failed %d\n",
+			__func__, ret);
+		goto free;
+	}
+	mutex_unlock(&bam_rx_pool_mutexlock);
+	DBG_INC_RX_RECYCLE_CNT();
+	queue_rx();
+	return;
+
+free:
+	mutex_unlock(&bam_rx_pool_mutexlock);
+	dma_unmap_single(NULL, info->dma_address, BUFFER_SIZE,
+				DMA_FROM_DEVICE);
+	dev_kfree_skb_any(info->skb);
+	kfree(info);
+	queue_rx();
+}
+
+static void bam_mux_process_data(struct rx_pkt_info *info)
 {
 	unsigned long flags;
 	struct bam_mux_hdr *rx_hdr;
 	unsigned long event_data;
+	struct sk_buff *rx_skb = info->skb;
 
 	rx_hdr = (struct bam_mux_hdr *)rx_skb->data;
 
+	/* small packets are copied so the mapped buffer can be reused */
+	if (rx_hdr->pkt_len <= rx_copybreak) {
+		struct sk_buff *skb = __dev_alloc_skb(rx_hdr->pkt_len,
+							GFP_KERNEL);
+
+		if (skb) {
+			memcpy(skb_put(skb, rx_hdr->pkt_len), rx_hdr + 1,
+				rx_hdr->pkt_len);
+			DBG_INC_RX_COPYBREAK_CNT();
+			spin_lock_irqsave(&bam_ch[rx_hdr->ch_id].lock, flags);
+			if (bam_ch[rx_hdr->ch_id].notify)
+				bam_ch[rx_hdr->ch_id].notify(
+					bam_ch[rx_hdr->ch_id].priv,
+					BAM_DMUX_RECEIVE, (unsigned long)skb);
+			else
+				dev_kfree_skb_any(skb);
+			spin_unlock_irqrestore(&bam_ch[rx_hdr->ch_id].lock,
+						flags);
+			bam_mux_recycle_rx(info);
+			return;
+		}
+	}
+
+	dma_unmap_single(NULL, info->dma_address, BUFFER_SIZE, DMA_FROM_DEVICE);
+	kfree(info);
+
 	rx_skb->data = (unsigned char *)(rx_hdr + 1);
 	rx_skb->tail = rx_skb->data + rx_hdr->pkt_len;
 	rx_skb->len = rx_hdr->pkt_len;
@@ -503,8 +606,9 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 
 	info = container_of(work, struct rx_pkt_info, work);
 	rx_skb = info->skb;
-	dma_unmap_single(NULL, info->dma_address, BUFFER_SIZE, DMA_FROM_DEVICE);
-	kfree(info);
+	/* unmapped only if the buffer is handed up, see bam_mux_process_data */
+	dma_sync_single_for_cpu(NULL, info->dma_address, BUFFER_SIZE,
+				DMA_FROM_DEVICE);
 
 	rx_hdr = (struct bam_mux_hdr *)rx_skb->data;
 
@@ -518,8 +622,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			" pad %d ch %d len %d\n", __func__,
 			rx_hdr->magic_num, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
-		queue_rx();
+		bam_mux_recycle_rx(info);
 		return;
 	}
 
@@ -529,15 +632,14 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			" pad %d ch %d len %d\n", __func__,
 			rx_hdr->ch_id, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
-		queue_rx();
+		bam_mux_recycle_rx(info);
 		return;
 	}
 
 	switch (rx_hdr->cmd) {
 	case BAM_MUX_HDR_CMD_DATA:
 		DBG_INC_READ_CNT(rx_hdr->pkt_len);
-		bam_mux_process_data(rx_skb);
+		bam_mux_process_data(info);
 		break;
 	case BAM_MUX_HDR_CMD_OPEN:
 		bam_dmux_log("%s: opening cid %d PC enabled\n", __func__,
@@ -547,7 +649,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			bam_dmux_log("%s: activating disconnect ack\n");
 			disconnect_ack = 1;
 		}
-		dev_kfree_skb_any(rx_skb);
+		bam_mux_recycle_rx(info);
 		break;
 	case BAM_MUX_HDR_CMD_OPEN_NO_A2_PC:
 		bam_dmux_log("%s: opening cid %d PC disabled\n", __func__,
@@ -559,7 +661,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 		}
 
 		handle_bam_mux_cmd_open(rx_hdr);
-		dev_kfree_skb_any(rx_skb);
+		bam_mux_recycle_rx(info);
 		break;
 	case BAM_MUX_HDR_CMD_CLOSE:
 		/* probably should drop pending write */
@@ -570,6 +672,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			bam_dmux_log("%s: close cid %d aborted due to ssr\n",
 					__func__, rx_hdr->ch_id);
 			mutex_unlock(&bam_pdev_mutexlock);
+			bam_mux_recycle_rx(info);
 			break;
 		}
 		spin_lock_irqsave(&bam_ch[rx_hdr->ch_id].lock, flags);
@@ -581,8 +684,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 		if (!bam_ch[rx_hdr->ch_id].pdev)
 			pr_err("%s: platform_device_alloc failed\n", __func__);
 		mutex_unlock(&bam_pdev_mutexlock);
-		dev_kfree_skb_any(rx_skb);
-		queue_rx();
+		bam_mux_recycle_rx(info);
 		break;
 	default:
 		DMUX_LOG_KERR("%s: dropping invalid hdr. magic %x"
@@ -590,8 +692,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			__func__, rx_hdr->magic_num, rx_hdr->reserved,
 			rx_hdr->cmd, rx_hdr->pad_len, rx_hdr->ch_id,
 			rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
-		queue_rx();
+		bam_mux_recycle_rx(info);
 		return;
 	}
 }
@@ -1034,6 +1135,7 @@ static void rx_switch_to_interrupt_mode(void)
 		goto fail;
 	}
 	polling_mode = 0;
+	bam_rx_pool_target = NUM_BUFFERS;
 	release_wakelock();
 
 	/* handle any rx packets before interrupt was enabled */
@@ -1200,6 +1302,8 @@ static void bam_mux_rx_notify(struct sps_event_notify *notify)
 			}
 			grab_wakelock();
 			polling_mode = 1;
+			/* refills from the rx work grow the ring while busy */
+			bam_rx_pool_target = MAX_NUM_BUFFERS;
 			queue_work(bam_mux_rx_workqueue, &rx_timer_work);
 		}
 		break;
@@ -1250,12 +1354,18 @@ static int debug_stats(char *buf, int max)
 			"skb copy bytes:  %u\n"
 			"sps tx failures: %u\n"
 			"sps tx stalls:   %u\n"
-			"rx queue len:    %d\n",
+			"rx queue len:    %d\n"
+			"rx queue target: %d\n"
+			"rx copybreak:    %u\n"
+			"rx recycled:     %u\n",
 			bam_dmux_write_cpy_cnt,
 			bam_dmux_write_cpy_bytes,
 			bam_dmux_tx_sps_failure_cnt,
 			bam_dmux_tx_stall_cnt,
-			bam_rx_pool_len
+			bam_rx_pool_len,
+			bam_rx_pool_target,
+			bam_dmux_rx_copybreak_cnt,
+			bam_dmux_rx_recycle_cnt
 			);
 
 	return i;
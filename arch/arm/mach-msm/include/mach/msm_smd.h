@@ -162,6 +162,49 @@ int smd_write_segment(smd_channel_t *ch, void *data, int len, int user_buf);
  */
 int smd_write_end(smd_channel_t *ch);
 
+/* Zero-copy reads.  smd_read_reserve() points @data at the next readable
+ * bytes in the fifo and returns how many are contiguous (never more than
+ * the rest of the current packet on packet channels).  Once the client is
+ * done with them, smd_read_commit() releases @len of those bytes back to
+ * the remote side.  Packet channels may not commit from the notify
+ * callback; use smd_read_from_cb() there.
+ *
+ * Returns:
+ *      number of bytes available / released
+ *      -ENODEV - invalid smd channel
+ *      -EINVAL - @len exceeds what was reserved
+ */
+int smd_read_reserve(smd_channel_t *ch, void **data);
+int smd_read_commit(smd_channel_t *ch, int len);
+
+/* Zero-copy writes.  smd_write_reserve() points @data at the next free
+ * space in the fifo and returns how many bytes are contiguous; the client
+ * fills them in place and publishes @len of them with smd_write_commit().
+ * Packet channels must first start a transaction with smd_write_start(),
+ * and a reservation never extends past the end of that packet.
+ *
+ * Returns:
+ *      number of bytes free / written
+ *      -ENODEV - invalid smd channel
+ *      -EINVAL - @len exceeds what was reserved
+ *      -ENOEXEC - packet transaction not started
+ */
+int smd_write_reserve(smd_channel_t *ch, void **data);
+int smd_write_commit(smd_channel_t *ch, int len);
+
+/* Coalesce outbound interrupts.  Between smd_batch_begin() and
+ * smd_batch_end() reads and writes on the channel do not interrupt the
+ * remote processor; smd_batch_end() raises a single interrupt if any were
+ * held back.  Batches nest, and the caller serializes them per channel.
+ *
+ * Returns:
+ *      0 - success
+ *      -ENODEV - invalid smd channel
+ *      -ENOEXEC - smd_batch_end() without a matching smd_batch_begin()
+ */
+int smd_batch_begin(smd_channel_t *ch);
+int smd_batch_end(smd_channel_t *ch);
+
 #else
 
 static inline int smd_open(const char *name, smd_channel_t **ch, void *priv,
@@ -263,6 +306,36 @@ static inline int smd_write_end(smd_channel_t *ch)
 {
 	return -ENODEV;
 }
+
+static inline int smd_read_reserve(smd_channel_t *ch, void **data)
+{
+	return -ENODEV;
+}
+
+static inline int smd_read_commit(smd_channel_t *ch, int len)
+{
+	return -ENODEV;
+}
+
+static inline int smd_write_reserve(smd_channel_t *ch, void **data)
+{
+	return -ENODEV;
+}
+
+static inline int smd_write_commit(smd_channel_t *ch, int len)
+{
+	return -ENODEV;
+}
+
+static inline int smd_batch_begin(smd_channel_t *ch)
+{
+	return -ENODEV;
+}
+
+static inline int smd_batch_end(smd_channel_t *ch)
+{
+	return -ENODEV;
+}
 #endif
 
 #endif
@@ -27,6 +27,9 @@
 #include <linux/platform_device.h>
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
+#include <linux/jhash.h>
+#include <linux/rwsem.h>
+#include <linux/ktime.h>
 
 #include <asm/uaccess.h>
 #include <asm/byteorder.h>
@@ -92,13 +95,24 @@ if (msm_ipc_router_debug_mask & R2R_RAW_HDR) \
 static LIST_HEAD(control_ports);
 static DEFINE_MUTEX(control_ports_lock);
 
-#define LP_HASH_SIZE 32
+/*
+ * Lookups of ports, servers and nodes happen for every message, so the
+ * tables are read-mostly: lookups share the rw_semaphores and only
+ * insertion and removal take them exclusively.
+ */
+#define LP_HASH_SIZE 128
 static struct list_head local_ports[LP_HASH_SIZE];
-static DEFINE_MUTEX(local_ports_lock);
+static DECLARE_RWSEM(local_ports_lock);
 
-#define SRV_HASH_SIZE 32
+/*
+ * Most services register with the same few instance numbers, so the
+ * server table is keyed on the service and instance together.
+ */
+#define SRV_HASH_SIZE 64
+#define SRV_HASH_KEY(service, instance) \
+	(jhash_2words((service), (instance), 0) & (SRV_HASH_SIZE - 1))
 static struct list_head server_list[SRV_HASH_SIZE];
-static DEFINE_MUTEX(server_list_lock);
+static DECLARE_RWSEM(server_list_lock);
 static wait_queue_head_t newserver_wait;
 
 struct msm_ipc_server {
@@ -113,7 +127,7 @@ struct msm_ipc_server_port {
 	struct msm_ipc_router_xprt_info *xprt_info;
 };
 
-#define RP_HASH_SIZE 32
+#define RP_HASH_SIZE 64
 struct msm_ipc_router_remote_port {
 	struct list_head list;
 	uint32_t node_id;
@@ -140,20 +154,20 @@ struct msm_ipc_router_xprt_info {
 	struct workqueue_struct *workqueue;
 };
 
-#define RT_HASH_SIZE 4
+#define RT_HASH_SIZE 16
 struct msm_ipc_routing_table_entry {
 	struct list_head list;
 	uint32_t node_id;
 	uint32_t neighbor_node_id;
 	struct list_head remote_port_list[RP_HASH_SIZE];
 	struct msm_ipc_router_xprt_info *xprt_info;
-	struct mutex lock;
+	struct rw_semaphore lock;
 	unsigned long num_tx_bytes;
 	unsigned long num_rx_bytes;
 };
 
 static struct list_head routing_table[RT_HASH_SIZE];
-static DEFINE_MUTEX(routing_table_lock);
+static DECLARE_RWSEM(routing_table_lock);
 static int routing_table_inited;
 
 static LIST_HEAD(msm_ipc_board_dev_list);
@@ -220,7 +234,7 @@ static struct msm_ipc_routing_table_entry *alloc_routing_table_entry(
 	for (i = 0; i < RP_HASH_SIZE; i++)
 		INIT_LIST_HEAD(&rt_entry->remote_port_list[i]);
 
-	mutex_init(&rt_entry->lock);
+	init_rwsem(&rt_entry->lock);
 	rt_entry->node_id = node_id;
 	rt_entry->xprt_info = NULL;
 	return rt_entry;
@@ -235,7 +249,7 @@ static int add_routing_table_entry(
 	if (!rt_entry)
 		return -EINVAL;
 
-	key = (rt_entry->node_id % RT_HASH_SIZE);
+	key = (rt_entry->node_id & (RT_HASH_SIZE - 1));
 	list_add_tail(&rt_entry->list, &routing_table[key]);
 	return 0;
 }
@@ -244,7 +258,7 @@ static int add_routing_table_entry(
 static struct msm_ipc_routing_table_entry *lookup_routing_table(
 	uint32_t node_id)
 {
-	uint32_t key = (node_id % RT_HASH_SIZE);
+	uint32_t key = (node_id & (RT_HASH_SIZE - 1));
 	struct msm_ipc_routing_table_entry *rt_entry;
 
 	list_for_each_entry(rt_entry, &routing_table[key], list) {
@@ -390,7 +404,7 @@ static uint32_t allocate_port_id(void)
 
 	mutex_lock(&next_port_id_lock);
 	prev_port_id = next_port_id;
-	mutex_lock(&local_ports_lock);
+	down_read(&local_ports_lock);
 	do {
 		next_port_id++;
 		if ((next_port_id & 0xFFFFFFFE) == 0xFFFFFFFE)
@@ -413,7 +427,7 @@ static uint32_t allocate_port_id(void)
 		}
 		port_id = 0;
 	} while (next_port_id != prev_port_id);
-	mutex_unlock(&local_ports_lock);
+	up_read(&local_ports_lock);
 	mutex_unlock(&next_port_id_lock);
 
 	return port_id;
@@ -427,9 +441,9 @@ void msm_ipc_router_add_local_port(struct msm_ipc_port *port_ptr)
 		return;
 
 	key = (port_ptr->this_port.port_id & (LP_HASH_SIZE - 1));
-	mutex_lock(&local_ports_lock);
+	down_write(&local_ports_lock);
 	list_add_tail(&port_ptr->list, &local_ports[key]);
-	mutex_unlock(&local_ports_lock);
+	up_write(&local_ports_lock);
 }
 
 struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
@@ -473,14 +487,14 @@ static struct msm_ipc_port *msm_ipc_router_lookup_local_port(uint32_t port_id)
 	int key = (port_id & (LP_HASH_SIZE - 1));
 	struct msm_ipc_port *port_ptr;
 
-	mutex_lock(&local_ports_lock);
+	down_read(&local_ports_lock);
 	list_for_each_entry(port_ptr, &local_ports[key], list) {
 		if (port_ptr->this_port.port_id == port_id) {
-			mutex_unlock(&local_ports_lock);
+			up_read(&local_ports_lock);
 			return port_ptr;
 		}
 	}
-	mutex_unlock(&local_ports_lock);
+	up_read(&local_ports_lock);
 	return NULL;
 }
 
@@ -492,27 +506,27 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
 	struct msm_ipc_routing_table_entry *rt_entry;
 	int key = (port_id & (RP_HASH_SIZE - 1));
 
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Node is not up\n", __func__);
 		return NULL;
 	}
 
-	mutex_lock(&rt_entry->lock);
+	down_read(&rt_entry->lock);
 	list_for_each_entry(rport_ptr,
 			    &rt_entry->remote_port_list[key], list) {
 		if (rport_ptr->port_id == port_id) {
 			if (rport_ptr->restart_state != RESTART_NORMAL)
 				rport_ptr = NULL;
-			mutex_unlock(&rt_entry->lock);
-			mutex_unlock(&routing_table_lock);
+			up_read(&rt_entry->lock);
+			up_read(&routing_table_lock);
 			return rport_ptr;
 		}
 	}
-	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_read(&rt_entry->lock);
+	up_read(&routing_table_lock);
 	return NULL;
 }
 
@@ -524,20 +538,20 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 	struct msm_ipc_routing_table_entry *rt_entry;
 	int key = (port_id & (RP_HASH_SIZE - 1));
 
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Node is not up\n", __func__);
 		return NULL;
 	}
 
-	mutex_lock(&rt_entry->lock);
+	down_write(&rt_entry->lock);
 	rport_ptr = kmalloc(sizeof(struct msm_ipc_router_remote_port),
 			    GFP_KERNEL);
 	if (!rport_ptr) {
-		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
+		up_write(&rt_entry->lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Remote port alloc failed\n", __func__);
 		return NULL;
 	}
@@ -549,8 +563,8 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 	mutex_init(&rport_ptr->quota_lock);
 	list_add_tail(&rport_ptr->list,
 		      &rt_entry->remote_port_list[key]);
-	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_write(&rt_entry->lock);
+	up_read(&routing_table_lock);
 	return rport_ptr;
 }
 
@@ -564,19 +578,19 @@ static void msm_ipc_router_destroy_remote_port(
 		return;
 
 	node_id = rport_ptr->node_id;
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Node %d is not up\n", __func__, node_id);
 		return;
 	}
 
-	mutex_lock(&rt_entry->lock);
+	down_write(&rt_entry->lock);
 	list_del(&rport_ptr->list);
 	kfree(rport_ptr);
-	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_write(&rt_entry->lock);
+	up_read(&routing_table_lock);
 	return;
 }
 
@@ -588,27 +602,27 @@ static struct msm_ipc_server *msm_ipc_router_lookup_server(
 {
 	struct msm_ipc_server *server;
 	struct msm_ipc_server_port *server_port;
-	int key = (instance & (SRV_HASH_SIZE - 1));
+	int key = SRV_HASH_KEY(service, instance);
 
-	mutex_lock(&server_list_lock);
+	down_read(&server_list_lock);
 	list_for_each_entry(server, &server_list[key], list) {
 		if ((server->name.service != service) ||
 		    (server->name.instance != instance))
 			continue;
 		if ((node_id == 0) && (port_id == 0)) {
-			mutex_unlock(&server_list_lock);
+			up_read(&server_list_lock);
 			return server;
 		}
 		list_for_each_entry(server_port, &server->server_port_list,
 				    list) {
 			if ((server_port->server_addr.node_id == node_id) &&
 			    (server_port->server_addr.port_id == port_id)) {
-				mutex_unlock(&server_list_lock);
+				up_read(&server_list_lock);
 				return server;
 			}
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_read(&server_list_lock);
 	return NULL;
 }
 
@@ -621,9 +635,9 @@ static struct msm_ipc_server *msm_ipc_router_create_server(
 {
 	struct msm_ipc_server *server = NULL;
 	struct msm_ipc_server_port *server_port;
-	int key = (instance & (SRV_HASH_SIZE - 1));
+	int key = SRV_HASH_KEY(service, instance);
 
-	mutex_lock(&server_list_lock);
+	down_write(&server_list_lock);
 	list_for_each_entry(server, &server_list[key], list) {
 		if ((server->name.service == service) &&
 		    (server->name.instance == instance))
@@ -632,7 +646,7 @@ static struct msm_ipc_server *msm_ipc_router_create_server(
 
 	server = kmalloc(sizeof(struct msm_ipc_server), GFP_KERNEL);
 	if (!server) {
-		mutex_unlock(&server_list_lock);
+		up_write(&server_list_lock);
 		pr_err("%s: Server allocation failed\n", __func__);
 		return NULL;
 	}
@@ -648,7 +662,7 @@ create_srv_port:
 			list_del(&server->list);
 			kfree(server);
 		}
-		mutex_unlock(&server_list_lock);
+		up_write(&server_list_lock);
 		pr_err("%s: Server Port allocation failed\n", __func__);
 		return NULL;
 	}
@@ -656,7 +670,7 @@ create_srv_port:
 	server_port->server_addr.port_id = port_id;
 	server_port->xprt_info = xprt_info;
 	list_add_tail(&server_port->list, &server->server_port_list);
-	mutex_unlock(&server_list_lock);
+	up_write(&server_list_lock);
 
 	return server;
 }
@@ -669,7 +683,7 @@ static void msm_ipc_router_destroy_server(struct msm_ipc_server *server,
 	if (!server)
 		return;
 
-	mutex_lock(&server_list_lock);
+	down_write(&server_list_lock);
 	list_for_each_entry(server_port, &server->server_port_list, list) {
 		if ((server_port->server_addr.node_id == node_id) &&
 		    (server_port->server_addr.port_id == port_id))
@@ -683,7 +697,7 @@ static void msm_ipc_router_destroy_server(struct msm_ipc_server *server,
 		list_del(&server->list);
 		kfree(server);
 	}
-	mutex_unlock(&server_list_lock);
+	up_write(&server_list_lock);
 	return;
 }
 
@@ -778,7 +792,7 @@ static int msm_ipc_router_send_server_list(
 
 	ctl.cmd = IPC_ROUTER_CTRL_CMD_NEW_SERVER;
 
-	mutex_lock(&server_list_lock);
+	down_read(&server_list_lock);
 	for (i = 0; i < SRV_HASH_SIZE; i++) {
 		list_for_each_entry(server, &server_list[i], list) {
 			ctl.srv.service = server->name.service;
@@ -798,7 +812,7 @@ static int msm_ipc_router_send_server_list(
 			}
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_read(&server_list_lock);
 
 	return 0;
 }
@@ -958,36 +972,36 @@ static int forward_msg(struct msm_ipc_router_xprt_info *xprt_info,
 
 	hdr = (struct rr_header *)head_pkt->data;
 	dst_node_id = hdr->dst_node_id;
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(dst_node_id);
 	if (!(rt_entry) || !(rt_entry->xprt_info)) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Routing table not initialized\n", __func__);
 		return -ENODEV;
 	}
 
-	mutex_lock(&rt_entry->lock);
+	down_read(&rt_entry->lock);
 	fwd_xprt_info = rt_entry->xprt_info;
 	mutex_lock(&fwd_xprt_info->tx_lock);
 	if (xprt_info->remote_node_id == fwd_xprt_info->remote_node_id) {
 		mutex_unlock(&fwd_xprt_info->tx_lock);
-		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
+		up_read(&rt_entry->lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Discarding Command to route back\n", __func__);
 		return -EINVAL;
 	}
 
 	if (xprt_info->xprt->link_id == fwd_xprt_info->xprt->link_id) {
 		mutex_unlock(&fwd_xprt_info->tx_lock);
-		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
+		up_read(&rt_entry->lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: DST in the same cluster\n", __func__);
 		return 0;
 	}
 	fwd_xprt_info->xprt->write(pkt, pkt->length, 0);
 	mutex_unlock(&fwd_xprt_info->tx_lock);
-	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_read(&rt_entry->lock);
+	up_read(&routing_table_lock);
 
 	return 0;
 }
@@ -1023,7 +1037,7 @@ static void msm_ipc_cleanup_remote_server_info(
 	}
 
 	ctl.cmd = IPC_ROUTER_CTRL_CMD_REMOVE_SERVER;
-	mutex_lock(&server_list_lock);
+	down_write(&server_list_lock);
 	for (i = 0; i < SRV_HASH_SIZE; i++) {
 		list_for_each_entry_safe(svr, tmp_svr, &server_list[i], list) {
 			ctl.srv.service = svr->name.service;
@@ -1052,7 +1066,7 @@ static void msm_ipc_cleanup_remote_server_info(
 			}
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_write(&server_list_lock);
 }
 
 static void msm_ipc_cleanup_remote_client_info(
@@ -1069,12 +1083,12 @@ static void msm_ipc_cleanup_remote_client_info(
 	}
 
 	ctl.cmd = IPC_ROUTER_CTRL_CMD_REMOVE_CLIENT;
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	for (i = 0; i < RT_HASH_SIZE; i++) {
 		list_for_each_entry(rt_entry, &routing_table[i], list) {
-			mutex_lock(&rt_entry->lock);
+			down_write(&rt_entry->lock);
 			if (rt_entry->xprt_info != xprt_info) {
-				mutex_unlock(&rt_entry->lock);
+				up_write(&rt_entry->lock);
 				continue;
 			}
 			for (j = 0; j < RP_HASH_SIZE; j++) {
@@ -1092,10 +1106,10 @@ static void msm_ipc_cleanup_remote_client_info(
 					broadcast_ctl_msg_locally(&ctl);
 				}
 			}
-			mutex_unlock(&rt_entry->lock);
+			up_write(&rt_entry->lock);
 		}
 	}
-	mutex_unlock(&routing_table_lock);
+	up_read(&routing_table_lock);
 }
 
 static void msm_ipc_cleanup_remote_port_info(uint32_t node_id)
@@ -1104,13 +1118,13 @@ static void msm_ipc_cleanup_remote_port_info(uint32_t node_id)
 	struct msm_ipc_router_remote_port *rport_ptr, *tmp_rport_ptr;
 	int i, j;
 
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	for (i = 0; i < RT_HASH_SIZE; i++) {
 		list_for_each_entry_safe(rt_entry, tmp_rt_entry,
 					 &routing_table[i], list) {
-			mutex_lock(&rt_entry->lock);
+			down_write(&rt_entry->lock);
 			if (rt_entry->neighbor_node_id != node_id) {
-				mutex_unlock(&rt_entry->lock);
+				up_write(&rt_entry->lock);
 				continue;
 			}
 			for (j = 0; j < RP_HASH_SIZE; j++) {
@@ -1121,10 +1135,10 @@ static void msm_ipc_cleanup_remote_port_info(uint32_t node_id)
 					kfree(rport_ptr);
 				}
 			}
-			mutex_unlock(&rt_entry->lock);
+			up_write(&rt_entry->lock);
 		}
 	}
-	mutex_unlock(&routing_table_lock);
+	up_read(&routing_table_lock);
 }
 
 static void msm_ipc_cleanup_routing_table(
@@ -1138,16 +1152,16 @@ static void msm_ipc_cleanup_routing_table(
 		return;
 	}
 
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	for (i = 0; i < RT_HASH_SIZE; i++) {
 		list_for_each_entry(rt_entry, &routing_table[i], list) {
-			mutex_lock(&rt_entry->lock);
+			down_write(&rt_entry->lock);
 			if (rt_entry->xprt_info == xprt_info)
 				rt_entry->xprt_info = NULL;
-			mutex_unlock(&rt_entry->lock);
+			up_write(&rt_entry->lock);
 		}
 	}
-	mutex_unlock(&routing_table_lock);
+	up_read(&routing_table_lock);
 }
 
 static void modem_reset_cleanup(struct msm_ipc_router_xprt_info *xprt_info)
@@ -1199,23 +1213,23 @@ static int process_control_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		RR("o HELLO NID %d\n", hdr->src_node_id);
 		xprt_info->remote_node_id = hdr->src_node_id;
 
-		mutex_lock(&routing_table_lock);
+		down_write(&routing_table_lock);
 		rt_entry = lookup_routing_table(hdr->src_node_id);
 		if (!rt_entry) {
 			rt_entry = alloc_routing_table_entry(hdr->src_node_id);
 			if (!rt_entry) {
-				mutex_unlock(&routing_table_lock);
+				up_write(&routing_table_lock);
 				pr_err("%s: rt_entry allocation failed\n",
 					__func__);
 				return -ENOMEM;
 			}
 			add_routing_table_entry(rt_entry);
 		}
-		mutex_lock(&rt_entry->lock);
+		down_write(&rt_entry->lock);
 		rt_entry->neighbor_node_id = xprt_info->remote_node_id;
 		rt_entry->xprt_info = xprt_info;
-		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
+		up_write(&rt_entry->lock);
+		up_write(&routing_table_lock);
 		msm_ipc_cleanup_remote_port_info(xprt_info->remote_node_id);
 
 		memset(&ctl, 0, sizeof(ctl));
@@ -1261,23 +1275,23 @@ static int process_control_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		   msg->srv.node_id, msg->srv.port_id,
 		   msg->srv.service, msg->srv.instance);
 
-		mutex_lock(&routing_table_lock);
+		down_write(&routing_table_lock);
 		rt_entry = lookup_routing_table(msg->srv.node_id);
 		if (!rt_entry) {
 			rt_entry = alloc_routing_table_entry(msg->srv.node_id);
 			if (!rt_entry) {
-				mutex_unlock(&routing_table_lock);
+				up_write(&routing_table_lock);
 				pr_err("%s: rt_entry allocation failed\n",
 					__func__);
 				return -ENOMEM;
 			}
-			mutex_lock(&rt_entry->lock);
+			down_write(&rt_entry->lock);
 			rt_entry->neighbor_node_id = xprt_info->remote_node_id;
 			rt_entry->xprt_info = xprt_info;
-			mutex_unlock(&rt_entry->lock);
+			up_write(&rt_entry->lock);
 			add_routing_table_entry(rt_entry);
 		}
-		mutex_unlock(&routing_table_lock);
+		up_write(&routing_table_lock);
 
 		server = msm_ipc_router_lookup_server(msg->srv.service,
 						      msg->srv.instance,
@@ -1599,12 +1613,15 @@ static int loopback_data(struct msm_ipc_port *src,
 	pkt = create_pkt(data);
 	if (!pkt) {
 		pr_err("%s: New pkt create failed\n", __func__);
+		skb_queue_purge(data);
+		kfree(data);
 		return -ENOMEM;
 	}
 
 	head_skb = skb_peek(pkt->pkt_fragment_q);
 	if (!head_skb) {
 		pr_err("%s: pkt_fragment_q is empty\n", __func__);
+		release_pkt(pkt);
 		return -EINVAL;
 	}
 	hdr = (struct rr_header *)skb_push(head_skb, IPC_ROUTER_HDR_SIZE);
@@ -1702,21 +1719,21 @@ static int msm_ipc_router_write_pkt(struct msm_ipc_port *src,
 		hdr->confirm_rx = 1;
 	mutex_unlock(&rport_ptr->quota_lock);
 
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(hdr->dst_node_id);
 	if (!rt_entry || !rt_entry->xprt_info) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Remote node %d not up\n",
 			__func__, hdr->dst_node_id);
 		return -ENODEV;
 	}
-	mutex_lock(&rt_entry->lock);
+	down_read(&rt_entry->lock);
 	xprt_info = rt_entry->xprt_info;
 	mutex_lock(&xprt_info->tx_lock);
 	ret = xprt_info->xprt->write(pkt, pkt->length, 0);
 	mutex_unlock(&xprt_info->tx_lock);
-	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_read(&rt_entry->lock);
+	up_read(&routing_table_lock);
 
 	if (ret < 0) {
 		pr_err("%s: Write on XPRT failed\n", __func__);
@@ -1779,13 +1796,13 @@ int msm_ipc_router_send_to(struct msm_ipc_port *src,
 			pr_err("%s: Destination not reachable\n", __func__);
 			return -ENODEV;
 		}
-		mutex_lock(&server_list_lock);
+		down_read(&server_list_lock);
 		server_port = list_first_entry(&server->server_port_list,
 					       struct msm_ipc_server_port,
 					       list);
 		dst_node_id = server_port->server_addr.node_id;
 		dst_port_id = server_port->server_addr.port_id;
-		mutex_unlock(&server_list_lock);
+		up_read(&server_list_lock);
 	}
 	if (dst_node_id == IPC_ROUTER_NID_LOCAL) {
 		ret = loopback_data(src, dst_port_id, data);
@@ -1964,13 +1981,13 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 			msm_ipc_router_destroy_server(server,
 				port_ptr->this_port.node_id,
 				port_ptr->this_port.port_id);
-		mutex_lock(&local_ports_lock);
+		down_write(&local_ports_lock);
 		list_del(&port_ptr->list);
-		mutex_unlock(&local_ports_lock);
+		up_write(&local_ports_lock);
 	} else if (port_ptr->type == CLIENT_PORT) {
-		mutex_lock(&local_ports_lock);
+		down_write(&local_ports_lock);
 		list_del(&port_ptr->list);
-		mutex_unlock(&local_ports_lock);
+		up_write(&local_ports_lock);
 	} else if (port_ptr->type == CONTROL_PORT) {
 		mutex_lock(&control_ports_lock);
 		list_del(&port_ptr->list);
@@ -2006,9 +2023,9 @@ int msm_ipc_router_bind_control_port(struct msm_ipc_port *port_ptr)
 	if (!port_ptr)
 		return -EINVAL;
 
-	mutex_lock(&local_ports_lock);
+	down_write(&local_ports_lock);
 	list_del(&port_ptr->list);
-	mutex_unlock(&local_ports_lock);
+	up_write(&local_ports_lock);
 	port_ptr->type = CONTROL_PORT;
 	mutex_lock(&control_ports_lock);
 	list_add_tail(&port_ptr->list, &control_ports);
@@ -2024,7 +2041,7 @@ int msm_ipc_router_lookup_server_name(struct msm_ipc_port_name *srv_name,
 {
 	struct msm_ipc_server *server;
 	struct msm_ipc_server_port *server_port;
-	int key, i = 0; /*num_entries_found*/
+	int key, first_key, last_key, i = 0; /*num_entries_found*/
 
 	if (!srv_name) {
 		pr_err("%s: Invalid srv_name\n", __func__);
@@ -2036,10 +2053,19 @@ int msm_ipc_router_lookup_server_name(struct msm_ipc_port_name *srv_name,
 		return -EINVAL;
 	}
 
-	mutex_lock(&server_list_lock);
+	down_read(&server_list_lock);
 	if (!lookup_mask)
 		lookup_mask = 0xFFFFFFFF;
-	for (key = 0; key < SRV_HASH_SIZE; key++) {
+	/* an exact name lives in a single bucket */
+	if (lookup_mask == 0xFFFFFFFF) {
+		first_key = SRV_HASH_KEY(srv_name->service,
+					 srv_name->instance);
+		last_key = first_key;
+	} else {
+		first_key = 0;
+		last_key = SRV_HASH_SIZE - 1;
+	}
+	for (key = first_key; key <= last_key; key++) {
 		list_for_each_entry(server, &server_list[key], list) {
 			if ((server->name.service != srv_name->service) ||
 			    ((server->name.instance & lookup_mask) !=
@@ -2062,7 +2088,7 @@ int msm_ipc_router_lookup_server_name(struct msm_ipc_port_name *srv_name,
 			}
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_read(&server_list_lock);
 
 	return i;
 }
@@ -2089,9 +2115,9 @@ static int dump_routing_table(char *buf, int max)
 	struct msm_ipc_routing_table_entry *rt_entry;
 
 	for (j = 0; j < RT_HASH_SIZE; j++) {
-		mutex_lock(&routing_table_lock);
+		down_read(&routing_table_lock);
 		list_for_each_entry(rt_entry, &routing_table[j], list) {
-			mutex_lock(&rt_entry->lock);
+			down_read(&rt_entry->lock);
 			i += scnprintf(buf + i, max - i,
 				       "Node Id: 0x%08x\n", rt_entry->node_id);
 			if (j == IPC_ROUTER_NID_LOCAL) {
@@ -2108,9 +2134,9 @@ static int dump_routing_table(char *buf, int max)
 					rt_entry->xprt_info->remote_node_id);
 			}
 			i += scnprintf(buf + i, max - i, "\n");
-			mutex_unlock(&rt_entry->lock);
+			up_read(&rt_entry->lock);
 		}
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 	}
 
 	return i;
@@ -2144,7 +2170,7 @@ static int dump_servers(char *buf, int max)
 	struct msm_ipc_server *server;
 	struct msm_ipc_server_port *server_port;
 
-	mutex_lock(&server_list_lock);
+	down_read(&server_list_lock);
 	for (j = 0; j < SRV_HASH_SIZE; j++) {
 		list_for_each_entry(server, &server_list[j], list) {
 			list_for_each_entry(server_port,
@@ -2164,7 +2190,7 @@ static int dump_servers(char *buf, int max)
 			}
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_read(&server_list_lock);
 
 	return i;
 }
@@ -2176,9 +2202,9 @@ static int dump_remote_ports(char *buf, int max)
 	struct msm_ipc_routing_table_entry *rt_entry;
 
 	for (j = 0; j < RT_HASH_SIZE; j++) {
-		mutex_lock(&routing_table_lock);
+		down_read(&routing_table_lock);
 		list_for_each_entry(rt_entry, &routing_table[j], list) {
-			mutex_lock(&rt_entry->lock);
+			down_read(&rt_entry->lock);
 			for (k = 0; k < RP_HASH_SIZE; k++) {
 				list_for_each_entry(rport_ptr,
 					&rt_entry->remote_port_list[k],
@@ -2195,9 +2221,9 @@ static int dump_remote_ports(char *buf, int max)
 				i += scnprintf(buf + i, max - i, "\n");
 				}
 			}
-			mutex_unlock(&rt_entry->lock);
+			up_read(&rt_entry->lock);
 		}
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 	}
 
 	return i;
@@ -2227,7 +2253,7 @@ static int dump_local_ports(char *buf, int max)
 	unsigned long flags;
 	struct msm_ipc_port *port_ptr;
 
-	mutex_lock(&local_ports_lock);
+	down_read(&local_ports_lock);
 	for (j = 0; j < LP_HASH_SIZE; j++) {
 		list_for_each_entry(port_ptr, &local_ports[j], list) {
 			spin_lock_irqsave(&port_ptr->port_lock, flags);
@@ -2247,11 +2273,130 @@ static int dump_local_ports(char *buf, int max)
 			i += scnprintf(buf + i, max - i, "\n");
 		}
 	}
-	mutex_unlock(&local_ports_lock);
+	up_read(&local_ports_lock);
 
 	return i;
 }
 
+/*
+ * Loopback benchmark: register bench_ports local ports and push
+ * BENCH_MSGS messages through the loopback path round-robin across them,
+ * reading each one back.  This exercises port lookup and the rx queue
+ * and reports messages per second against the number of registered ports.
+ */
+#define BENCH_MSGS 4096
+#define BENCH_MSG_SIZE 64
+static int bench_ports = 64;
+module_param_named(bench_ports, bench_ports, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static void bench_drain_port(struct msm_ipc_port *port_ptr)
+{
+	struct rr_packet *pkt, *temp_pkt;
+
+	mutex_lock(&port_ptr->port_rx_q_lock);
+	list_for_each_entry_safe(pkt, temp_pkt, &port_ptr->port_rx_q, list) {
+		list_del(&pkt->list);
+		release_pkt(pkt);
+	}
+	wake_unlock(&port_ptr->port_rx_wake_lock);
+	mutex_unlock(&port_ptr->port_rx_q_lock);
+}
+
+static void bench_release_port(struct msm_ipc_port *port_ptr)
+{
+	bench_drain_port(port_ptr);
+
+	down_write(&local_ports_lock);
+	list_del(&port_ptr->list);
+	up_write(&local_ports_lock);
+	wake_lock_destroy(&port_ptr->port_rx_wake_lock);
+	kfree(port_ptr);
+}
+
+static int bench_send_recv(struct msm_ipc_port *src,
+			   struct msm_ipc_port *dst)
+{
+	struct sk_buff_head *data;
+	struct sk_buff *skb;
+	int ret;
+
+	data = kmalloc(sizeof(struct sk_buff_head), GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+	skb_queue_head_init(data);
+	skb = alloc_skb(IPC_ROUTER_HDR_SIZE + BENCH_MSG_SIZE, GFP_KERNEL);
+	if (!skb) {
+		kfree(data);
+		return -ENOMEM;
+	}
+	skb_reserve(skb, IPC_ROUTER_HDR_SIZE);
+	memset(skb_put(skb, BENCH_MSG_SIZE), 0, BENCH_MSG_SIZE);
+	skb_queue_tail(data, skb);
+
+	/* loopback_data() owns data from here on, even on failure */
+	ret = loopback_data(src, dst->this_port.port_id, data);
+	if (ret < 0)
+		return ret;
+
+	ret = msm_ipc_router_read(dst, &data, 0);
+	if (ret < 0) {
+		bench_drain_port(dst);
+		return ret;
+	}
+	skb_queue_purge(data);
+	kfree(data);
+	return 0;
+}
+
+static int loopback_bench(char *buf, int max)
+{
+	struct msm_ipc_port **ports;
+	struct msm_ipc_port *src;
+	int nports = bench_ports;
+	int i, ret = 0;
+	ktime_t start;
+	s64 ns = 0;
+
+	if (nports < 1)
+		nports = 1;
+	ports = kcalloc(nports, sizeof(*ports), GFP_KERNEL);
+	if (!ports)
+		return scnprintf(buf, max, "out of memory\n");
+
+	src = msm_ipc_router_create_raw_port(NULL, NULL, NULL);
+	if (!src) {
+		kfree(ports);
+		return scnprintf(buf, max, "out of memory\n");
+	}
+	for (i = 0; i < nports; i++) {
+		ports[i] = msm_ipc_router_create_raw_port(NULL, NULL, NULL);
+		if (!ports[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	start = ktime_get();
+	for (i = 0; i < BENCH_MSGS; i++) {
+		ret = bench_send_recv(src, ports[i % nports]);
+		if (ret < 0)
+			goto out;
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+out:
+	for (i = 0; i < nports && ports[i]; i++)
+		bench_release_port(ports[i]);
+	bench_release_port(src);
+	kfree(ports);
+
+	if (ret < 0)
+		return scnprintf(buf, max, "failed: %d\n", ret);
+	return scnprintf(buf, max, "ports %d msgs %d time_ns %lld "
+			 "msgs_per_sec %lld\n", nports, BENCH_MSGS, ns,
+			 div64_s64((s64)BENCH_MSGS * NSEC_PER_SEC, ns ? : 1));
+}
+
 #define DEBUG_BUFMAX 4096
 static char debug_buffer[DEBUG_BUFMAX];
 
@@ -2301,6 +2446,8 @@ static void debugfs_init(void)
 		      dump_xprt_info);
 	debug_create("dump_routing_table", 0444, dent,
 		      dump_routing_table);
+	debug_create("loopback_bench", 0444, dent,
+		      loopback_bench);
 }
 
 #else
@@ -2346,14 +2493,14 @@ static int msm_ipc_router_add_xprt(struct msm_ipc_router_xprt *xprt)
 	list_add_tail(&xprt_info->list, &xprt_info_list);
 	mutex_unlock(&xprt_info_list_lock);
 
-	mutex_lock(&routing_table_lock);
+	down_write(&routing_table_lock);
 	if (!routing_table_inited) {
 		init_routing_table();
 		rt_entry = alloc_routing_table_entry(IPC_ROUTER_NID_LOCAL);
 		add_routing_table_entry(rt_entry);
 		routing_table_inited = 1;
 	}
-	mutex_unlock(&routing_table_lock);
+	up_write(&routing_table_lock);
 
 	queue_work(xprt_info->workqueue, &xprt_info->read_data);
 
@@ -2530,14 +2677,14 @@ static int __init msm_ipc_router_init(void)
 	for (i = 0; i < LP_HASH_SIZE; i++)
 		INIT_LIST_HEAD(&local_ports[i]);
 
-	mutex_lock(&routing_table_lock);
+	down_write(&routing_table_lock);
 	if (!routing_table_inited) {
 		init_routing_table();
 		rt_entry = alloc_routing_table_entry(IPC_ROUTER_NID_LOCAL);
 		add_routing_table_entry(rt_entry);
 		routing_table_inited = 1;
 	}
-	mutex_unlock(&routing_table_lock);
+	up_write(&routing_table_lock);
 
 	init_waitqueue_head(&newserver_wait);
 	init_waitqueue_head(&subsystem_restart_wait);
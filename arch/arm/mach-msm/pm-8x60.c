@@ -28,6 +28,8 @@
 #include <linux/uaccess.h>
 #include <linux/wakelock.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
 #include <asm/cacheflush.h>
@@ -810,6 +812,263 @@ static void msm_pm_set_timer(uint32_t modified_time_us)
 	hrtimer_start(&pm_hrtimer, modified_ktime, HRTIMER_MODE_ABS);
 }
 
+/******************************************************************************
+ * Idle Residency Prediction
+ *****************************************************************************/
+
+/*
+ * The next timer event only bounds how long a CPU stays idle; most idle
+ * periods are ended earlier by some other interrupt.  Each CPU keeps its
+ * recent idle periods and how they compared with the timer bound, and
+ * the rpmrs level choice uses the shorter of the timer bound and what
+ * that history predicts; the timer itself is still programmed from the
+ * bound.  How often the resulting choice was too deep (woken before the
+ * break-even time of the mode's rpmrs levels) or too shallow (idle long
+ * enough for a deeper enabled mode) is reported in debugfs.
+ */
+
+static int msm_pm_idle_predict = 1;
+module_param_named(
+	idle_predict, msm_pm_idle_predict, int, S_IRUGO | S_IWUSR | S_IWGRP
+);
+
+#define MSM_PM_PREDICT_HISTORY		8
+#define MSM_PM_PREDICT_MAX_US		USEC_PER_SEC
+/* correction factor: actual idle time over timer bound, 1.0 == 1 << 10 */
+#define MSM_PM_PREDICT_FACTOR_SHIFT	10
+#define MSM_PM_PREDICT_FACTOR_ONE	(1 << MSM_PM_PREDICT_FACTOR_SHIFT)
+/* weight of the newest idle period in the correction factor, as a shift */
+#define MSM_PM_PREDICT_DECAY_SHIFT	3
+
+/* idle modes from shallowest to deepest */
+static const enum msm_pm_sleep_mode msm_pm_idle_depth[] = {
+	MSM_PM_SLEEP_MODE_WAIT_FOR_INTERRUPT,
+	MSM_PM_SLEEP_MODE_POWER_COLLAPSE_STANDALONE,
+	MSM_PM_SLEEP_MODE_POWER_COLLAPSE,
+};
+
+struct msm_pm_idle_mode_stats {
+	u32 count;
+	u32 too_deep;
+	u32 too_shallow;
+};
+
+struct msm_pm_idle_predictor {
+	u32 intervals[MSM_PM_PREDICT_HISTORY];
+	unsigned int next;
+	unsigned int filled;
+	u32 factor;
+	u32 timer_us;		/* timer bound of the idle period in progress */
+	u32 predicted_us;	/* and the prediction used for it */
+	u32 timer_wakeups;
+	u32 early_wakeups;
+	struct msm_pm_idle_mode_stats modes[MSM_PM_SLEEP_MODE_NR];
+};
+
+static DEFINE_PER_CPU(struct msm_pm_idle_predictor, msm_pm_predictor);
+
+/*
+ * Return the typical recent idle period, or UINT_MAX if the history is
+ * too scattered to tell.  Outliers at the top are dropped one at a time
+ * while at least three quarters of the history remains.
+ */
+static u32 msm_pm_typical_interval(struct msm_pm_idle_predictor *p)
+{
+	u32 thresh = UINT_MAX;
+	u64 avg, variance;
+	u32 max;
+	int i, divisor;
+
+	if (p->filled < MSM_PM_PREDICT_HISTORY)
+		return UINT_MAX;
+
+again:
+	avg = 0;
+	max = 0;
+	divisor = 0;
+	for (i = 0; i < MSM_PM_PREDICT_HISTORY; i++) {
+		u32 value = p->intervals[i];
+
+		if (value <= thresh) {
+			avg += value;
+			divisor++;
+			if (value > max)
+				max = value;
+		}
+	}
+	do_div(avg, divisor);
+
+	variance = 0;
+	for (i = 0; i < MSM_PM_PREDICT_HISTORY; i++) {
+		u32 value = p->intervals[i];
+		s64 diff;
+
+		if (value <= thresh) {
+			diff = (s64)value - (s64)avg;
+			variance += diff * diff;
+		}
+	}
+	do_div(variance, divisor);
+
+	/* a standard deviation within 20us or a sixth of the mean */
+	if (variance <= 400 || avg * avg > 36 * variance)
+		return (u32)avg;
+
+	if (divisor * 4 > MSM_PM_PREDICT_HISTORY * 3) {
+		thresh = max - 1;
+		goto again;
+	}
+
+	return UINT_MAX;
+}
+
+/* Called with interrupts disabled on @cpu before choosing an idle mode. */
+static u32 msm_pm_predict_sleep(unsigned int cpu, u32 timer_us)
+{
+	struct msm_pm_idle_predictor *p = &per_cpu(msm_pm_predictor, cpu);
+	u64 corrected;
+	u32 predicted;
+
+	corrected = ((u64)timer_us * p->factor) >> MSM_PM_PREDICT_FACTOR_SHIFT;
+	predicted = min_t(u64, timer_us, corrected);
+	predicted = min(predicted, msm_pm_typical_interval(p));
+
+	p->timer_us = timer_us;
+	p->predicted_us = predicted;
+	return predicted;
+}
+
+/* Called on @cpu after an idle period of @actual_us in @mode. */
+static void msm_pm_predict_update(unsigned int cpu,
+		enum msm_pm_sleep_mode mode, u32 actual_us)
+{
+	struct msm_pm_idle_predictor *p = &per_cpu(msm_pm_predictor, cpu);
+	struct msm_pm_idle_mode_stats *stats = &p->modes[mode];
+	u32 timer_us = p->timer_us;
+	u32 ratio;
+	int i;
+
+	if (!timer_us)
+		return;
+	p->timer_us = 0;
+
+	if (actual_us >= timer_us) {
+		ratio = MSM_PM_PREDICT_FACTOR_ONE;
+		p->timer_wakeups++;
+	} else {
+		ratio = div_u64((u64)actual_us << MSM_PM_PREDICT_FACTOR_SHIFT,
+				timer_us);
+		p->early_wakeups++;
+	}
+	p->factor = p->factor - (p->factor >> MSM_PM_PREDICT_DECAY_SHIFT) +
+		(ratio >> MSM_PM_PREDICT_DECAY_SHIFT);
+
+	p->intervals[p->next] = min_t(u32, actual_us, MSM_PM_PREDICT_MAX_US);
+	p->next = (p->next + 1) % MSM_PM_PREDICT_HISTORY;
+	if (p->filled < MSM_PM_PREDICT_HISTORY)
+		p->filled++;
+
+	stats->count++;
+	if (actual_us < msm_rpmrs_break_even_us(mode))
+		stats->too_deep++;
+
+	for (i = 0; i < ARRAY_SIZE(msm_pm_idle_depth); i++)
+		if (msm_pm_idle_depth[i] == mode)
+			break;
+
+	for (i++; i < ARRAY_SIZE(msm_pm_idle_depth); i++) {
+		enum msm_pm_sleep_mode deeper = msm_pm_idle_depth[i];
+		struct msm_pm_platform_data *data =
+			&msm_pm_modes[MSM_PM_MODE(cpu, deeper)];
+
+		if (!data->idle_supported || !data->idle_enabled)
+			continue;
+		if (deeper == MSM_PM_SLEEP_MODE_POWER_COLLAPSE &&
+				num_online_cpus() > 1)
+			continue;
+
+		if (actual_us >= msm_rpmrs_break_even_us(deeper)) {
+			stats->too_shallow++;
+			break;
+		}
+	}
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int msm_pm_predict_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu;
+	int i;
+
+	for_each_possible_cpu(cpu) {
+		struct msm_pm_idle_predictor *p =
+			&per_cpu(msm_pm_predictor, cpu);
+
+		seq_printf(m, "CPU%u: last predicted %uus, correction %u/%u, "
+			"timer wakeups %u, early wakeups %u\n", cpu,
+			p->predicted_us, p->factor, MSM_PM_PREDICT_FACTOR_ONE,
+			p->timer_wakeups, p->early_wakeups);
+
+		for (i = 0; i < ARRAY_SIZE(msm_pm_idle_depth); i++) {
+			enum msm_pm_sleep_mode mode = msm_pm_idle_depth[i];
+			struct msm_pm_idle_mode_stats *stats = &p->modes[mode];
+
+			seq_printf(m, "  %s: entered %u, too deep %u, "
+				"too shallow %u\n",
+				msm_pm_sleep_mode_labels[mode], stats->count,
+				stats->too_deep, stats->too_shallow);
+		}
+	}
+
+	return 0;
+}
+
+static int msm_pm_predict_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_pm_predict_show, NULL);
+}
+
+/* Any write clears the counters. */
+static ssize_t msm_pm_predict_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct msm_pm_idle_predictor *p =
+			&per_cpu(msm_pm_predictor, cpu);
+
+		p->timer_wakeups = 0;
+		p->early_wakeups = 0;
+		memset(p->modes, 0, sizeof(p->modes));
+	}
+
+	return count;
+}
+
+static const struct file_operations msm_pm_predict_fops = {
+	.open = msm_pm_predict_open,
+	.read = seq_read,
+	.write = msm_pm_predict_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void __init msm_pm_predict_debugfs_init(void)
+{
+	struct dentry *dent;
+
+	dent = debugfs_create_dir("msm_pm", NULL);
+	if (IS_ERR_OR_NULL(dent))
+		return;
+
+	debugfs_create_file("idle_prediction", S_IRUGO | S_IWUSR, dent, NULL,
+			&msm_pm_predict_fops);
+}
+#else
+static inline void msm_pm_predict_debugfs_init(void) { }
+#endif
+
 /******************************************************************************
  * External Idle/Suspend Functions
  *****************************************************************************/
@@ -823,6 +1082,7 @@ int msm_pm_idle_prepare(struct cpuidle_device *dev)
 {
 	int i;
 	uint32_t modified_time_us = 0;
+	uint32_t predicted_us;
 	struct msm_pm_time_params time_param;
 
 	time_param.latency_us =
@@ -832,6 +1092,10 @@ int msm_pm_idle_prepare(struct cpuidle_device *dev)
 															& UINT_MAX);
 	time_param.modified_time_us = 0;
 
+	/* sleep_us stays the timer bound: rpmrs may reprogram the timer */
+	predicted_us = msm_pm_predict_sleep(dev->cpu, time_param.sleep_us);
+	time_param.predicted_us = msm_pm_idle_predict ? predicted_us : 0;
+
 	if (!dev->cpu)
 		time_param.next_event_us =
 				(uint32_t) (ktime_to_us(get_next_event_time())
@@ -889,10 +1153,11 @@ int msm_pm_idle_prepare(struct cpuidle_device *dev)
 
 			if (MSM_PM_DEBUG_IDLE & msm_pm_debug_mask)
 				pr_info("CPU%u: %s: %s, latency %uus, "
-					"sleep %uus, limit %p\n",
+					"sleep %uus, predicted %uus, limit %p\n",
 					dev->cpu, __func__, state->desc,
 					time_param.latency_us,
-					time_param.sleep_us, rs_limits);
+					time_param.sleep_us,
+					time_param.predicted_us, rs_limits);
 
 			if ((MSM_PM_DEBUG_IDLE_LIMITS & msm_pm_debug_mask) &&
 					rs_limits)
@@ -1009,6 +1274,7 @@ int msm_pm_idle_enter(enum msm_pm_sleep_mode sleep_mode)
 #endif
 
 	do_div(time, 1000);
+	msm_pm_predict_update(smp_processor_id(), sleep_mode, (u32) time);
 	return (int) time;
 
 cpuidle_enter_bail:
@@ -1107,6 +1373,7 @@ static int msm_pm_enter(suspend_state_t state)
 	time_param.latency_us = -1;
 	time_param.sleep_us = -1;
 	time_param.next_event_us = 0;
+	time_param.predicted_us = 0;
 
 	if (MSM_PM_DEBUG_SUSPEND & msm_pm_debug_mask)
 		pr_info("%s\n", __func__);
@@ -1329,6 +1596,11 @@ static int __init msm_pm_init(void)
 	}
 #endif  /* CONFIG_MSM_IDLE_STATS */
 
+	for_each_possible_cpu(cpu)
+		per_cpu(msm_pm_predictor, cpu).factor =
+			MSM_PM_PREDICT_FACTOR_ONE;
+	msm_pm_predict_debugfs_init();
+
 	msm_pm_mode_sysfs_add();
 	msm_spm_allow_x_cpu_set_vdd(false);
 
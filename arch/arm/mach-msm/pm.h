@@ -45,6 +45,7 @@ struct msm_pm_time_params {
 	uint32_t sleep_us;
 	uint32_t next_event_us;
 	uint32_t modified_time_us;
+	uint32_t predicted_us;	/* expected idle time if known, else 0 */
 };
 
 struct msm_pm_platform_data {
@@ -879,6 +879,7 @@ struct msm_rpmrs_limits *msm_rpmrs_lowest_limits(
 	bool gpio_detectable = false;
 	int i;
 	uint32_t next_wakeup_us = time_param->sleep_us;
+	uint32_t expected_us;
 	bool modify_event_timer;
 
 	if (sleep_mode == MSM_PM_SLEEP_MODE_POWER_COLLAPSE) {
@@ -915,24 +916,36 @@ struct msm_rpmrs_limits *msm_rpmrs_lowest_limits(
 			}
 		}
 
-		if (next_wakeup_us <= level->time_overhead_us)
+		/*
+		 * The timer only bounds the sleep; if the caller expects
+		 * to be woken earlier, pick the level for that instead.
+		 * Wait for interrupt is the fallback when nothing deeper
+		 * pays off, so it is still judged on the timer alone.
+		 */
+		expected_us = next_wakeup_us;
+		if (time_param->predicted_us &&
+				sleep_mode != MSM_PM_SLEEP_MODE_WAIT_FOR_INTERRUPT &&
+				time_param->predicted_us < expected_us)
+			expected_us = time_param->predicted_us;
+
+		if (expected_us <= level->time_overhead_us)
 			continue;
 
 		if (!msm_rpmrs_irqs_detectable(&level->rs_limits,
 					irqs_detectable, gpio_detectable))
 			continue;
 
-		if (next_wakeup_us <= 1) {
+		if (expected_us <= 1) {
 			power = level->energy_overhead;
-		} else if (next_wakeup_us <= level->time_overhead_us) {
-			power = level->energy_overhead / next_wakeup_us;
-		} else if ((next_wakeup_us >> 10) > level->time_overhead_us) {
+		} else if (expected_us <= level->time_overhead_us) {
+			power = level->energy_overhead / expected_us;
+		} else if ((expected_us >> 10) > level->time_overhead_us) {
 			power = level->steady_state_power;
 		} else {
 			power = level->steady_state_power;
 			power -= (level->time_overhead_us *
-					level->steady_state_power)/next_wakeup_us;
-			power += level->energy_overhead / next_wakeup_us;
+					level->steady_state_power)/expected_us;
+			power += level->energy_overhead / expected_us;
 		}
 
 		if (!best_level ||
@@ -952,6 +965,29 @@ struct msm_rpmrs_limits *msm_rpmrs_lowest_limits(
 	return best_level ? &best_level->rs_limits : NULL;
 }
 
+/*
+ * Return the shortest sleep that pays off for some available level of
+ * @sleep_mode: long enough to cover both its energy overhead and its exit
+ * latency.  UINT_MAX if the mode has no available level.
+ */
+uint32_t msm_rpmrs_break_even_us(enum msm_pm_sleep_mode sleep_mode)
+{
+	uint32_t break_even_us = UINT_MAX;
+	int i;
+
+	for (i = 0; i < msm_rpmrs_level_count; i++) {
+		struct msm_rpmrs_level *level = &msm_rpmrs_levels[i];
+
+		if (!level->available || sleep_mode != level->sleep_mode)
+			continue;
+
+		break_even_us = min(break_even_us,
+				max(level->time_overhead_us, level->latency_us));
+	}
+
+	return break_even_us;
+}
+
 int msm_rpmrs_enter_sleep(uint32_t sclk_count, struct msm_rpmrs_limits *limits,
 		bool from_idle, bool notify_rpm)
 {
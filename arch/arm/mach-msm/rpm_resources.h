@@ -106,6 +106,7 @@ void msm_rpmrs_show_resources(void);
 struct msm_rpmrs_limits *msm_rpmrs_lowest_limits(
 	bool from_idle, enum msm_pm_sleep_mode sleep_mode,
     struct msm_pm_time_params *time_param);
+uint32_t msm_rpmrs_break_even_us(enum msm_pm_sleep_mode sleep_mode);
 
 int msm_rpmrs_enter_sleep(uint32_t sclk_count, struct msm_rpmrs_limits *limits,
 		bool from_idle, bool notify_rpm);
@@ -528,6 +528,10 @@ struct smd_channel {
 	int pending_pkt_sz;
 
 	char is_pkt_ch;
+
+	/* outbound interrupts are held back while batch is non-zero */
+	atomic_t batch;
+	int notify_pending;
 };
 
 struct edge_to_pid {
@@ -954,6 +958,34 @@ static void ch_write_done(struct smd_channel *ch, unsigned count)
 	ch->send->fHEAD = 1;
 }
 
+/* Signal the remote processor, or leave it to whoever ends the batch.
+ * Readers and writers may batch concurrently, so the count is rechecked
+ * after flagging and exactly one side claims the interrupt.
+ */
+static void ch_notify_other_cpu(struct smd_channel *ch)
+{
+	if (atomic_read(&ch->batch)) {
+		ch->notify_pending = 1;
+		smp_mb();
+		if (atomic_read(&ch->batch))
+			return;
+		if (!xchg(&ch->notify_pending, 0))
+			return;
+	}
+	ch->notify_other_cpu();
+}
+
+static void ch_batch_begin(struct smd_channel *ch)
+{
+	atomic_inc(&ch->batch);
+}
+
+static void ch_batch_end(struct smd_channel *ch)
+{
+	if (atomic_dec_and_test(&ch->batch) && xchg(&ch->notify_pending, 0))
+		ch->notify_other_cpu();
+}
+
 static void ch_set_state(struct smd_channel *ch, unsigned n)
 {
 	if (n == SMD_SS_OPENED) {
@@ -1242,7 +1274,7 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	}
 
 	if (orig_len - len)
-		ch->notify_other_cpu();
+		ch_notify_other_cpu(ch);
 
 	return orig_len - len;
 }
@@ -1265,16 +1297,18 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	hdr[0] = len;
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
-
+	/* header and payload go out under a single interrupt */
+	ch_batch_begin(ch);
 	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
+		ch_batch_end(ch);
 		SMD_DBG("%s failed to write pkt header: "
 			"%d returned\n", __func__, ret);
 		return -1;
 	}
 
-
 	ret = smd_stream_write(ch, _data, len, user_buf);
+	ch_batch_end(ch);
 	if (ret < 0 || ret != len) {
 		SMD_DBG("%s failed to write pkt data: "
 			"%d returned\n", __func__, ret);
@@ -1294,7 +1328,7 @@ static int smd_stream_read(smd_channel_t *ch, void *data, int len, int user_buf)
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
 		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu();
+			ch_notify_other_cpu(ch);
 
 	return r;
 }
@@ -1313,7 +1347,7 @@ static int smd_packet_read(smd_channel_t *ch, void *data, int len, int user_buf)
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
 		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu();
+			ch_notify_other_cpu(ch);
 
 	spin_lock_irqsave(&smd_lock, flags);
 	ch->current_packet -= r;
@@ -1337,7 +1371,7 @@ static int smd_packet_read_from_cb(smd_channel_t *ch, void *data, int len,
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
 		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu();
+			ch_notify_other_cpu(ch);
 
 	ch->current_packet -= r;
 	update_packet_state(ch);
@@ -1622,6 +1656,8 @@ int smd_named_open_on_edge(const char *name, uint32_t edge,
 
 	ch->notify = notify;
 	ch->current_packet = 0;
+	atomic_set(&ch->batch, 0);
+	ch->notify_pending = 0;
 	ch->last_state = SMD_SS_CLOSED;
 	ch->priv = priv;
 
@@ -1795,6 +1831,125 @@ int smd_write_end(smd_channel_t *ch)
 }
 EXPORT_SYMBOL(smd_write_end);
 
+int smd_read_reserve(smd_channel_t *ch, void **data)
+{
+	int n;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	n = ch_read_buffer(ch, data);
+	if (ch->is_pkt_ch && n > ch->current_packet)
+		n = ch->current_packet;
+	return n;
+}
+EXPORT_SYMBOL(smd_read_reserve);
+
+int smd_read_commit(smd_channel_t *ch, int len)
+{
+	unsigned long flags;
+	void *ptr;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+	if (len < 0 || len > smd_read_reserve(ch, &ptr)) {
+		pr_err("%s: invalid length: %d\n", __func__, len);
+		return -EINVAL;
+	}
+	if (len == 0)
+		return 0;
+
+	ch_read_done(ch, len);
+	if (!read_intr_blocked(ch))
+		ch_notify_other_cpu(ch);
+
+	if (ch->is_pkt_ch) {
+		spin_lock_irqsave(&smd_lock, flags);
+		ch->current_packet -= len;
+		update_packet_state(ch);
+		spin_unlock_irqrestore(&smd_lock, flags);
+	}
+	return len;
+}
+EXPORT_SYMBOL(smd_read_commit);
+
+int smd_write_reserve(smd_channel_t *ch, void **data)
+{
+	int n;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+	if (ch->is_pkt_ch && !ch->pending_pkt_sz) {
+		pr_err("%s: no transaction in progress\n", __func__);
+		return -ENOEXEC;
+	}
+	if (!ch_is_open(ch))
+		return 0;
+
+	n = ch_write_buffer(ch, data);
+	if (ch->is_pkt_ch && n > ch->pending_pkt_sz)
+		n = ch->pending_pkt_sz;
+	return n;
+}
+EXPORT_SYMBOL(smd_write_reserve);
+
+int smd_write_commit(smd_channel_t *ch, int len)
+{
+	void *ptr;
+	int n;
+
+	n = smd_write_reserve(ch, &ptr);
+	if (n < 0)
+		return n;
+	if (len < 0 || len > n) {
+		pr_err("%s: invalid length: %d\n", __func__, len);
+		return -EINVAL;
+	}
+	if (len == 0)
+		return 0;
+
+	ch_write_done(ch, len);
+	if (ch->is_pkt_ch)
+		ch->pending_pkt_sz -= len;
+	ch_notify_other_cpu(ch);
+	return len;
+}
+EXPORT_SYMBOL(smd_write_commit);
+
+int smd_batch_begin(smd_channel_t *ch)
+{
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	ch_batch_begin(ch);
+	return 0;
+}
+EXPORT_SYMBOL(smd_batch_begin);
+
+int smd_batch_end(smd_channel_t *ch)
+{
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+	if (atomic_read(&ch->batch) <= 0) {
+		pr_err("%s: no batch in progress\n", __func__);
+		return -ENOEXEC;
+	}
+
+	ch_batch_end(ch);
+	return 0;
+}
+EXPORT_SYMBOL(smd_batch_end);
+
 int smd_read(smd_channel_t *ch, void *data, int len)
 {
 	if (!ch) {
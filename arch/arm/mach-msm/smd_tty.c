@@ -116,7 +116,7 @@ static void buf_req_retry(unsigned long param)
 
 static void smd_tty_read(unsigned long param)
 {
-	unsigned char *ptr;
+	void *ptr;
 	int avail;
 	struct smd_tty_info *info = (struct smd_tty_info *)param;
 	struct tty_struct *tty = info->tty;
@@ -124,6 +124,8 @@ static void smd_tty_read(unsigned long param)
 	if (!tty)
 		return;
 
+	/* tell the remote side once per burst that fifo space freed up */
+	smd_batch_begin(info->ch);
 	for (;;) {
 		if (is_in_reset(info)) {
 			/* signal TTY clients using TTY_BREAK */
@@ -133,14 +135,15 @@ static void smd_tty_read(unsigned long param)
 		}
 
 		if (test_bit(TTY_THROTTLED, &tty->flags)) break;
-		avail = smd_read_avail(info->ch);
-		if (avail == 0)
+		/* copy from the fifo straight into the tty buffers */
+		avail = smd_read_reserve(info->ch, &ptr);
+		if (avail <= 0)
 			break;
 
 		if (avail > MAX_TTY_BUF_SIZE)
 			avail = MAX_TTY_BUF_SIZE;
 
-		avail = tty_prepare_flip_string(tty, &ptr, avail);
+		avail = tty_insert_flip_string(tty, ptr, avail);
 		if (avail <= 0) {
 			if (!timer_pending(&info->buf_req_timer)) {
 				init_timer(&info->buf_req_timer);
@@ -150,10 +153,11 @@ static void smd_tty_read(unsigned long param)
 				info->buf_req_timer.data = param;
 				add_timer(&info->buf_req_timer);
 			}
+			smd_batch_end(info->ch);
 			return;
 		}
 
-		if (smd_read(info->ch, ptr, avail) != avail) {
+		if (smd_read_commit(info->ch, avail) != avail) {
 			/* shouldn't be possible since we're in interrupt
 			** context here and nobody else could 'steal' our
 			** characters.
@@ -164,6 +168,7 @@ static void smd_tty_read(unsigned long param)
 		wake_lock_timeout(&info->wake_lock, HZ / 2);
 		tty_flip_buffer_push(tty);
 	}
+	smd_batch_end(info->ch);
 
 	/* XXX only when writable and necessary */
 	tty_wakeup(tty);
@@ -33,6 +33,12 @@ static int cfq_slice_idle = HZ / 125;
 static int cfq_group_idle = HZ / 125;
 static const int cfq_target_latency = HZ * 3/10; /* 300 ms */
 static const int cfq_hist_divisor = 4;
+/* vdisktime charge multiplier for unprotected groups during a latency miss */
+static const int cfq_group_lat_penalty = 4;
+/* keeps the multiplied charge from overflowing vdisktime arithmetic */
+#define CFQ_GROUP_LAT_PENALTY_MAX	16
+/* how long unprotected groups stay penalized after a latency miss */
+static const int cfq_group_lat_window = HZ / 10;
 
 /*
  * offset from end of service tree
@@ -181,6 +187,14 @@ struct cfq_group {
 	unsigned int new_weight;
 	bool needs_update;
 
+	/*
+	 * Completion latency target in usecs (0 if the group is not latency
+	 * protected) and the running average of observed completion
+	 * latencies in ns.
+	 */
+	unsigned int latency_target;
+	u64 avg_latency;
+
 	/* number of cfqq currently on this group */
 	int nr_cfqq;
 
@@ -287,6 +301,14 @@ struct cfq_data {
 	unsigned int cfq_slice_idle;
 	unsigned int cfq_group_idle;
 	unsigned int cfq_latency;
+	unsigned int cfq_group_lat_penalty;
+	unsigned int cfq_group_lat_window;
+
+	/*
+	 * A latency protected group missed its target. Until this time,
+	 * groups without a target are charged more for their slices.
+	 */
+	unsigned long lat_penalty_end;
 
 	unsigned int cic_index;
 	struct list_head cic_list;
@@ -971,6 +993,15 @@ static void cfq_group_served(struct cfq_data *cfqd, struct cfq_group *cfqg,
 	else if (!cfq_cfqq_sync(cfqq) && !nr_sync)
 		charge = cfqq->allocated_slice;
 
+	/*
+	 * While a latency protected group is missing its target, make the
+	 * unprotected groups pay more for the same service. They still get
+	 * the disk when nobody else wants it.
+	 */
+	if (!cfqg->latency_target && cfqd->cfq_group_lat_penalty > 1 &&
+	    time_before(jiffies, cfqd->lat_penalty_end))
+		charge *= cfqd->cfq_group_lat_penalty;
+
 	/* Can't update vdisktime while group is on service tree */
 	cfq_group_service_tree_del(st, cfqg);
 	cfqg->vdisktime += cfq_scale_slice(charge, cfqg);
@@ -1013,6 +1044,40 @@ void cfq_update_blkio_group_weight(void *key, struct blkio_group *blkg,
 	cfqg->needs_update = true;
 }
 
+void cfq_update_blkio_group_latency_target(void *key, struct blkio_group *blkg,
+					unsigned int latency_target)
+{
+	struct cfq_group *cfqg = cfqg_of_blkg(blkg);
+	cfqg->latency_target = latency_target;
+}
+
+/*
+ * Track the completion latency of a latency protected group and start
+ * penalizing unprotected groups on this device when it runs over target.
+ */
+static void cfq_update_group_latency(struct cfq_data *cfqd,
+			struct cfq_group *cfqg, struct request *rq)
+{
+	u64 now = sched_clock();
+	u64 start = rq_start_time_ns(rq);
+	u64 latency;
+
+	if (!cfqg->latency_target || !time_after64(now, start))
+		return;
+
+	latency = now - start;
+	cfqg->avg_latency = cfqg->avg_latency - (cfqg->avg_latency >> 3) +
+				(latency >> 3);
+
+	if (cfqg->avg_latency <= (u64)cfqg->latency_target * NSEC_PER_USEC)
+		return;
+
+	cfqd->lat_penalty_end = jiffies + cfqd->cfq_group_lat_window;
+	cfq_blkiocg_update_latency_missed_stats(&cfqg->blkg);
+	cfq_log_cfqg(cfqd, cfqg, "latency miss: avg=%llu target=%u",
+			cfqg->avg_latency, cfqg->latency_target);
+}
+
 static void cfq_init_add_cfqg_lists(struct cfq_data *cfqd,
 			struct cfq_group *cfqg, struct blkio_cgroup *blkcg)
 {
@@ -1035,6 +1100,7 @@ static void cfq_init_add_cfqg_lists(struct cfq_data *cfqd,
 
 	cfqd->nr_blkcg_linked_grps++;
 	cfqg->weight = blkcg_get_weight(blkcg, cfqg->blkg.dev);
+	cfqg->latency_target = blkcg_get_latency_target(blkcg);
 
 	/* Add group on cfqd list */
 	hlist_add_head(&cfqg->cfqd_node, &cfqd->cfqg_list);
@@ -1263,6 +1329,8 @@ cfq_link_cfqq_cfqg(struct cfq_queue *cfqq, struct cfq_group *cfqg) {
 
 static void cfq_release_cfq_groups(struct cfq_data *cfqd) {}
 static inline void cfq_put_cfqg(struct cfq_group *cfqg) {}
+static inline void cfq_update_group_latency(struct cfq_data *cfqd,
+			struct cfq_group *cfqg, struct request *rq) {}
 
 #endif /* GROUP_IOSCHED */
 
@@ -3569,6 +3637,7 @@ static void cfq_completed_request(struct request_queue *q, struct request *rq)
 	cfq_blkiocg_update_completion_stats(&cfqq->cfqg->blkg,
 			rq_start_time_ns(rq), rq_io_start_time_ns(rq),
 			rq_data_dir(rq), rq_is_sync(rq));
+	cfq_update_group_latency(cfqd, cfqq->cfqg, rq);
 
 	cfqd->rq_in_flight[cfq_cfqq_sync(cfqq)]--;
 
@@ -4036,6 +4105,7 @@ static void *cfq_init_queue(struct request_queue *q)
 	cfq_blkiocg_add_blkio_group(&blkio_root_cgroup, &cfqg->blkg,
 					(void *)cfqd, 0);
 	rcu_read_unlock();
+	cfqg->latency_target = blkcg_get_latency_target(&blkio_root_cgroup);
 	cfqd->nr_blkcg_linked_grps++;
 
 	/* Add group on cfqd->cfqg_list */
@@ -4079,6 +4149,8 @@ static void *cfq_init_queue(struct request_queue *q)
 	cfqd->cfq_slice_idle = cfq_slice_idle;
 	cfqd->cfq_group_idle = cfq_group_idle;
 	cfqd->cfq_latency = 1;
+	cfqd->cfq_group_lat_penalty = cfq_group_lat_penalty;
+	cfqd->cfq_group_lat_window = cfq_group_lat_window;
 	cfqd->hw_tag = -1;
 	/*
 	 * we optimistically start assuming sync ops weren't delayed in last
@@ -4154,6 +4226,8 @@ SHOW_FUNCTION(cfq_slice_sync_show, cfqd->cfq_slice[1], 1);
 SHOW_FUNCTION(cfq_slice_async_show, cfqd->cfq_slice[0], 1);
 SHOW_FUNCTION(cfq_slice_async_rq_show, cfqd->cfq_slice_async_rq, 0);
 SHOW_FUNCTION(cfq_low_latency_show, cfqd->cfq_latency, 0);
+SHOW_FUNCTION(cfq_group_lat_penalty_show, cfqd->cfq_group_lat_penalty, 0);
+SHOW_FUNCTION(cfq_group_lat_window_show, cfqd->cfq_group_lat_window, 1);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -4187,6 +4261,10 @@ STORE_FUNCTION(cfq_slice_async_store, &cfqd->cfq_slice[0], 1, UINT_MAX, 1);
 STORE_FUNCTION(cfq_slice_async_rq_store, &cfqd->cfq_slice_async_rq, 1,
 		UINT_MAX, 0);
 STORE_FUNCTION(cfq_low_latency_store, &cfqd->cfq_latency, 0, 1, 0);
+STORE_FUNCTION(cfq_group_lat_penalty_store, &cfqd->cfq_group_lat_penalty, 1,
+		CFQ_GROUP_LAT_PENALTY_MAX, 0);
+STORE_FUNCTION(cfq_group_lat_window_store, &cfqd->cfq_group_lat_window, 1,
+		UINT_MAX, 1);
 #undef STORE_FUNCTION
 
 #define CFQ_ATTR(name) \
@@ -4204,6 +4282,8 @@ static struct elv_fs_entry cfq_attrs[] = {
 	CFQ_ATTR(slice_idle),
 	CFQ_ATTR(group_idle),
 	CFQ_ATTR(low_latency),
+	CFQ_ATTR(group_lat_penalty),
+	CFQ_ATTR(group_lat_window),
 	__ATTR_NULL
 };
 
@@ -4238,6 +4318,8 @@ static struct blkio_policy_type blkio_policy_cfq = {
 	.ops = {
 		.blkio_unlink_group_fn =	cfq_unlink_blkio_group,
 		.blkio_update_group_weight_fn =	cfq_update_blkio_group_weight,
+		.blkio_update_group_latency_target_fn =
+					cfq_update_blkio_group_latency_target,
 	},
 	.plid = BLKIO_POLICY_PROP,
 };
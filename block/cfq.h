@@ -67,6 +67,12 @@ static inline void cfq_blkiocg_update_completion_stats(struct blkio_group *blkg,
 				direction, sync);
 }
 
+static inline void
+cfq_blkiocg_update_latency_missed_stats(struct blkio_group *blkg)
+{
+	blkiocg_update_latency_missed_stats(blkg);
+}
+
 static inline void cfq_blkiocg_add_blkio_group(struct blkio_cgroup *blkcg,
 			struct blkio_group *blkg, void *key, dev_t dev) {
 	blkiocg_add_blkio_group(blkcg, blkg, key, dev, BLKIO_POLICY_PROP);
@@ -103,6 +109,8 @@ cfq_blkiocg_update_set_idle_time_stats(struct blkio_group *blkg) {}
 static inline void cfq_blkiocg_update_dispatch_stats(struct blkio_group *blkg,
 				uint64_t bytes, bool direction, bool sync) {}
 static inline void cfq_blkiocg_update_completion_stats(struct blkio_group *blkg, uint64_t start_time, uint64_t io_start_time, bool direction, bool sync) {}
+static inline void
+cfq_blkiocg_update_latency_missed_stats(struct blkio_group *blkg) {}
 
 static inline void cfq_blkiocg_add_blkio_group(struct blkio_cgroup *blkcg,
 			struct blkio_group *blkg, void *key, dev_t dev) {}
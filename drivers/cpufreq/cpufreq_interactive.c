@@ -30,6 +30,10 @@
 #include <linux/kthread.h>
 #include <linux/slab.h>
 #include <linux/kernel_stat.h>
+#include <linux/input.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
 #include <asm/cputime.h>
 
 #define CREATE_TRACE_POINTS
@@ -54,44 +58,26 @@ struct cpufreq_interactive_cpuinfo {
 	struct rw_semaphore enable_sem;
 	int governor_enabled;
 	int prev_load;
+	struct cpufreq_interactive_policyinfo *ppol;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
 
-/* realtime thread handles frequency scaling */
-static struct task_struct *speedchange_task;
-static cpumask_t speedchange_cpumask;
-static spinlock_t speedchange_cpumask_lock;
 static struct mutex gov_lock;
 
-/* Hi speed to bump to from lo speed when load burst (default max) */
-static unsigned int hispeed_freq;
-
-/* Go to hi speed when CPU load at or above this value. */
 #define DEFAULT_GO_HISPEED_LOAD 99
-static unsigned long go_hispeed_load = DEFAULT_GO_HISPEED_LOAD;
-
-/* Sampling down factor to be applied to min_sample_time at max freq */
-static unsigned int sampling_down_factor;
-
-/* Target load.  Lower values result in higher CPU speeds. */
 #define DEFAULT_TARGET_LOAD 90
 static unsigned int default_target_loads[] = {DEFAULT_TARGET_LOAD};
-static spinlock_t target_loads_lock;
-static unsigned int *target_loads = default_target_loads;
-static int ntarget_loads = ARRAY_SIZE(default_target_loads);
 
 /*
  * The minimum amount of time to spend at a frequency before we can ramp down.
  */
 #define DEFAULT_MIN_SAMPLE_TIME (80 * USEC_PER_MSEC)
-static unsigned long min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
 
 /*
  * The sample rate of the timer used to increase frequency
  */
 #define DEFAULT_TIMER_RATE (20 * USEC_PER_MSEC)
-static unsigned long timer_rate = DEFAULT_TIMER_RATE;
 
 /* Busy SDF parameters*/
 #define MIN_BUSY_TIME (100 * USEC_PER_MSEC)
@@ -103,35 +89,92 @@ static unsigned long timer_rate = DEFAULT_TIMER_RATE;
 #define DEFAULT_ABOVE_HISPEED_DELAY DEFAULT_TIMER_RATE
 static unsigned int default_above_hispeed_delay[] = {
 	DEFAULT_ABOVE_HISPEED_DELAY };
-static spinlock_t above_hispeed_delay_lock;
-static unsigned int *above_hispeed_delay = default_above_hispeed_delay;
-static int nabove_hispeed_delay = ARRAY_SIZE(default_above_hispeed_delay);
 
-/* Non-zero means indefinite speed boost active */
-static int boost_val;
-/* Duration of a boot pulse in usecs */
-static int boostpulse_duration_val = DEFAULT_MIN_SAMPLE_TIME;
-/* End time of boost pulse in ktime converted to usecs */
-static u64 boostpulse_endtime;
+#define DEFAULT_TIMER_SLACK (4 * DEFAULT_TIMER_RATE)
 
 /*
- * Max additional time to wait in idle, beyond timer_rate, at speeds above
- * minimum before wakeup to reduce speed, or -1 if unnecessary.
+ * One set of tunables.  By default all policies share common_tunables,
+ * exported under /sys/devices/system/cpu/cpufreq/interactive.  With
+ * per_policy set, each policy gets its own set in an "interactive"
+ * directory under the policy's cpufreq directory.
  */
-#define DEFAULT_TIMER_SLACK (4 * DEFAULT_TIMER_RATE)
-static int timer_slack_val = DEFAULT_TIMER_SLACK;
+struct cpufreq_interactive_tunables {
+	/* Hi speed to bump to from lo speed when load burst (default max) */
+	unsigned int hispeed_freq;
+
+	/* Go to hi speed when CPU load at or above this value. */
+	unsigned long go_hispeed_load;
+
+	/* Sampling down factor to be applied to min_sample_time at max freq */
+	unsigned int sampling_down_factor;
+
+	/* Target load.  Lower values result in higher CPU speeds. */
+	spinlock_t target_loads_lock;
+	unsigned int *target_loads;
+	int ntarget_loads;
+
+	unsigned long min_sample_time;
+	unsigned long timer_rate;
+
+	spinlock_t above_hispeed_delay_lock;
+	unsigned int *above_hispeed_delay;
+	int nabove_hispeed_delay;
+
+	/* Non-zero means indefinite speed boost active */
+	int boost_val;
+	/* Duration of a boot pulse in usecs */
+	int boostpulse_duration_val;
+	/* End time of boost pulse in ktime converted to usecs */
+	u64 boostpulse_endtime;
+	/* Boost pulse length in usecs on touch-down/key press, 0 disables */
+	int input_boost_duration;
+	/* Boost pulse length in usecs for cpufreq_interactive_hint() */
+	int hint_boost_duration;
+
+	/*
+	 * Max additional time to wait in idle, beyond timer_rate, at speeds
+	 * above minimum before wakeup to reduce speed, or -1 if unnecessary.
+	 */
+	int timer_slack_val;
+
+	bool io_is_busy;
+
+	/*
+	 * If the max load among other CPUs is higher than
+	 * up_threshold_any_cpu_load and if the highest frequency among the
+	 * other CPUs is higher than up_threshold_any_cpu_freq then do not
+	 * let the frequency to drop below sync_freq
+	 */
+	unsigned int up_threshold_any_cpu_load;
+	unsigned int sync_freq;
+	unsigned int up_threshold_any_cpu_freq;
+
+	/* per-policy sets only: the "interactive" sysfs directory */
+	struct kobject kobj;
+};
 
-static bool io_is_busy;
+static struct cpufreq_interactive_tunables common_tunables;
 
 /*
- * If the max load among other CPUs is higher than up_threshold_any_cpu_load
- * and if the highest frequency among the other CPUs is higher than
- * up_threshold_any_cpu_freq then do not let the frequency to drop below
- * sync_freq
+ * State kept for each policy, keyed by the first CPU the policy can ever
+ * cover so that it survives hotplug.  Each policy has its own realtime
+ * thread for frequency changes, so policies on separately clocked CPUs
+ * do not queue behind one another.
  */
-static unsigned int up_threshold_any_cpu_load;
-static unsigned int sync_freq;
-static unsigned int up_threshold_any_cpu_freq;
+struct cpufreq_interactive_policyinfo {
+	struct task_struct *speedchange_task;
+	cpumask_t speedchange_cpumask;
+	spinlock_t speedchange_cpumask_lock;
+	struct cpufreq_interactive_tunables *tunables;
+	/* per-policy tunables, kept across governor stop/start */
+	struct cpufreq_interactive_tunables *own_tunables;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_interactive_policyinfo *, polinfo);
+
+static bool per_policy;
+module_param(per_policy, bool, S_IRUGO);
+MODULE_PARM_DESC(per_policy, "give each cpufreq policy its own tunables");
 
 static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		unsigned int event);
@@ -170,13 +213,13 @@ static inline cputime64_t get_cpu_idle_time_jiffy(unsigned int cpu,
 }
 
 static inline cputime64_t get_cpu_idle_time(unsigned int cpu,
-					    cputime64_t *wall)
+					    cputime64_t *wall, bool io_busy)
 {
 	u64 idle_time = get_cpu_idle_time_us(cpu, wall);
 
 	if (idle_time == -1ULL)
 		idle_time = get_cpu_idle_time_jiffy(cpu, wall);
-	else if (!io_is_busy)
+	else if (!io_busy)
 		idle_time += get_cpu_iowait_time_us(cpu, wall);
 
 	return idle_time;
@@ -185,20 +228,23 @@ static inline cputime64_t get_cpu_idle_time(unsigned int cpu,
 static void cpufreq_interactive_timer_resched(
 	struct cpufreq_interactive_cpuinfo *pcpu)
 {
+	struct cpufreq_interactive_tunables *tunables = pcpu->ppol->tunables;
 	unsigned long expires;
 	unsigned long flags;
 
 	spin_lock_irqsave(&pcpu->load_lock, flags);
 	pcpu->time_in_idle =
 		get_cpu_idle_time(smp_processor_id(),
-				     &pcpu->time_in_idle_timestamp);
+				  &pcpu->time_in_idle_timestamp,
+				  tunables->io_is_busy);
 	pcpu->cputime_speedadj = 0;
 	pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
-	expires = jiffies + usecs_to_jiffies(timer_rate);
+	expires = jiffies + usecs_to_jiffies(tunables->timer_rate);
 	mod_timer_pinned(&pcpu->cpu_timer, expires);
 
-	if (timer_slack_val >= 0 && pcpu->target_freq > pcpu->policy->min) {
-		expires += usecs_to_jiffies(timer_slack_val);
+	if (tunables->timer_slack_val >= 0 &&
+	    pcpu->target_freq > pcpu->policy->min) {
+		expires += usecs_to_jiffies(tunables->timer_slack_val);
 		mod_timer_pinned(&pcpu->cpu_slack_timer, expires);
 	}
 
@@ -212,57 +258,64 @@ static void cpufreq_interactive_timer_resched(
 static void cpufreq_interactive_timer_start(int cpu)
 {
 	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
-	unsigned long expires = jiffies + usecs_to_jiffies(timer_rate);
+	struct cpufreq_interactive_tunables *tunables = pcpu->ppol->tunables;
+	unsigned long expires = jiffies +
+		usecs_to_jiffies(tunables->timer_rate);
 	unsigned long flags;
 
 	pcpu->cpu_timer.expires = expires;
 	add_timer_on(&pcpu->cpu_timer, cpu);
-	if (timer_slack_val >= 0 && pcpu->target_freq > pcpu->policy->min) {
-		expires += usecs_to_jiffies(timer_slack_val);
+	if (tunables->timer_slack_val >= 0 &&
+	    pcpu->target_freq > pcpu->policy->min) {
+		expires += usecs_to_jiffies(tunables->timer_slack_val);
 		pcpu->cpu_slack_timer.expires = expires;
 		add_timer_on(&pcpu->cpu_slack_timer, cpu);
 	}
 
 	spin_lock_irqsave(&pcpu->load_lock, flags);
 	pcpu->time_in_idle =
-		get_cpu_idle_time(cpu, &pcpu->time_in_idle_timestamp);
+		get_cpu_idle_time(cpu, &pcpu->time_in_idle_timestamp,
+				  tunables->io_is_busy);
 	pcpu->cputime_speedadj = 0;
 	pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
 	spin_unlock_irqrestore(&pcpu->load_lock, flags);
 }
 
-static unsigned int freq_to_above_hispeed_delay(unsigned int freq)
+static unsigned int freq_to_above_hispeed_delay(
+	struct cpufreq_interactive_tunables *tunables, unsigned int freq)
 {
 	int i;
 	unsigned int ret;
 	unsigned long flags;
 
-	spin_lock_irqsave(&above_hispeed_delay_lock, flags);
+	spin_lock_irqsave(&tunables->above_hispeed_delay_lock, flags);
 
-	for (i = 0; i < nabove_hispeed_delay - 1 &&
-			freq >= above_hispeed_delay[i+1]; i += 2)
+	for (i = 0; i < tunables->nabove_hispeed_delay - 1 &&
+			freq >= tunables->above_hispeed_delay[i+1]; i += 2)
 		;
 
-	ret = above_hispeed_delay[i];
+	ret = tunables->above_hispeed_delay[i];
 	ret = (ret > (1 * USEC_PER_MSEC)) ? (ret - (1 * USEC_PER_MSEC)) : ret;
 
-	spin_unlock_irqrestore(&above_hispeed_delay_lock, flags);
+	spin_unlock_irqrestore(&tunables->above_hispeed_delay_lock, flags);
 	return ret;
 }
 
-static unsigned int freq_to_targetload(unsigned int freq)
+static unsigned int freq_to_targetload(
+	struct cpufreq_interactive_tunables *tunables, unsigned int freq)
 {
 	int i;
 	unsigned int ret;
 	unsigned long flags;
 
-	spin_lock_irqsave(&target_loads_lock, flags);
+	spin_lock_irqsave(&tunables->target_loads_lock, flags);
 
-	for (i = 0; i < ntarget_loads - 1 && freq >= target_loads[i+1]; i += 2)
+	for (i = 0; i < tunables->ntarget_loads - 1 &&
+		    freq >= tunables->target_loads[i+1]; i += 2)
 		;
 
-	ret = target_loads[i];
-	spin_unlock_irqrestore(&target_loads_lock, flags);
+	ret = tunables->target_loads[i];
+	spin_unlock_irqrestore(&tunables->target_loads_lock, flags);
 	return ret;
 }
 
@@ -285,7 +338,7 @@ static unsigned int choose_freq(
 
 	do {
 		prevfreq = freq;
-		tl = freq_to_targetload(freq);
+		tl = freq_to_targetload(pcpu->ppol->tunables, freq);
 
 		/*
 		 * Find the lowest frequency where the computed load is less
@@ -357,16 +410,14 @@ static unsigned int choose_freq(
 	return freq;
 }
 
-static u64 update_load(int cpu)
+/* Account the busy time since the last update at the current speed. */
+static void __update_load(struct cpufreq_interactive_cpuinfo *pcpu,
+			  u64 now, u64 now_idle)
 {
-	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
-	u64 now;
-	u64 now_idle;
 	unsigned int delta_idle;
 	unsigned int delta_time;
 	u64 active_time;
 
-	now_idle = get_cpu_idle_time(cpu, &now);
 	delta_idle = (unsigned int)(now_idle - pcpu->time_in_idle);
 	delta_time = (unsigned int)(now - pcpu->time_in_idle_timestamp);
 
@@ -379,60 +430,59 @@ static u64 update_load(int cpu)
 
 	pcpu->time_in_idle = now_idle;
 	pcpu->time_in_idle_timestamp = now;
-	return now;
 }
 
-static void cpufreq_interactive_timer(unsigned long data)
+static u64 update_load(int cpu)
 {
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
 	u64 now;
-	unsigned int delta_time;
-	u64 cputime_speedadj;
-	int cpu_load;
-	struct cpufreq_interactive_cpuinfo *pcpu =
-		&per_cpu(cpuinfo, data);
-	unsigned int new_freq;
-	unsigned int loadadjfreq;
-	unsigned int index;
-	unsigned long flags;
-	bool boosted;
-	unsigned long mod_min_sample_time;
-	int i, max_load;
-	unsigned int max_freq;
-	struct cpufreq_interactive_cpuinfo *picpu;
-
-	if (!down_read_trylock(&pcpu->enable_sem))
-		return;
-	if (!pcpu->governor_enabled)
-		goto exit;
+	u64 now_idle;
 
-	spin_lock_irqsave(&pcpu->load_lock, flags);
-	now = update_load(data);
-	delta_time = (unsigned int)(now - pcpu->cputime_speedadj_timestamp);
-	cputime_speedadj = pcpu->cputime_speedadj;
-	spin_unlock_irqrestore(&pcpu->load_lock, flags);
+	now_idle = get_cpu_idle_time(cpu, &now,
+				     pcpu->ppol->tunables->io_is_busy);
+	__update_load(pcpu, now, now_idle);
+	return now;
+}
 
-	if (WARN_ON_ONCE(!delta_time))
-		goto rearm;
+/*
+ * Decide the next target speed for @pcpu from the speed-adjusted load
+ * of the window ending at @now.  On success the speed to set is
+ * returned in *@new_freq, which may equal the current target.  Returns
+ * -EAGAIN, with the speed that was wanted in *@new_freq, when hispeed or
+ * floor hold times do not allow a change yet.
+ *
+ * @cpu is used only to fold in the load of the other CPUs for
+ * sync_freq; pass a negative value to evaluate @pcpu on its own.
+ */
+static int cpufreq_interactive_evaluate(
+	struct cpufreq_interactive_cpuinfo *pcpu, int cpu, u64 now,
+	unsigned int loadadjfreq, int cpu_load, unsigned int *new_freq)
+{
+	struct cpufreq_interactive_tunables *tunables = pcpu->ppol->tunables;
+	struct cpufreq_interactive_cpuinfo *picpu;
+	unsigned long mod_min_sample_time;
+	unsigned int max_freq;
+	unsigned int index;
+	int i, max_load;
+	unsigned int freq;
+	bool boosted;
 
-	do_div(cputime_speedadj, delta_time);
-	loadadjfreq = (unsigned int)cputime_speedadj * 100;
-	cpu_load = loadadjfreq / pcpu->target_freq;
-	pcpu->prev_load = cpu_load;
-	boosted = boost_val || now < boostpulse_endtime;
+	boosted = tunables->boost_val || now < tunables->boostpulse_endtime;
 
-	if (cpu_load >= go_hispeed_load || boosted) {
-		if (pcpu->target_freq < hispeed_freq) {
-			new_freq = hispeed_freq;
+	if (cpu_load >= tunables->go_hispeed_load || boosted) {
+		if (pcpu->target_freq < tunables->hispeed_freq) {
+			freq = tunables->hispeed_freq;
 		} else {
-			new_freq = choose_freq(pcpu, loadadjfreq);
+			freq = choose_freq(pcpu, loadadjfreq);
 
-			if (new_freq < hispeed_freq)
-				new_freq = hispeed_freq;
+			if (freq < tunables->hispeed_freq)
+				freq = tunables->hispeed_freq;
 		}
 	} else {
-		new_freq = choose_freq(pcpu, loadadjfreq);
+		freq = choose_freq(pcpu, loadadjfreq);
 
-		if (sync_freq && new_freq < sync_freq) {
+		if (cpu >= 0 && tunables->sync_freq &&
+		    freq < tunables->sync_freq) {
 
 			max_load = 0;
 			max_freq = 0;
@@ -440,55 +490,51 @@ static void cpufreq_interactive_timer(unsigned long data)
 			for_each_online_cpu(i) {
 				picpu = &per_cpu(cpuinfo, i);
 
-				if (i == data || picpu->prev_load <
-						up_threshold_any_cpu_load)
+				if (i == cpu || picpu->prev_load <
+				    tunables->up_threshold_any_cpu_load)
 					continue;
 
 				max_load = max(max_load, picpu->prev_load);
 				max_freq = max(max_freq, picpu->policy->cur);
 			}
 
-			if (max_freq > up_threshold_any_cpu_freq &&
-				max_load >= up_threshold_any_cpu_load)
-				new_freq = sync_freq;
+			if (max_freq > tunables->up_threshold_any_cpu_freq &&
+				max_load >= tunables->up_threshold_any_cpu_load)
+				freq = tunables->sync_freq;
 		}
 	}
 
-	if (pcpu->target_freq >= hispeed_freq &&
-	    new_freq > pcpu->target_freq &&
+	*new_freq = freq;
+
+	if (pcpu->target_freq >= tunables->hispeed_freq &&
+	    freq > pcpu->target_freq &&
 	    now - pcpu->hispeed_validate_time <
-	    freq_to_above_hispeed_delay(pcpu->target_freq)) {
-		trace_cpufreq_interactive_notyet(
-			data, cpu_load, pcpu->target_freq,
-			pcpu->policy->cur, new_freq);
-		goto rearm;
-	}
+	    freq_to_above_hispeed_delay(tunables, pcpu->target_freq))
+		return -EAGAIN;
 
 	pcpu->hispeed_validate_time = now;
 
 	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
-					   new_freq, CPUFREQ_RELATION_L,
+					   freq, CPUFREQ_RELATION_L,
 					   &index))
-		goto rearm;
+		return -EINVAL;
 
-	new_freq = pcpu->freq_table[index].frequency;
+	freq = pcpu->freq_table[index].frequency;
+	*new_freq = freq;
 
 	/*
 	 * Do not scale below floor_freq unless we have been at or above the
 	 * floor frequency for the minimum sample time since last validated.
 	 */
-	if (sampling_down_factor && pcpu->policy->cur == pcpu->policy->max)
-		mod_min_sample_time = sampling_down_factor;
+	if (tunables->sampling_down_factor &&
+	    pcpu->policy->cur == pcpu->policy->max)
+		mod_min_sample_time = tunables->sampling_down_factor;
 	else
-		mod_min_sample_time = min_sample_time;
-
-	if (new_freq < pcpu->floor_freq) {
-		if (now - pcpu->floor_validate_time < mod_min_sample_time) {
-			trace_cpufreq_interactive_notyet(
-				data, cpu_load, pcpu->target_freq,
-				pcpu->policy->cur, new_freq);
-			goto rearm;
-		}
+		mod_min_sample_time = tunables->min_sample_time;
+
+	if (freq < pcpu->floor_freq) {
+		if (now - pcpu->floor_validate_time < mod_min_sample_time)
+			return -EAGAIN;
 	}
 
 	/*
@@ -499,11 +545,59 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 * (or the indefinite boost is turned off).
 	 */
 
-	if (!boosted || new_freq > hispeed_freq) {
-		pcpu->floor_freq = new_freq;
+	if (!boosted || freq > tunables->hispeed_freq) {
+		pcpu->floor_freq = freq;
 		pcpu->floor_validate_time = now;
 	}
 
+	return 0;
+}
+
+static void cpufreq_interactive_timer(unsigned long data)
+{
+	u64 now;
+	u64 now_idle;
+	unsigned int delta_time;
+	u64 cputime_speedadj;
+	int cpu_load;
+	struct cpufreq_interactive_cpuinfo *pcpu =
+		&per_cpu(cpuinfo, data);
+	unsigned int new_freq;
+	unsigned int loadadjfreq;
+	unsigned long flags;
+	int rc;
+
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return;
+	if (!pcpu->governor_enabled)
+		goto exit;
+
+	spin_lock_irqsave(&pcpu->load_lock, flags);
+	now = update_load(data);
+	now_idle = pcpu->time_in_idle;
+	delta_time = (unsigned int)(now - pcpu->cputime_speedadj_timestamp);
+	cputime_speedadj = pcpu->cputime_speedadj;
+	spin_unlock_irqrestore(&pcpu->load_lock, flags);
+
+	trace_cpufreq_interactive_sample(data, now, now_idle);
+
+	if (WARN_ON_ONCE(!delta_time))
+		goto rearm;
+
+	do_div(cputime_speedadj, delta_time);
+	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+	cpu_load = loadadjfreq / pcpu->target_freq;
+	pcpu->prev_load = cpu_load;
+
+	rc = cpufreq_interactive_evaluate(pcpu, data, now, loadadjfreq,
+					  cpu_load, &new_freq);
+	if (rc == -EAGAIN)
+		trace_cpufreq_interactive_notyet(
+			data, cpu_load, pcpu->target_freq,
+			pcpu->policy->cur, new_freq);
+	if (rc)
+		goto rearm;
+
 	if (pcpu->target_freq == new_freq) {
 		trace_cpufreq_interactive_already(
 			data, cpu_load, pcpu->target_freq,
@@ -515,10 +609,10 @@ static void cpufreq_interactive_timer(unsigned long data)
 					 pcpu->policy->cur, new_freq);
 
 	pcpu->target_freq = new_freq;
-	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
-	cpumask_set_cpu(data, &speedchange_cpumask);
-	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
-	wake_up_process(speedchange_task);
+	spin_lock_irqsave(&pcpu->ppol->speedchange_cpumask_lock, flags);
+	cpumask_set_cpu(data, &pcpu->ppol->speedchange_cpumask);
+	spin_unlock_irqrestore(&pcpu->ppol->speedchange_cpumask_lock, flags);
+	wake_up_process(pcpu->ppol->speedchange_task);
 
 rearm_if_notmax:
 	/*
@@ -604,6 +698,7 @@ static void cpufreq_interactive_idle_end(void)
 
 static int cpufreq_interactive_speedchange_task(void *data)
 {
+	struct cpufreq_interactive_policyinfo *ppol = data;
 	unsigned int cpu;
 	cpumask_t tmp_mask;
 	unsigned long flags;
@@ -611,23 +706,24 @@ static int cpufreq_interactive_speedchange_task(void *data)
 
 	while (1) {
 		set_current_state(TASK_INTERRUPTIBLE);
-		spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+		spin_lock_irqsave(&ppol->speedchange_cpumask_lock, flags);
 
-		if (cpumask_empty(&speedchange_cpumask)) {
-			spin_unlock_irqrestore(&speedchange_cpumask_lock,
+		if (cpumask_empty(&ppol->speedchange_cpumask)) {
+			spin_unlock_irqrestore(&ppol->speedchange_cpumask_lock,
 					       flags);
 			schedule();
 
 			if (kthread_should_stop())
 				break;
 
-			spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+			spin_lock_irqsave(&ppol->speedchange_cpumask_lock,
+					  flags);
 		}
 
 		set_current_state(TASK_RUNNING);
-		tmp_mask = speedchange_cpumask;
-		cpumask_clear(&speedchange_cpumask);
-		spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+		tmp_mask = ppol->speedchange_cpumask;
+		cpumask_clear(&ppol->speedchange_cpumask);
+		spin_unlock_irqrestore(&ppol->speedchange_cpumask_lock, flags);
 
 		for_each_cpu(cpu, &tmp_mask) {
 			unsigned int j;
@@ -664,21 +760,28 @@ static int cpufreq_interactive_speedchange_task(void *data)
 	return 0;
 }
 
-static void cpufreq_interactive_boost(void)
+/* Boost every online CPU whose policy uses @tunables. */
+static void cpufreq_interactive_boost(
+	struct cpufreq_interactive_tunables *tunables)
 {
 	int i;
-	int anyboost = 0;
+	int anyboost;
 	unsigned long flags;
 	struct cpufreq_interactive_cpuinfo *pcpu;
-
-	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+	struct cpufreq_interactive_policyinfo *ppol;
 
 	for_each_online_cpu(i) {
 		pcpu = &per_cpu(cpuinfo, i);
+		ppol = pcpu->ppol;
+		if (!ppol || ppol->tunables != tunables)
+			continue;
+
+		anyboost = 0;
+		spin_lock_irqsave(&ppol->speedchange_cpumask_lock, flags);
 
-		if (pcpu->target_freq < hispeed_freq) {
-			pcpu->target_freq = hispeed_freq;
-			cpumask_set_cpu(i, &speedchange_cpumask);
+		if (pcpu->target_freq < tunables->hispeed_freq) {
+			pcpu->target_freq = tunables->hispeed_freq;
+			cpumask_set_cpu(i, &ppol->speedchange_cpumask);
 			pcpu->hispeed_validate_time =
 				ktime_to_us(ktime_get());
 			anyboost = 1;
@@ -689,16 +792,168 @@ static void cpufreq_interactive_boost(void)
 		 * validated.
 		 */
 
-		pcpu->floor_freq = hispeed_freq;
+		pcpu->floor_freq = tunables->hispeed_freq;
 		pcpu->floor_validate_time = ktime_to_us(ktime_get());
+
+		spin_unlock_irqrestore(&ppol->speedchange_cpumask_lock, flags);
+
+		if (anyboost)
+			wake_up_process(ppol->speedchange_task);
 	}
+}
+
+/*
+ * Extend the boost pulse of @tunables to end at least @duration usecs
+ * from now.  A pulse that still has more than half of that left is not
+ * renewed, so bursts of events cost little.
+ */
+static void cpufreq_interactive_boost_for(
+	struct cpufreq_interactive_tunables *tunables, unsigned int duration,
+	const char *why)
+{
+	u64 now;
+
+	if (!duration)
+		return;
+
+	now = ktime_to_us(ktime_get());
+	if (tunables->boostpulse_endtime > now + duration / 2)
+		return;
+
+	tunables->boostpulse_endtime = now + duration;
+	trace_cpufreq_interactive_boost(why);
+	cpufreq_interactive_boost(tunables);
+}
+
+/* Pulse-boost every set of tunables in use.  Callable from atomic context. */
+static void cpufreq_interactive_boost_all(bool input)
+{
+	unsigned int cpu;
+	struct cpufreq_interactive_policyinfo *ppol;
+	struct cpufreq_interactive_tunables *tunables;
+
+	if (!per_policy) {
+		tunables = &common_tunables;
+		cpufreq_interactive_boost_for(tunables, input ?
+					      tunables->input_boost_duration :
+					      tunables->hint_boost_duration,
+					      input ? "input" : "hint");
+		return;
+	}
+
+	for_each_possible_cpu(cpu) {
+		ppol = per_cpu(polinfo, cpu);
+		if (!ppol)
+			continue;
+
+		tunables = ppol->tunables;
+		cpufreq_interactive_boost_for(tunables, input ?
+					      tunables->input_boost_duration :
+					      tunables->hint_boost_duration,
+					      input ? "input" : "hint");
+	}
+}
+
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE
+/**
+ * cpufreq_interactive_hint - ask for a short boost ahead of expected load
+ *
+ * For use by other kernel subsystems that know CPU work is about to
+ * arrive (e.g. a GPU frame submission) before the load-based timer can
+ * notice it.  Raises CPUs to at least hispeed_freq for
+ * hint_boost_duration usecs, or does nothing while that is zero.  May
+ * be called from atomic context.  Only available with the governor
+ * built in, as callers may be.
+ */
+void cpufreq_interactive_hint(void)
+{
+	cpufreq_interactive_boost_all(false);
+}
+EXPORT_SYMBOL_GPL(cpufreq_interactive_hint);
+#endif
+
+static void cpufreq_interactive_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	/* Boost on touch-down and key press, not on moves or releases */
+	if ((type == EV_KEY && value == 1) ||
+	    (type == EV_ABS && code == ABS_MT_TRACKING_ID && value != -1))
+		cpufreq_interactive_boost_all(true);
+}
 
-	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+static int cpufreq_interactive_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_interactive";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err2;
 
-	if (anyboost)
-		wake_up_process(speedchange_task);
+	error = input_open_device(handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return error;
 }
 
+static void cpufreq_interactive_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id cpufreq_interactive_ids[] = {
+	/* multi-touch touchscreen */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			BIT_MASK(ABS_MT_POSITION_X) |
+			BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	/* touchpad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	/* Keypad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	},
+	{ },
+};
+
+static bool input_handler_registered;
+
+static struct input_handler cpufreq_interactive_input_handler = {
+	.event		= cpufreq_interactive_input_event,
+	.connect	= cpufreq_interactive_input_connect,
+	.disconnect	= cpufreq_interactive_input_disconnect,
+	.name		= "cpufreq_interactive",
+	.id_table	= cpufreq_interactive_ids,
+};
+
 static int cpufreq_interactive_notifier(
 	struct notifier_block *nb, unsigned long val, void *data)
 {
@@ -743,6 +998,14 @@ static struct notifier_block cpufreq_notifier_block = {
 	.notifier_call = cpufreq_interactive_notifier,
 };
 
+static struct cpufreq_interactive_tunables *kobj_to_tunables(
+	struct kobject *kobj)
+{
+	if (kobj == cpufreq_global_kobject)
+		return &common_tunables;
+	return container_of(kobj, struct cpufreq_interactive_tunables, kobj);
+}
+
 static unsigned int *get_tokenized_data(const char *buf, int *num_tokens)
 {
 	const char *cp;
@@ -791,18 +1054,20 @@ err:
 static ssize_t show_target_loads(
 	struct kobject *kobj, struct attribute *attr, char *buf)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int i;
 	ssize_t ret = 0;
 	unsigned long flags;
 
-	spin_lock_irqsave(&target_loads_lock, flags);
+	spin_lock_irqsave(&tunables->target_loads_lock, flags);
 
-	for (i = 0; i < ntarget_loads; i++)
-		ret += sprintf(buf + ret, "%u%s", target_loads[i],
+	for (i = 0; i < tunables->ntarget_loads; i++)
+		ret += sprintf(buf + ret, "%u%s", tunables->target_loads[i],
 			       i & 0x1 ? ":" : " ");
 
 	ret += sprintf(buf + --ret, "\n");
-	spin_unlock_irqrestore(&target_loads_lock, flags);
+	spin_unlock_irqrestore(&tunables->target_loads_lock, flags);
 	return ret;
 }
 
@@ -810,6 +1075,8 @@ static ssize_t store_target_loads(
 	struct kobject *kobj, struct attribute *attr, const char *buf,
 	size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ntokens;
 	unsigned int *new_target_loads = NULL;
 	unsigned long flags;
@@ -818,12 +1085,12 @@ static ssize_t store_target_loads(
 	if (IS_ERR(new_target_loads))
 		return PTR_RET(new_target_loads);
 
-	spin_lock_irqsave(&target_loads_lock, flags);
-	if (target_loads != default_target_loads)
-		kfree(target_loads);
-	target_loads = new_target_loads;
-	ntarget_loads = ntokens;
-	spin_unlock_irqrestore(&target_loads_lock, flags);
+	spin_lock_irqsave(&tunables->target_loads_lock, flags);
+	if (tunables->target_loads != default_target_loads)
+		kfree(tunables->target_loads);
+	tunables->target_loads = new_target_loads;
+	tunables->ntarget_loads = ntokens;
+	spin_unlock_irqrestore(&tunables->target_loads_lock, flags);
 	return count;
 }
 
@@ -834,18 +1101,21 @@ static struct global_attr target_loads_attr =
 static ssize_t show_above_hispeed_delay(
 	struct kobject *kobj, struct attribute *attr, char *buf)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int i;
 	ssize_t ret = 0;
 	unsigned long flags;
 
-	spin_lock_irqsave(&above_hispeed_delay_lock, flags);
+	spin_lock_irqsave(&tunables->above_hispeed_delay_lock, flags);
 
-	for (i = 0; i < nabove_hispeed_delay; i++)
-		ret += sprintf(buf + ret, "%u%s", above_hispeed_delay[i],
+	for (i = 0; i < tunables->nabove_hispeed_delay; i++)
+		ret += sprintf(buf + ret, "%u%s",
+			       tunables->above_hispeed_delay[i],
 			       i & 0x1 ? ":" : " ");
 
 	ret += sprintf(buf + --ret, "\n");
-	spin_unlock_irqrestore(&above_hispeed_delay_lock, flags);
+	spin_unlock_irqrestore(&tunables->above_hispeed_delay_lock, flags);
 	return ret;
 }
 
@@ -853,6 +1123,8 @@ static ssize_t store_above_hispeed_delay(
 	struct kobject *kobj, struct attribute *attr, const char *buf,
 	size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ntokens;
 	unsigned int *new_above_hispeed_delay = NULL;
 	unsigned long flags;
@@ -861,12 +1133,12 @@ static ssize_t store_above_hispeed_delay(
 	if (IS_ERR(new_above_hispeed_delay))
 		return PTR_RET(new_above_hispeed_delay);
 
-	spin_lock_irqsave(&above_hispeed_delay_lock, flags);
-	if (above_hispeed_delay != default_above_hispeed_delay)
-		kfree(above_hispeed_delay);
-	above_hispeed_delay = new_above_hispeed_delay;
-	nabove_hispeed_delay = ntokens;
-	spin_unlock_irqrestore(&above_hispeed_delay_lock, flags);
+	spin_lock_irqsave(&tunables->above_hispeed_delay_lock, flags);
+	if (tunables->above_hispeed_delay != default_above_hispeed_delay)
+		kfree(tunables->above_hispeed_delay);
+	tunables->above_hispeed_delay = new_above_hispeed_delay;
+	tunables->nabove_hispeed_delay = ntokens;
+	spin_unlock_irqrestore(&tunables->above_hispeed_delay_lock, flags);
 	return count;
 
 }
@@ -878,20 +1150,25 @@ static struct global_attr above_hispeed_delay_attr =
 static ssize_t show_hispeed_freq(struct kobject *kobj,
 				 struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%u\n", hispeed_freq);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%u\n", tunables->hispeed_freq);
 }
 
 static ssize_t store_hispeed_freq(struct kobject *kobj,
 				  struct attribute *attr, const char *buf,
 				  size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	long unsigned int val;
 
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	hispeed_freq = val;
+	tunables->hispeed_freq = val;
 	return count;
 }
 
@@ -901,20 +1178,25 @@ static struct global_attr hispeed_freq_attr = __ATTR(hispeed_freq, 0644,
 static ssize_t show_sampling_down_factor(struct kobject *kobj,
 				struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%u\n", sampling_down_factor);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%u\n", tunables->sampling_down_factor);
 }
 
 static ssize_t store_sampling_down_factor(struct kobject *kobj,
 				struct attribute *attr, const char *buf,
 				size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	long unsigned int val;
 
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	sampling_down_factor = val;
+	tunables->sampling_down_factor = val;
 	return count;
 }
 
@@ -925,19 +1207,24 @@ static struct global_attr sampling_down_factor_attr =
 static ssize_t show_go_hispeed_load(struct kobject *kobj,
 				     struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", go_hispeed_load);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%lu\n", tunables->go_hispeed_load);
 }
 
 static ssize_t store_go_hispeed_load(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	go_hispeed_load = val;
+	tunables->go_hispeed_load = val;
 	return count;
 }
 
@@ -947,19 +1234,24 @@ static struct global_attr go_hispeed_load_attr = __ATTR(go_hispeed_load, 0644,
 static ssize_t show_min_sample_time(struct kobject *kobj,
 				struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", min_sample_time);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%lu\n", tunables->min_sample_time);
 }
 
 static ssize_t store_min_sample_time(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	min_sample_time = val;
+	tunables->min_sample_time = val;
 	return count;
 }
 
@@ -969,19 +1261,24 @@ static struct global_attr min_sample_time_attr = __ATTR(min_sample_time, 0644,
 static ssize_t show_timer_rate(struct kobject *kobj,
 			struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", timer_rate);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%lu\n", tunables->timer_rate);
 }
 
 static ssize_t store_timer_rate(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	timer_rate = val;
+	tunables->timer_rate = val;
 	return count;
 }
 
@@ -991,13 +1288,18 @@ static struct global_attr timer_rate_attr = __ATTR(timer_rate, 0644,
 static ssize_t show_timer_slack(
 	struct kobject *kobj, struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%d\n", timer_slack_val);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%d\n", tunables->timer_slack_val);
 }
 
 static ssize_t store_timer_slack(
 	struct kobject *kobj, struct attribute *attr, const char *buf,
 	size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
@@ -1005,7 +1307,7 @@ static ssize_t store_timer_slack(
 	if (ret < 0)
 		return ret;
 
-	timer_slack_val = val;
+	tunables->timer_slack_val = val;
 	return count;
 }
 
@@ -1014,12 +1316,17 @@ define_one_global_rw(timer_slack);
 static ssize_t show_boost(struct kobject *kobj, struct attribute *attr,
 			  char *buf)
 {
-	return sprintf(buf, "%d\n", boost_val);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%d\n", tunables->boost_val);
 }
 
 static ssize_t store_boost(struct kobject *kobj, struct attribute *attr,
 			   const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
@@ -1027,11 +1334,11 @@ static ssize_t store_boost(struct kobject *kobj, struct attribute *attr,
 	if (ret < 0)
 		return ret;
 
-	boost_val = val;
+	tunables->boost_val = val;
 
-	if (boost_val) {
+	if (tunables->boost_val) {
 		trace_cpufreq_interactive_boost("on");
-		cpufreq_interactive_boost();
+		cpufreq_interactive_boost(tunables);
 	} else {
 		trace_cpufreq_interactive_unboost("off");
 	}
@@ -1044,6 +1351,8 @@ define_one_global_rw(boost);
 static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
 				const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
@@ -1051,9 +1360,10 @@ static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
 	if (ret < 0)
 		return ret;
 
-	boostpulse_endtime = ktime_to_us(ktime_get()) + boostpulse_duration_val;
+	tunables->boostpulse_endtime = ktime_to_us(ktime_get()) +
+		tunables->boostpulse_duration_val;
 	trace_cpufreq_interactive_boost("pulse");
-	cpufreq_interactive_boost();
+	cpufreq_interactive_boost(tunables);
 	return count;
 }
 
@@ -1063,13 +1373,18 @@ static struct global_attr boostpulse =
 static ssize_t show_boostpulse_duration(
 	struct kobject *kobj, struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%d\n", boostpulse_duration_val);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%d\n", tunables->boostpulse_duration_val);
 }
 
 static ssize_t store_boostpulse_duration(
 	struct kobject *kobj, struct attribute *attr, const char *buf,
 	size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
@@ -1077,28 +1392,89 @@ static ssize_t store_boostpulse_duration(
 	if (ret < 0)
 		return ret;
 
-	boostpulse_duration_val = val;
+	tunables->boostpulse_duration_val = val;
 	return count;
 }
 
 define_one_global_rw(boostpulse_duration);
 
+static ssize_t show_input_boost_duration(
+	struct kobject *kobj, struct attribute *attr, char *buf)
+{
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%d\n", tunables->input_boost_duration);
+}
+
+static ssize_t store_input_boost_duration(
+	struct kobject *kobj, struct attribute *attr, const char *buf,
+	size_t count)
+{
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	tunables->input_boost_duration = val;
+	return count;
+}
+
+define_one_global_rw(input_boost_duration);
+
+static ssize_t show_hint_boost_duration(
+	struct kobject *kobj, struct attribute *attr, char *buf)
+{
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%d\n", tunables->hint_boost_duration);
+}
+
+static ssize_t store_hint_boost_duration(
+	struct kobject *kobj, struct attribute *attr, const char *buf,
+	size_t count)
+{
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	tunables->hint_boost_duration = val;
+	return count;
+}
+
+define_one_global_rw(hint_boost_duration);
+
 static ssize_t show_io_is_busy(struct kobject *kobj,
 			struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%u\n", io_is_busy);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%u\n", tunables->io_is_busy);
 }
 
 static ssize_t store_io_is_busy(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
 	ret = kstrtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	io_is_busy = val;
+	tunables->io_is_busy = val;
 	return count;
 }
 
@@ -1108,19 +1484,24 @@ static struct global_attr io_is_busy_attr = __ATTR(io_is_busy, 0644,
 static ssize_t show_sync_freq(struct kobject *kobj,
 			struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%u\n", sync_freq);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return sprintf(buf, "%u\n", tunables->sync_freq);
 }
 
 static ssize_t store_sync_freq(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
 	ret = kstrtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	sync_freq = val;
+	tunables->sync_freq = val;
 	return count;
 }
 
@@ -1130,19 +1511,25 @@ static struct global_attr sync_freq_attr = __ATTR(sync_freq, 0644,
 static ssize_t show_up_threshold_any_cpu_load(struct kobject *kobj,
 			struct attribute *attr, char *buf)
 {
-	return snprintf(buf, PAGE_SIZE, "%u\n", up_threshold_any_cpu_load);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			tunables->up_threshold_any_cpu_load);
 }
 
 static ssize_t store_up_threshold_any_cpu_load(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
 	ret = kstrtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	up_threshold_any_cpu_load = val;
+	tunables->up_threshold_any_cpu_load = val;
 	return count;
 }
 
@@ -1154,19 +1541,25 @@ static struct global_attr up_threshold_any_cpu_load_attr =
 static ssize_t show_up_threshold_any_cpu_freq(struct kobject *kobj,
 			struct attribute *attr, char *buf)
 {
-	return snprintf(buf, PAGE_SIZE, "%u\n", up_threshold_any_cpu_freq);
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			tunables->up_threshold_any_cpu_freq);
 }
 
 static ssize_t store_up_threshold_any_cpu_freq(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
 	int ret;
 	unsigned long val;
 
 	ret = kstrtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	up_threshold_any_cpu_freq = val;
+	tunables->up_threshold_any_cpu_freq = val;
 	return count;
 }
 
@@ -1186,6 +1579,8 @@ static struct attribute *interactive_attributes[] = {
 	&boost.attr,
 	&boostpulse.attr,
 	&boostpulse_duration.attr,
+	&input_boost_duration.attr,
+	&hint_boost_duration.attr,
 	&io_is_busy_attr.attr,
 	&sampling_down_factor_attr.attr,
 	&sync_freq_attr.attr,
@@ -1199,6 +1594,126 @@ static struct attribute_group interactive_attr_group = {
 	.name = "interactive",
 };
 
+static ssize_t interactive_sysfs_show(struct kobject *kobj,
+				      struct attribute *attr, char *buf)
+{
+	struct global_attr *gattr = container_of(attr, struct global_attr,
+						 attr);
+
+	if (!gattr->show)
+		return -EIO;
+	return gattr->show(kobj, attr, buf);
+}
+
+static ssize_t interactive_sysfs_store(struct kobject *kobj,
+				       struct attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct global_attr *gattr = container_of(attr, struct global_attr,
+						 attr);
+
+	if (!gattr->store)
+		return -EIO;
+	return gattr->store(kobj, attr, buf, count);
+}
+
+static const struct sysfs_ops interactive_sysfs_ops = {
+	.show = interactive_sysfs_show,
+	.store = interactive_sysfs_store,
+};
+
+static void interactive_tunables_release(struct kobject *kobj)
+{
+	struct cpufreq_interactive_tunables *tunables =
+		kobj_to_tunables(kobj);
+
+	if (tunables->target_loads != default_target_loads)
+		kfree(tunables->target_loads);
+	if (tunables->above_hispeed_delay != default_above_hispeed_delay)
+		kfree(tunables->above_hispeed_delay);
+	kfree(tunables);
+}
+
+static struct kobj_type interactive_tunables_ktype = {
+	.sysfs_ops = &interactive_sysfs_ops,
+	.default_attrs = interactive_attributes,
+	.release = interactive_tunables_release,
+};
+
+static void cpufreq_interactive_tunables_init(
+	struct cpufreq_interactive_tunables *tunables)
+{
+	tunables->go_hispeed_load = DEFAULT_GO_HISPEED_LOAD;
+	spin_lock_init(&tunables->target_loads_lock);
+	tunables->target_loads = default_target_loads;
+	tunables->ntarget_loads = ARRAY_SIZE(default_target_loads);
+	tunables->min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
+	tunables->timer_rate = DEFAULT_TIMER_RATE;
+	spin_lock_init(&tunables->above_hispeed_delay_lock);
+	tunables->above_hispeed_delay = default_above_hispeed_delay;
+	tunables->nabove_hispeed_delay =
+		ARRAY_SIZE(default_above_hispeed_delay);
+	tunables->boostpulse_duration_val = DEFAULT_MIN_SAMPLE_TIME;
+	tunables->timer_slack_val = DEFAULT_TIMER_SLACK;
+}
+
+/*
+ * Look up, or on first start create, the state for the policy.  Called
+ * with gov_lock held.
+ */
+static struct cpufreq_interactive_policyinfo *
+cpufreq_interactive_policyinfo_get(struct cpufreq_policy *policy)
+{
+	unsigned int first = cpumask_first(policy->related_cpus);
+	struct cpufreq_interactive_policyinfo *ppol = per_cpu(polinfo, first);
+	struct cpufreq_interactive_tunables *tunables;
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+
+	if (ppol)
+		return ppol;
+
+	ppol = kzalloc(sizeof(*ppol), GFP_KERNEL);
+	if (!ppol)
+		return ERR_PTR(-ENOMEM);
+
+	spin_lock_init(&ppol->speedchange_cpumask_lock);
+
+	if (per_policy) {
+		tunables = kzalloc(sizeof(*tunables), GFP_KERNEL);
+		if (!tunables) {
+			kfree(ppol);
+			return ERR_PTR(-ENOMEM);
+		}
+		cpufreq_interactive_tunables_init(tunables);
+		kobject_init(&tunables->kobj, &interactive_tunables_ktype);
+		ppol->own_tunables = tunables;
+		ppol->tunables = tunables;
+	} else {
+		ppol->tunables = &common_tunables;
+	}
+
+	ppol->speedchange_task =
+		kthread_create(cpufreq_interactive_speedchange_task, ppol,
+			       "cfinteractive/%u", first);
+	if (IS_ERR(ppol->speedchange_task)) {
+		int err = PTR_ERR(ppol->speedchange_task);
+
+		if (ppol->own_tunables)
+			kobject_put(&ppol->own_tunables->kobj);
+		kfree(ppol);
+		return ERR_PTR(err);
+	}
+
+	sched_setscheduler_nocheck(ppol->speedchange_task, SCHED_FIFO, &param);
+	get_task_struct(ppol->speedchange_task);
+
+	/* NB: wake up so the thread does not look hung to the freezer */
+	wake_up_process(ppol->speedchange_task);
+
+	per_cpu(polinfo, first) = ppol;
+	return ppol;
+}
+
 static int cpufreq_interactive_idle_notifier(struct notifier_block *nb,
 					     unsigned long val,
 					     void *data)
@@ -1225,6 +1740,8 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 	int rc;
 	unsigned int j;
 	struct cpufreq_interactive_cpuinfo *pcpu;
+	struct cpufreq_interactive_policyinfo *ppol;
+	struct cpufreq_interactive_tunables *tunables;
 	struct cpufreq_frequency_table *freq_table;
 
 	switch (event) {
@@ -1234,13 +1751,30 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 
 		mutex_lock(&gov_lock);
 
+		ppol = cpufreq_interactive_policyinfo_get(policy);
+		if (IS_ERR(ppol)) {
+			mutex_unlock(&gov_lock);
+			return PTR_ERR(ppol);
+		}
+		tunables = ppol->tunables;
+
+		if (per_policy) {
+			rc = kobject_add(&tunables->kobj, &policy->kobj,
+					 "interactive");
+			if (rc) {
+				mutex_unlock(&gov_lock);
+				return rc;
+			}
+		}
+
 		freq_table =
 			cpufreq_frequency_get_table(policy->cpu);
-		if (!hispeed_freq)
-			hispeed_freq = policy->max;
+		if (!tunables->hispeed_freq)
+			tunables->hispeed_freq = policy->max;
 
 		for_each_cpu(j, policy->cpus) {
 			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->ppol = ppol;
 			pcpu->policy = policy;
 			pcpu->target_freq = policy->cur;
 			pcpu->freq_table = freq_table;
@@ -1264,16 +1798,23 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			return 0;
 		}
 
-		rc = sysfs_create_group(cpufreq_global_kobject,
-				&interactive_attr_group);
-		if (rc) {
-			mutex_unlock(&gov_lock);
-			return rc;
+		if (!per_policy) {
+			rc = sysfs_create_group(cpufreq_global_kobject,
+					&interactive_attr_group);
+			if (rc) {
+				mutex_unlock(&gov_lock);
+				return rc;
+			}
 		}
 
 		idle_notifier_register(&cpufreq_interactive_idle_nb);
 		cpufreq_register_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
+		rc = input_register_handler(&cpufreq_interactive_input_handler);
+		if (rc)
+			pr_warn("%s: failed to register input handler: %d\n",
+				__func__, rc);
+		input_handler_registered = !rc;
 		mutex_unlock(&gov_lock);
 		break;
 
@@ -1288,16 +1829,27 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			up_write(&pcpu->enable_sem);
 		}
 
+		if (per_policy) {
+			ppol = per_cpu(polinfo,
+				       cpumask_first(policy->related_cpus));
+			if (ppol)
+				kobject_del(&ppol->tunables->kobj);
+		}
+
 		if (--active_count > 0) {
 			mutex_unlock(&gov_lock);
 			return 0;
 		}
 
+		if (input_handler_registered)
+			input_unregister_handler(
+				&cpufreq_interactive_input_handler);
 		cpufreq_unregister_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
 		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
-		sysfs_remove_group(cpufreq_global_kobject,
-				&interactive_attr_group);
+		if (!per_policy)
+			sysfs_remove_group(cpufreq_global_kobject,
+					&interactive_attr_group);
 		mutex_unlock(&gov_lock);
 
 		break;
@@ -1341,6 +1893,375 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 	return 0;
 }
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Offline replay of recorded load through the governor's decision code,
+ * so that tunables can be compared deterministically.  Lines written to
+ * <debugfs>/cpufreq_interactive/replay are one of:
+ *
+ *   reset                  drop all replay state and results
+ *   freqs <khz> <khz> ...  speeds to simulate (default: CPU 0's table)
+ *   <now_us> <idle_us>     one sample, as logged for a CPU by the
+ *                          cpufreq_interactive_sample trace event
+ *
+ * The first sample snapshots the tunables in use by CPU 0 (boosts
+ * cleared) and starts at the lowest speed.  Every later sample is
+ * evaluated as if the sampling timer had fired then, and the chosen
+ * speed takes effect at once.  Reading the file gives one
+ * "<now_us> <load> <target_khz>" line per evaluated sample.
+ */
+#define REPLAY_MAX_FREQS	64
+#define REPLAY_MAX_SAMPLES	16384
+
+struct replay_result {
+	u64 now;
+	unsigned int load;
+	unsigned int freq;
+};
+
+static DEFINE_MUTEX(replay_lock);
+
+static struct {
+	struct cpufreq_interactive_cpuinfo pcpu;
+	struct cpufreq_interactive_policyinfo ppol;
+	struct cpufreq_interactive_tunables tunables;
+	struct cpufreq_policy policy;
+	struct cpufreq_frequency_table table[REPLAY_MAX_FREQS + 1];
+	unsigned int nfreqs;
+	bool started;
+	char line[16 + REPLAY_MAX_FREQS * 11];
+	unsigned int line_len;
+	struct replay_result *results;
+	unsigned int nresults;
+} replay;
+
+static struct dentry *replay_dir;
+
+static int replay_add_freq(unsigned int freq)
+{
+	struct cpufreq_policy *policy = &replay.policy;
+
+	if (replay.nfreqs == REPLAY_MAX_FREQS)
+		return -ENOSPC;
+
+	if (!replay.nfreqs || freq < policy->min)
+		policy->min = freq;
+	if (!replay.nfreqs || freq > policy->max)
+		policy->max = freq;
+
+	replay.table[replay.nfreqs].index = replay.nfreqs;
+	replay.table[replay.nfreqs].frequency = freq;
+	replay.nfreqs++;
+	replay.table[replay.nfreqs].index = replay.nfreqs;
+	replay.table[replay.nfreqs].frequency = CPUFREQ_TABLE_END;
+	return 0;
+}
+
+static int replay_set_freqs(char *args)
+{
+	unsigned int freq;
+	char *tok;
+	int rc;
+
+	replay.nfreqs = 0;
+	while ((tok = strsep(&args, " \t")) != NULL) {
+		if (!*tok)
+			continue;
+		rc = kstrtouint(tok, 0, &freq);
+		if (!rc)
+			rc = replay_add_freq(freq);
+		if (rc) {
+			replay.nfreqs = 0;
+			return rc;
+		}
+	}
+
+	return replay.nfreqs ? 0 : -EINVAL;
+}
+
+static void replay_free_tunables(void)
+{
+	struct cpufreq_interactive_tunables *tunables = &replay.tunables;
+
+	if (tunables->target_loads != default_target_loads)
+		kfree(tunables->target_loads);
+	if (tunables->above_hispeed_delay != default_above_hispeed_delay)
+		kfree(tunables->above_hispeed_delay);
+	tunables->target_loads = NULL;
+	tunables->above_hispeed_delay = NULL;
+}
+
+static int replay_copy_tunables(void)
+{
+	struct cpufreq_interactive_policyinfo *ppol = per_cpu(polinfo, 0);
+	struct cpufreq_interactive_tunables *src =
+		ppol ? ppol->tunables : &common_tunables;
+	struct cpufreq_interactive_tunables *tunables = &replay.tunables;
+	unsigned int *loads, *delays;
+	unsigned long flags;
+
+	memcpy(tunables, src, sizeof(*tunables));
+	memset(&tunables->kobj, 0, sizeof(tunables->kobj));
+	spin_lock_init(&tunables->target_loads_lock);
+	spin_lock_init(&tunables->above_hispeed_delay_lock);
+	tunables->boost_val = 0;
+	tunables->boostpulse_endtime = 0;
+
+	spin_lock_irqsave(&src->target_loads_lock, flags);
+	tunables->ntarget_loads = src->ntarget_loads;
+	loads = kmemdup(src->target_loads,
+			src->ntarget_loads * sizeof(*loads), GFP_ATOMIC);
+	spin_unlock_irqrestore(&src->target_loads_lock, flags);
+
+	spin_lock_irqsave(&src->above_hispeed_delay_lock, flags);
+	tunables->nabove_hispeed_delay = src->nabove_hispeed_delay;
+	delays = kmemdup(src->above_hispeed_delay,
+			 src->nabove_hispeed_delay * sizeof(*delays),
+			 GFP_ATOMIC);
+	spin_unlock_irqrestore(&src->above_hispeed_delay_lock, flags);
+
+	tunables->target_loads = loads;
+	tunables->above_hispeed_delay = delays;
+	if (!loads || !delays) {
+		replay_free_tunables();
+		return -ENOMEM;
+	}
+
+	if (!tunables->hispeed_freq)
+		tunables->hispeed_freq = replay.policy.max;
+	return 0;
+}
+
+static void replay_reset(void)
+{
+	if (replay.started)
+		replay_free_tunables();
+	replay.started = false;
+	replay.nfreqs = 0;
+	replay.nresults = 0;
+}
+
+static int replay_start(u64 now, u64 now_idle)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &replay.pcpu;
+	struct cpufreq_frequency_table *table;
+	int i, rc;
+
+	if (!replay.nfreqs) {
+		table = cpufreq_frequency_get_table(0);
+		if (!table)
+			return -ENODEV;
+
+		for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+			if (table[i].frequency == CPUFREQ_ENTRY_INVALID)
+				continue;
+			rc = replay_add_freq(table[i].frequency);
+			if (rc)
+				return rc;
+		}
+		if (!replay.nfreqs)
+			return -ENODEV;
+	}
+
+	if (!replay.results) {
+		replay.results = vmalloc(REPLAY_MAX_SAMPLES *
+					 sizeof(*replay.results));
+		if (!replay.results)
+			return -ENOMEM;
+	}
+
+	rc = replay_copy_tunables();
+	if (rc)
+		return rc;
+
+	replay.ppol.tunables = &replay.tunables;
+	replay.policy.cur = replay.policy.min;
+
+	memset(pcpu, 0, sizeof(*pcpu));
+	pcpu->ppol = &replay.ppol;
+	pcpu->policy = &replay.policy;
+	pcpu->freq_table = replay.table;
+	pcpu->target_freq = replay.policy.cur;
+	pcpu->floor_freq = pcpu->target_freq;
+	pcpu->floor_validate_time = now;
+	pcpu->hispeed_validate_time = now;
+	pcpu->time_in_idle = now_idle;
+	pcpu->time_in_idle_timestamp = now;
+	pcpu->cputime_speedadj_timestamp = now;
+
+	replay.nresults = 0;
+	replay.started = true;
+	return 0;
+}
+
+static int replay_sample(u64 now, u64 now_idle)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &replay.pcpu;
+	struct replay_result *res;
+	unsigned int new_freq;
+	unsigned int loadadjfreq;
+	u64 cputime_speedadj;
+	int cpu_load;
+
+	if (!replay.started)
+		return replay_start(now, now_idle);
+
+	if (now <= pcpu->cputime_speedadj_timestamp)
+		return -EINVAL;
+	if (replay.nresults == REPLAY_MAX_SAMPLES)
+		return -ENOSPC;
+
+	__update_load(pcpu, now, now_idle);
+	cputime_speedadj = pcpu->cputime_speedadj;
+	do_div(cputime_speedadj,
+	       (unsigned int)(now - pcpu->cputime_speedadj_timestamp));
+	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+	cpu_load = loadadjfreq / pcpu->target_freq;
+	pcpu->prev_load = cpu_load;
+
+	if (!cpufreq_interactive_evaluate(pcpu, -1, now, loadadjfreq,
+					  cpu_load, &new_freq)) {
+		pcpu->target_freq = new_freq;
+		replay.policy.cur = new_freq;
+	}
+
+	/* Start the next window, as the timer does when it rearms. */
+	pcpu->cputime_speedadj = 0;
+	pcpu->cputime_speedadj_timestamp = now;
+
+	res = &replay.results[replay.nresults++];
+	res->now = now;
+	res->load = cpu_load;
+	res->freq = pcpu->target_freq;
+	return 0;
+}
+
+static int replay_line(char *line)
+{
+	unsigned long long now, now_idle;
+	char *p = strim(line);
+
+	if (!*p || *p == '#')
+		return 0;
+
+	if (!strcmp(p, "reset")) {
+		replay_reset();
+		return 0;
+	}
+
+	if (!strncmp(p, "freqs", 5)) {
+		if (replay.started)
+			return -EBUSY;
+		return replay_set_freqs(p + 5);
+	}
+
+	if (sscanf(p, "%llu %llu", &now, &now_idle) != 2)
+		return -EINVAL;
+
+	return replay_sample(now, now_idle);
+}
+
+static ssize_t replay_write(struct file *file, const char __user *ubuf,
+			    size_t count, loff_t *ppos)
+{
+	size_t done;
+	int rc = 0;
+	char c;
+
+	mutex_lock(&replay_lock);
+	for (done = 0; done < count; done++) {
+		if (get_user(c, ubuf + done)) {
+			rc = -EFAULT;
+			break;
+		}
+
+		if (c != '\n') {
+			if (replay.line_len == sizeof(replay.line) - 1) {
+				replay.line_len = 0;
+				rc = -EINVAL;
+				break;
+			}
+			replay.line[replay.line_len++] = c;
+			continue;
+		}
+
+		replay.line[replay.line_len] = '\0';
+		replay.line_len = 0;
+		rc = replay_line(replay.line);
+		if (rc)
+			break;
+	}
+	mutex_unlock(&replay_lock);
+
+	return rc ? rc : count;
+}
+
+static void *replay_seq_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&replay_lock);
+	return *pos < replay.nresults ? &replay.results[*pos] : NULL;
+}
+
+static void *replay_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return *pos < replay.nresults ? &replay.results[*pos] : NULL;
+}
+
+static void replay_seq_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&replay_lock);
+}
+
+static int replay_seq_show(struct seq_file *m, void *v)
+{
+	struct replay_result *res = v;
+
+	seq_printf(m, "%llu %u %u\n", (unsigned long long)res->now,
+		   res->load, res->freq);
+	return 0;
+}
+
+static const struct seq_operations replay_seq_ops = {
+	.start = replay_seq_start,
+	.next = replay_seq_next,
+	.stop = replay_seq_stop,
+	.show = replay_seq_show,
+};
+
+static int replay_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &replay_seq_ops);
+}
+
+static const struct file_operations replay_fops = {
+	.open = replay_open,
+	.read = seq_read,
+	.write = replay_write,
+	.llseek = seq_lseek,
+	.release = seq_release,
+};
+
+static void cpufreq_interactive_replay_init(void)
+{
+	replay_dir = debugfs_create_dir("cpufreq_interactive", NULL);
+	if (IS_ERR_OR_NULL(replay_dir))
+		return;
+	debugfs_create_file("replay", S_IRUSR | S_IWUSR, replay_dir, NULL,
+			    &replay_fops);
+}
+
+static void cpufreq_interactive_replay_exit(void)
+{
+	debugfs_remove_recursive(replay_dir);
+	replay_reset();
+	vfree(replay.results);
+}
+#else
+static inline void cpufreq_interactive_replay_init(void) { }
+static inline void cpufreq_interactive_replay_exit(void) { }
+#endif
+
 static void cpufreq_interactive_nop_timer(unsigned long data)
 {
 }
@@ -1348,8 +2269,8 @@ static void cpufreq_interactive_nop_timer(unsigned long data)
 static int __init cpufreq_interactive_init(void)
 {
 	unsigned int i;
+	int rc;
 	struct cpufreq_interactive_cpuinfo *pcpu;
-	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
@@ -1363,23 +2284,13 @@ static int __init cpufreq_interactive_init(void)
 		init_rwsem(&pcpu->enable_sem);
 	}
 
-	spin_lock_init(&target_loads_lock);
-	spin_lock_init(&speedchange_cpumask_lock);
-	spin_lock_init(&above_hispeed_delay_lock);
+	cpufreq_interactive_tunables_init(&common_tunables);
 	mutex_init(&gov_lock);
-	speedchange_task =
-		kthread_create(cpufreq_interactive_speedchange_task, NULL,
-			       "cfinteractive");
-	if (IS_ERR(speedchange_task))
-		return PTR_ERR(speedchange_task);
-
-	sched_setscheduler_nocheck(speedchange_task, SCHED_FIFO, &param);
-	get_task_struct(speedchange_task);
 
-	/* NB: wake up so the thread does not look hung to the freezer */
-	wake_up_process(speedchange_task);
-
-	return cpufreq_register_governor(&cpufreq_gov_interactive);
+	rc = cpufreq_register_governor(&cpufreq_gov_interactive);
+	if (!rc)
+		cpufreq_interactive_replay_init();
+	return rc;
 }
 
 #ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
@@ -1390,9 +2301,29 @@ module_init(cpufreq_interactive_init);
 
 static void __exit cpufreq_interactive_exit(void)
 {
+	unsigned int cpu;
+	struct cpufreq_interactive_policyinfo *ppol;
+
 	cpufreq_unregister_governor(&cpufreq_gov_interactive);
-	kthread_stop(speedchange_task);
-	put_task_struct(speedchange_task);
+	cpufreq_interactive_replay_exit();
+
+	for_each_possible_cpu(cpu) {
+		ppol = per_cpu(polinfo, cpu);
+		if (!ppol)
+			continue;
+
+		kthread_stop(ppol->speedchange_task);
+		put_task_struct(ppol->speedchange_task);
+		if (ppol->own_tunables)
+			kobject_put(&ppol->own_tunables->kobj);
+		kfree(ppol);
+	}
+
+	if (common_tunables.target_loads != default_target_loads)
+		kfree(common_tunables.target_loads);
+	if (common_tunables.above_hispeed_delay !=
+	    default_above_hispeed_delay)
+		kfree(common_tunables.above_hispeed_delay);
 }
 
 module_exit(cpufreq_interactive_exit);
@@ -20,7 +20,9 @@
 #include <linux/kobject.h>
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
+#include <linux/hrtimer.h>
 #include <asm/cputime.h>
+#include <trace/events/power.h>
 
 static spinlock_t cpufreq_stats_lock;
 
@@ -39,6 +41,12 @@ struct cpufreq_stats {
 	unsigned int last_index;
 	cputime64_t *time_in_state;
 	unsigned int *freq_table;
+	/* PRECHANGE time of the transition in progress, 0 if none */
+	u64 switch_start;
+	/* switch latency in us, indexed by the state switched to */
+	u64 *switch_lat_total;
+	unsigned int *switch_lat_max;
+	unsigned int *switch_count;
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	unsigned int *trans_table;
 #endif
@@ -92,6 +100,32 @@ static ssize_t show_time_in_state(struct cpufreq_policy *policy, char *buf)
 	return len;
 }
 
+static ssize_t show_switch_latency(struct cpufreq_policy *policy, char *buf)
+{
+	ssize_t len = 0;
+	int i;
+	u64 avg;
+	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, policy->cpu);
+	if (!stat)
+		return 0;
+	spin_lock(&cpufreq_stats_lock);
+	for (i = 0; i < stat->state_num; i++) {
+		if (len >= PAGE_SIZE)
+			break;
+		avg = stat->switch_lat_total[i];
+		if (stat->switch_count[i])
+			do_div(avg, stat->switch_count[i]);
+		len += snprintf(buf + len, PAGE_SIZE - len, "%u %u %llu %u\n",
+				stat->freq_table[i], stat->switch_count[i],
+				(unsigned long long)avg,
+				stat->switch_lat_max[i]);
+	}
+	spin_unlock(&cpufreq_stats_lock);
+	if (len >= PAGE_SIZE)
+		return PAGE_SIZE;
+	return len;
+}
+
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 static ssize_t show_trans_table(struct cpufreq_policy *policy, char *buf)
 {
@@ -141,10 +175,12 @@ CPUFREQ_STATDEVICE_ATTR(trans_table, 0444, show_trans_table);
 
 CPUFREQ_STATDEVICE_ATTR(total_trans, 0444, show_total_trans);
 CPUFREQ_STATDEVICE_ATTR(time_in_state, 0444, show_time_in_state);
+CPUFREQ_STATDEVICE_ATTR(switch_latency, 0444, show_switch_latency);
 
 static struct attribute *default_attrs[] = {
 	&_attr_total_trans.attr,
 	&_attr_time_in_state.attr,
+	&_attr_switch_latency.attr,
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	&_attr_trans_table.attr,
 #endif
@@ -224,6 +260,7 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 	}
 
 	alloc_size = count * sizeof(int) + count * sizeof(cputime64_t);
+	alloc_size += count * (sizeof(u64) + 2 * sizeof(int));
 
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	alloc_size += count * count * sizeof(int);
@@ -234,10 +271,13 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 		ret = -ENOMEM;
 		goto error_out;
 	}
-	stat->freq_table = (unsigned int *)(stat->time_in_state + count);
+	stat->switch_lat_total = (u64 *)(stat->time_in_state + count);
+	stat->freq_table = (unsigned int *)(stat->switch_lat_total + count);
+	stat->switch_lat_max = stat->freq_table + count;
+	stat->switch_count = stat->switch_lat_max + count;
 
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
-	stat->trans_table = stat->freq_table + count;
+	stat->trans_table = stat->switch_count + count;
 #endif
 	j = 0;
 	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
@@ -286,14 +326,31 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 	struct cpufreq_freqs *freq = data;
 	struct cpufreq_stats *stat;
 	int old_index, new_index;
+	unsigned int latency = 0;
 
-	if (val != CPUFREQ_POSTCHANGE)
+	if (val != CPUFREQ_PRECHANGE && val != CPUFREQ_POSTCHANGE)
 		return 0;
 
 	stat = per_cpu(cpufreq_stats_table, freq->cpu);
 	if (!stat)
 		return 0;
 
+	/*
+	 * Time from the driver announcing a switch to the clock having
+	 * changed, i.e. the cost of the switch itself.
+	 */
+	if (val == CPUFREQ_PRECHANGE) {
+		stat->switch_start = ktime_to_us(ktime_get());
+		return 0;
+	}
+
+	if (stat->switch_start) {
+		latency = ktime_to_us(ktime_get()) - stat->switch_start;
+		stat->switch_start = 0;
+		trace_cpu_frequency_switch(freq->cpu, freq->old, freq->new,
+					   latency);
+	}
+
 	old_index = stat->last_index;
 	new_index = freq_table_get_index(stat, freq->new);
 
@@ -308,6 +365,10 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 
 	spin_lock(&cpufreq_stats_lock);
 	stat->last_index = new_index;
+	stat->switch_lat_total[new_index] += latency;
+	stat->switch_lat_max[new_index] = max(stat->switch_lat_max[new_index],
+					      latency);
+	stat->switch_count[new_index]++;
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	stat->trans_table[old_index * stat->max_state + new_index]++;
 #endif
@@ -23,6 +23,7 @@
 #include <linux/interrupt.h>
 #include <linux/spinlock.h>
 #include <linux/debugfs.h>
+#include <linux/ktime.h>
 
 #include <crypto/ctr.h>
 #include <crypto/des.h>
@@ -43,7 +44,7 @@
 
 #define MAX_CRYPTO_DEVICE 3
 #define DEBUG_MAX_FNAME  16
-#define DEBUG_MAX_RW_BUF 1024
+#define DEBUG_MAX_RW_BUF 2048
 
 struct crypto_stat {
 	u32 aead_sha1_aes_enc;
@@ -70,6 +71,13 @@ struct crypto_stat {
 	u32 sha256_hmac_digest;
 	u32 sha_hmac_op_success;
 	u32 sha_hmac_op_fail;
+	u32 req_done;
+	u32 req_pipelined;
+	u32 queue_max;
+	u32 lat_max_us;
+	u64 lat_total_us;
+	u64 busy_us;
+	u64 bytes;
 };
 static struct crypto_stat _qcrypto_stat[MAX_CRYPTO_DEVICE];
 static struct dentry *_debug_dent;
@@ -98,6 +106,7 @@ struct crypto_priv {
 	/* current active request */
 	struct crypto_async_request *req;
 	int res;
+	ktime_t req_start;
 
 	/* request queue */
 	struct crypto_queue queue;
@@ -227,6 +236,7 @@ struct qcrypto_cipher_req_ctx {
 	enum qce_cipher_alg_enum alg;
 	enum qce_cipher_dir_enum dir;
 	enum qce_cipher_mode_enum mode;
+	ktime_t qtime;			/* when the request was queued */
 };
 
 #define SHA_MAX_BLOCK_SIZE      SHA256_BLOCK_SIZE
@@ -274,6 +284,7 @@ struct qcrypto_sha_req_ctx {
 	};
 	struct scatterlist *src;
 	uint32_t nbytes;
+	ktime_t qtime;			/* when the request was queued */
 };
 
 static void _byte_stream_to_words(uint32_t *iv, unsigned char *b,
@@ -616,6 +627,30 @@ static int _disp_stats(int id)
 	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   SHA HMAC operation success          : %d\n",
 					pstat->sha_hmac_op_success);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Requests completed           : %d\n",
+					pstat->req_done);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Requests started back-to-back: %d\n",
+					pstat->req_pipelined);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   Max queue depth              : %d\n",
+					pstat->queue_max);
+	if (pstat->req_done) {
+		len += snprintf(_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Avg request latency (usec)   : %llu\n",
+			div_u64(pstat->lat_total_us, pstat->req_done));
+		len += snprintf(_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Max request latency (usec)   : %d\n",
+			pstat->lat_max_us);
+	}
+	if (pstat->busy_us)
+		len += snprintf(_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Engine throughput (KB/sec)   : %llu\n",
+			div64_u64(pstat->bytes * 1000, pstat->busy_us));
 	return len;
 }
 
@@ -710,20 +745,78 @@ static int _qcrypto_setkey_3des(struct crypto_ablkcipher *cipher, const u8 *key,
 	return 0;
 };
 
+static ktime_t *_qcrypto_req_qtime(struct crypto_async_request *req,
+		unsigned int *nbytes)
+{
+	switch (crypto_tfm_alg_type(req->tfm)) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER: {
+		struct ablkcipher_request *areq = ablkcipher_request_cast(req);
+		struct qcrypto_cipher_req_ctx *rctx;
+
+		rctx = ablkcipher_request_ctx(areq);
+		*nbytes = areq->nbytes;
+		return &rctx->qtime;
+	}
+	case CRYPTO_ALG_TYPE_AHASH: {
+		struct ahash_request *areq = ahash_request_cast(req);
+		struct qcrypto_sha_req_ctx *rctx = ahash_request_ctx(areq);
+
+		*nbytes = areq->nbytes;
+		return &rctx->qtime;
+	}
+	default: {
+		struct aead_request *areq = container_of(req,
+						struct aead_request, base);
+		struct qcrypto_cipher_req_ctx *rctx = aead_request_ctx(areq);
+
+		*nbytes = areq->cryptlen;
+		return &rctx->qtime;
+	}
+	};
+}
+
+static void _qcrypto_update_req_stats(struct crypto_priv *cp,
+		struct crypto_async_request *areq, ktime_t now)
+{
+	struct crypto_stat *pstat = &_qcrypto_stat[cp->pdev->id];
+	unsigned int nbytes;
+	ktime_t *qtime = _qcrypto_req_qtime(areq, &nbytes);
+	u32 lat = ktime_us_delta(now, *qtime);
+
+	pstat->req_done++;
+	pstat->bytes += nbytes;
+	pstat->busy_us += ktime_us_delta(now, cp->req_start);
+	pstat->lat_total_us += lat;
+	if (lat > pstat->lat_max_us)
+		pstat->lat_max_us = lat;
+}
+
+/*
+ * The engine works on one request at a time, so get the next queued
+ * request onto it before running the completion of the finished one.
+ * The caller's completion work (dm-crypt, IPsec) then overlaps with the
+ * engine instead of leaving it idle between back-to-back requests.
+ */
 static void req_done(unsigned long data)
 {
 	struct crypto_async_request *areq;
 	struct crypto_priv *cp = (struct crypto_priv *)data;
 	unsigned long flags;
+	int res;
 
 	spin_lock_irqsave(&cp->lock, flags);
 	areq = cp->req;
+	res = cp->res;
 	cp->req = NULL;
+	if (areq)
+		_qcrypto_update_req_stats(cp, areq, ktime_get());
+	if (cp->queue.qlen)
+		_qcrypto_stat[cp->pdev->id].req_pipelined++;
 	spin_unlock_irqrestore(&cp->lock, flags);
 
-	if (areq)
-		areq->complete(areq, cp->res);
 	_start_qcrypto_process(cp);
+	if (areq)
+		areq->complete(areq, res);
 };
 
 static void _update_sha1_ctx(struct ahash_request  *req)
@@ -1013,6 +1106,7 @@ again:
 		backlog = crypto_get_backlog(&cp->queue);
 		async_req = crypto_dequeue_request(&cp->queue);
 		cp->req = async_req;
+		cp->req_start = ktime_get();
 	}
 	spin_unlock_irqrestore(&cp->lock, flags);
 	if (!async_req)
@@ -1176,6 +1270,8 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 {
 	int ret;
 	unsigned long flags;
+	unsigned int nbytes;
+	struct crypto_stat *pstat = &_qcrypto_stat[cp->pdev->id];
 
 	if (cp->platform_support.ce_shared) {
 		ret = qcrypto_lock_ce(cp);
@@ -1184,7 +1280,10 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 	}
 
 	spin_lock_irqsave(&cp->lock, flags);
+	*_qcrypto_req_qtime(req, &nbytes) = ktime_get();
 	ret = crypto_enqueue_request(&cp->queue, req);
+	if (cp->queue.qlen > pstat->queue_max)
+		pstat->queue_max = cp->queue.qlen;
 	spin_unlock_irqrestore(&cp->lock, flags);
 	_start_qcrypto_process(cp);
 
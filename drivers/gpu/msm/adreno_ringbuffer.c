@@ -14,6 +14,7 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/log2.h>
+#include <linux/cpufreq.h>
 
 #include "kgsl.h"
 #include "kgsl_sharedmem.h"
@@ -985,6 +986,9 @@ adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 		numibs = 0;
 	}
 
+	/* The CPU side of the next frame usually follows a submission */
+	cpufreq_interactive_hint();
+
 	cmds = link = kzalloc(sizeof(unsigned int) * (numibs * 3 + 4),
 				GFP_KERNEL);
 	if (!link) {
@@ -5074,6 +5074,8 @@ static int __devinit qt602240_probe(struct i2c_client *client, const struct i2c_
 
 #if defined(CONFIG_PM) && defined(CONFIG_HAS_EARLYSUSPEND)
 	qt602240_data->es.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN;
+	/* only touches this controller's irq, timers and i2c client */
+	qt602240_data->es.async = true;
 	qt602240_data->es.suspend = (void*)qt602240_early_suspend;
 	qt602240_data->es.resume = (void*)qt602240_late_resume;
 	register_early_suspend(&qt602240_data->es);
@@ -332,6 +332,8 @@ static int __devinit tki_probe(struct i2c_client *client, const struct i2c_devic
 
 #if defined(CONFIG_PM) && defined(CONFIG_HAS_EARLYSUSPEND)
 	tki_data->es.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN;
+	/* only touches the key controller's own supply */
+	tki_data->es.async = true;
 	tki_data->es.suspend = (void*)tki_early_suspend;
 	tki_data->es.resume = (void*)tki_late_resume;
 	register_early_suspend(&tki_data->es);
@@ -77,6 +77,8 @@ static const char *ch_name[RMNET_DEVICE_COUNT] = {
 
 #define HEADROOM_FOR_QOS    8
 
+#define RMNET_NAPI_WEIGHT	64
+
 static struct completion *port_complete[RMNET_DEVICE_COUNT];
 
 struct rmnet_private
@@ -94,6 +96,7 @@ struct rmnet_private
 	struct sk_buff *skb;
 	spinlock_t lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
 	u32 operation_mode;    /* IOCTL specified mode (protocol, QoS header) */
 	struct platform_driver pdrv;
 	struct completion complete;
@@ -256,21 +259,35 @@ static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 	return protocol;
 }
 
-static void smd_net_data_handler(unsigned long arg);
-static DECLARE_TASKLET(smd_net_data_tasklet, smd_net_data_handler, 0);
+static int smd_net_rx_ready(struct rmnet_private *p)
+{
+	int sz = smd_cur_packet_size(p->ch);
+
+	return sz && smd_read_avail(p->ch) >= sz;
+}
 
 /* Called in soft-irq context */
-static void smd_net_data_handler(unsigned long arg)
+static int smd_net_poll(struct napi_struct *napi, int budget)
 {
-	struct net_device *dev = (struct net_device *) arg;
-	struct rmnet_private *p = netdev_priv(dev);
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+						napi);
+	struct net_device *dev = napi->dev;
 	struct sk_buff *skb;
 	void *ptr = 0;
 	int sz;
+	int work = 0;
 	u32 opmode = p->operation_mode;
 	unsigned long flags;
 
-	for (;;) {
+	/* the port may have been closed since the poll was scheduled */
+	if (!p->ch) {
+		napi_complete(napi);
+		return 0;
+	}
+
+	/* one interrupt back to the modem for the whole burst */
+	smd_batch_begin(p->ch);
+	while (work < budget) {
 		sz = smd_cur_packet_size(p->ch);
 		if (sz == 0) break;
 		if (smd_read_avail(p->ch) < sz) break;
@@ -279,9 +296,8 @@ static void smd_net_data_handler(unsigned long arg)
 		if (skb == NULL) {
 			pr_err("[%s] rmnet_recv() cannot allocate skb\n",
 			       dev->name);
-			/* out of memory, reschedule a later attempt */
-			smd_net_data_tasklet.data = (unsigned long)dev;
-			tasklet_schedule(&smd_net_data_tasklet);
+			/* out of memory, stay scheduled for a later attempt */
+			work = budget;
 			break;
 		} else {
 			skb->dev = dev;
@@ -322,14 +338,24 @@ static void smd_net_data_handler(unsigned long arg)
 					skb->len);
 
 				/* Deliver to network stack */
-				netif_rx(skb);
+				napi_gro_receive(napi, skb);
 			}
+			work++;
 			continue;
 		}
 		if (smd_read(p->ch, ptr, sz) != sz)
 			pr_err("[%s] rmnet_recv() smd lied about avail?!",
 				dev->name);
 	}
+	smd_batch_end(p->ch);
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* data that arrived after the last read lost its schedule */
+		if (smd_net_rx_ready(p))
+			napi_reschedule(napi);
+	}
+	return work;
 }
 
 static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
@@ -448,10 +474,8 @@ static void smd_net_notify(void *_dev, unsigned event)
 		spin_unlock(&p->lock);
 
 		if (smd_read_avail(p->ch) &&
-			(smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch))) {
-			smd_net_data_tasklet.data = (unsigned long) _dev;
-			tasklet_schedule(&smd_net_data_tasklet);
-		}
+			(smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch)))
+			napi_schedule(&p->napi);
 		break;
 
 	case SMD_EVENT_OPEN:
@@ -797,6 +821,12 @@ static int __init rmnet_init(void)
 		spin_lock_init(&p->lock);
 		tasklet_init(&p->tsklt, _rmnet_resume_flow,
 				(unsigned long)dev);
+		netif_napi_add(dev, &p->napi, smd_net_poll, RMNET_NAPI_WEIGHT);
+		/*
+		 * rmnet_stop() leaves the SMD channel open, so polling is
+		 * enabled for the lifetime of the device.
+		 */
+		napi_enable(&p->napi);
 		wake_lock_init(&p->wake_lock, WAKE_LOCK_SUSPEND, ch_name[n]);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
@@ -68,6 +68,10 @@ module_param_named(debug_enable, msm_rmnet_bam_debug_mask,
 #define HEADROOM_FOR_QOS    8
 #define TAILROOM            8 /* for padding by mux layer */
 
+#define RMNET_NAPI_WEIGHT	64
+/* packets held for the poll loop before new ones are dropped */
+#define RMNET_RX_QUEUE_MAX	1000
+
 struct rmnet_private {
 	struct net_device_stats stats;
 	uint32_t ch_id;
@@ -81,6 +85,8 @@ struct rmnet_private {
 	spinlock_t lock;
 	spinlock_t tx_queue_lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
 	u32 operation_mode; /* IOCTL specified mode (protocol, QoS header) */
 	uint8_t device_up;
 	uint8_t in_reset;
@@ -244,6 +250,28 @@ static int count_this_packet(void *_hdr, int len)
 	return 1;
 }
 
+/* Called in soft-irq context */
+static int rmnet_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+						napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&p->rx_queue))) {
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* a packet queued after the last dequeue lost its schedule */
+		if (!skb_queue_empty(&p->rx_queue))
+			napi_reschedule(napi);
+	}
+	return work;
+}
+
 /* Rx Callback, Called in Work Queue context */
 static void bam_recv_notify(void *dev, struct sk_buff *skb)
 {
@@ -277,8 +305,14 @@ static void bam_recv_notify(void *dev, struct sk_buff *skb)
 			((struct net_device *)dev)->name,
 			p->stats.rx_packets, skb->len);
 
-		/* Deliver to network stack */
-		netif_rx(skb);
+		/* Deliver to network stack from the poll loop */
+		if (skb_queue_len(&p->rx_queue) >= RMNET_RX_QUEUE_MAX) {
+			p->stats.rx_dropped++;
+			dev_kfree_skb_any(skb);
+			return;
+		}
+		skb_queue_tail(&p->rx_queue, skb);
+		napi_schedule(&p->napi);
 	} else
 		pr_err("[%s] %s: No skb received",
 			((struct net_device *)dev)->name, __func__);
@@ -778,6 +812,13 @@ static int __init rmnet_init(void)
 		p->in_reset = 0;
 		spin_lock_init(&p->lock);
 		spin_lock_init(&p->tx_queue_lock);
+		skb_queue_head_init(&p->rx_queue);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
+		/*
+		 * The mux channel stays open while the interface is down,
+		 * so polling is enabled for the lifetime of the device.
+		 */
+		napi_enable(&p->napi);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
 		p->wakeups_xmit = p->wakeups_rcv = 0;
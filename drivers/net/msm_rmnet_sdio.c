@@ -67,6 +67,10 @@ module_param_named(debug_enable, msm_rmnet_sdio_debug_mask,
 #define HEADROOM_FOR_QOS    8
 #define TAILROOM            8 /* for padding by mux layer */
 
+#define RMNET_NAPI_WEIGHT	64
+/* packets held for the poll loop before new ones are dropped */
+#define RMNET_RX_QUEUE_MAX	1000
+
 struct rmnet_private {
 	struct net_device_stats stats;
 	uint32_t ch_id;
@@ -79,6 +83,8 @@ struct rmnet_private {
 	struct sk_buff *skb;
 	spinlock_t lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
 	u32 operation_mode; /* IOCTL specified mode (protocol, QoS header) */
 	uint8_t device_up;
 	uint8_t in_reset;
@@ -261,6 +267,28 @@ static int sdio_update_reset_state(struct net_device *dev)
 	return 0;
 }
 
+/* Called in soft-irq context */
+static int rmnet_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+						napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&p->rx_queue))) {
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* a packet queued after the last dequeue lost its schedule */
+		if (!skb_queue_empty(&p->rx_queue))
+			napi_reschedule(napi);
+	}
+	return work;
+}
+
 /* Rx Callback, Called in Work Queue context */
 static void sdio_recv_notify(void *dev, struct sk_buff *skb)
 {
@@ -294,8 +322,14 @@ static void sdio_recv_notify(void *dev, struct sk_buff *skb)
 			((struct net_device *)dev)->name,
 			p->stats.rx_packets, skb->len);
 
-		/* Deliver to network stack */
-		netif_rx(skb);
+		/* Deliver to network stack from the poll loop */
+		if (skb_queue_len(&p->rx_queue) >= RMNET_RX_QUEUE_MAX) {
+			p->stats.rx_dropped++;
+			dev_kfree_skb_any(skb);
+			return;
+		}
+		skb_queue_tail(&p->rx_queue, skb);
+		napi_schedule(&p->napi);
 	} else {
 		spin_lock_irqsave(&p->lock, flags);
 		if (!sdio_update_reset_state((struct net_device *)dev))
@@ -667,6 +701,13 @@ static int __init rmnet_init(void)
 		p->operation_mode = RMNET_MODE_LLP_ETH;
 		p->ch_id = n;
 		spin_lock_init(&p->lock);
+		skb_queue_head_init(&p->rx_queue);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
+		/*
+		 * The transport port stays open while the interface is down,
+		 * so polling is enabled for the lifetime of the device.
+		 */
+		napi_enable(&p->napi);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
 		p->wakeups_xmit = p->wakeups_rcv = 0;
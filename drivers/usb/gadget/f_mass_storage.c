@@ -319,6 +319,28 @@ static const char fsg_string_interface[] = "Mass Storage";
 static int write_error_after_csw_sent;
 static int csw_hack_sent;
 #endif
+
+/*
+ * Buffer pipeline geometry, applied when a fsg_common is created.  More
+ * buffers let reads from the backing file run further ahead of the USB
+ * transfers; buffers larger than FSG_BUFLEN only help on UDCs which take
+ * such requests in one go.
+ */
+#define FSG_MAX_NUM_BUFFERS	32
+
+static unsigned int fsg_num_buffers = CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS;
+module_param(fsg_num_buffers, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(fsg_num_buffers, "Number of mass storage pipeline buffers");
+
+static unsigned int fsg_buflen = FSG_BUFLEN;
+module_param(fsg_buflen, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(fsg_buflen, "Size of each mass storage pipeline buffer");
+
+/* Read-ahead window used for the backing files, in KB */
+static unsigned int fsg_readahead_kb = 512;
+module_param(fsg_readahead_kb, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(fsg_readahead_kb, "Backing file read-ahead window in KB");
+
 /*-------------------------------------------------------------------------*/
 
 struct fsg_dev;
@@ -369,7 +391,9 @@ struct fsg_common {
 
 	struct fsg_buffhd	*next_buffhd_to_fill;
 	struct fsg_buffhd	*next_buffhd_to_drain;
-	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
+	struct fsg_buffhd	*buffhds;
+	unsigned int		num_buffers;
+	u32			buflen;
 
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
@@ -776,6 +800,28 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Hosts stream large images with back-to-back READs.  Give the backing
+ * file a read-ahead window which keeps the next LBA range in flight in
+ * the page cache while the current one goes out over USB.
+ */
+static void fsg_lun_set_readahead(struct fsg_lun *curlun)
+{
+	struct file *filp = curlun->filp;
+	unsigned long ra_pages;
+
+	if (!filp)
+		return;
+
+	ra_pages = fsg_readahead_kb >> (PAGE_CACHE_SHIFT - 10);
+	if (ra_pages <= filp->f_ra.ra_pages)
+		return;
+
+	spin_lock(&filp->f_lock);
+	filp->f_ra.ra_pages = ra_pages;
+	spin_unlock(&filp->f_lock);
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -826,6 +872,8 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	fsg_lun_set_readahead(curlun);
+
 	for (;;) {
 		/*
 		 * Figure out how much we need to read:
@@ -837,7 +885,7 @@ static int do_read(struct fsg_common *common)
 		 * If this means reading 0 then we were asked to read past
 		 *	the end of file.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 		partial_page = file_offset & (PAGE_CACHE_SIZE - 1);
@@ -1009,7 +1057,7 @@ static int do_write(struct fsg_common *common)
 			 *	to write past the end of file.
 			 * Finally, round down to a block boundary.
 			 */
-			amount = min(amount_left_to_req, FSG_BUFLEN);
+			amount = min(amount_left_to_req, common->buflen);
 			amount = min((loff_t)amount,
 				     curlun->file_length - usb_offset);
 			partial_page = usb_offset & (PAGE_CACHE_SIZE - 1);
@@ -1150,12 +1198,13 @@ write_error:
 				 * yet from the host. So there is no point in
 				 * csw right away without the complete data.
 				 */
-				for (i = 0; i < FSG_NUM_BUFFERS; i++) {
+				for (i = 0; i < common->num_buffers; i++) {
 					if (common->buffhds[i].state ==
 							BUF_STATE_BUSY)
 						break;
 				}
-				if (!amount_left_to_req && i == FSG_NUM_BUFFERS) {
+				if (!amount_left_to_req &&
+				    i == common->num_buffers) {
 					csw_hack_sent = 1;
 					send_status(common);
 				}
@@ -1270,7 +1319,7 @@ static int do_verify(struct fsg_common *common)
 		 * If this means reading 0 then we were asked to read
 		 * past the end of file.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 		if (amount == 0) {
@@ -1741,7 +1790,7 @@ static int throw_away_data(struct fsg_common *common)
 		bh = common->next_buffhd_to_fill;
 		if (bh->state == BUF_STATE_EMPTY
 		 && common->usb_amount_left > 0) {
-			amount = min(common->usb_amount_left, FSG_BUFLEN);
+			amount = min(common->usb_amount_left, common->buflen);
 
 			/*
 			 * amount is always divisible by 512, hence by
@@ -2548,7 +2597,7 @@ reset:
 	if (common->fsg) {
 		fsg = common->fsg;
 
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			struct fsg_buffhd *bh = &common->buffhds[i];
 
 			if (bh->inreq) {
@@ -2575,7 +2624,7 @@ reset:
 
 
 	/* Allocate the requests */
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		struct fsg_buffhd	*bh = &common->buffhds[i];
 
 		rc = alloc_request(common, fsg->bulk_in, &bh->inreq);
@@ -2694,7 +2743,7 @@ static void handle_exception(struct fsg_common *common)
 
 	/* Cancel all the pending transfers */
 	if (likely(common->fsg)) {
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			bh = &common->buffhds[i];
 			if (bh->inreq_busy)
 				usb_ep_dequeue(common->fsg->bulk_in, bh->inreq);
@@ -2706,7 +2755,7 @@ static void handle_exception(struct fsg_common *common)
 		/* Wait until everything is idle */
 		for (;;) {
 			int num_active = 0;
-			for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+			for (i = 0; i < common->num_buffers; ++i) {
 				bh = &common->buffhds[i];
 				num_active += bh->inreq_busy + bh->outreq_busy;
 			}
@@ -2729,7 +2778,7 @@ static void handle_exception(struct fsg_common *common)
 	 */
 	spin_lock_irq(&common->lock);
 
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		bh = &common->buffhds[i];
 		bh->state = BUF_STATE_EMPTY;
 	}
@@ -3050,20 +3099,35 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 	common->nluns = nluns;
 
 	/* Data buffers cyclic list */
-	bh = common->buffhds;
-	i = FSG_NUM_BUFFERS;
-	goto buffhds_first_it;
-	do {
-		bh->next = bh + 1;
-		++bh;
-buffhds_first_it:
-		bh->buf = kmalloc(FSG_BUFLEN, GFP_KERNEL);
-		if (unlikely(!bh->buf)) {
+	common->num_buffers = clamp_t(unsigned, fsg_num_buffers,
+				      FSG_NUM_BUFFERS, FSG_MAX_NUM_BUFFERS);
+	common->buflen = max_t(u32, round_down(fsg_buflen, PAGE_CACHE_SIZE),
+			       FSG_BUFLEN);
+	common->buffhds = kcalloc(common->num_buffers,
+				  sizeof *common->buffhds, GFP_KERNEL);
+	if (unlikely(!common->buffhds)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
+retry_buffhds:
+	for (i = 0; i < common->num_buffers; ++i) {
+		bh = &common->buffhds[i];
+		bh->next = &common->buffhds[(i + 1) % common->num_buffers];
+		bh->buf = kmalloc(common->buflen, GFP_KERNEL);
+		if (likely(bh->buf))
+			continue;
+		if (common->buflen <= FSG_BUFLEN) {
 			rc = -ENOMEM;
 			goto error_release;
 		}
-	} while (--i);
-	bh->next = common->buffhds;
+		/* Large buffers are a luxury, fall back to the default */
+		while (i--) {
+			kfree(common->buffhds[i].buf);
+			common->buffhds[i].buf = NULL;
+		}
+		common->buflen = FSG_BUFLEN;
+		goto retry_buffhds;
+	}
 
 	/* Prepare inquiryString */
 	if (cfg->release != 0xffff) {
@@ -3178,12 +3242,11 @@ static void fsg_common_release(struct kref *ref)
 		kfree(common->luns);
 	}
 
-	{
-		struct fsg_buffhd *bh = common->buffhds;
-		unsigned i = FSG_NUM_BUFFERS;
-		do {
-			kfree(bh->buf);
-		} while (++bh, --i);
+	if (common->buffhds) {
+		unsigned i;
+		for (i = 0; i < common->num_buffers; ++i)
+			kfree(common->buffhds[i].buf);
+		kfree(common->buffhds);
 	}
 
 	if (common->free_storage_on_release)
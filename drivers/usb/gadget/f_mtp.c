@@ -28,8 +28,11 @@
 
 #include <linux/types.h>
 #include <linux/file.h>
+#include <linux/backing-dev.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -50,10 +53,34 @@
 #define STATE_ERROR                 4   /* error from completion routine */
 
 /* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+#define TX_REQ_DEFAULT 8
+#define TX_REQ_MAX 16
+#define RX_REQ_DEFAULT 4
+#define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
+/*
+ * Bulk pipeline depth and request sizes, applied when the function is
+ * bound. Larger requests are only useful if the UDC accepts them in one
+ * go (msm72k takes at most 16KB per request); if the buffers can not be
+ * allocated we fall back to MTP_BULK_BUFFER_SIZE.
+ */
+static unsigned int mtp_tx_reqs = TX_REQ_DEFAULT;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "Number of MTP bulk IN requests");
+
+static unsigned int mtp_rx_reqs = RX_REQ_DEFAULT;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "Number of MTP bulk OUT requests");
+
+static unsigned int mtp_tx_req_len = MTP_BULK_BUFFER_SIZE;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "Size of MTP bulk IN requests");
+
+static unsigned int mtp_rx_req_len = MTP_BULK_BUFFER_SIZE;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "Size of MTP bulk OUT requests");
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -99,6 +126,14 @@ struct mtp_dev {
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
 	int rx_done;
+	/* number of bulk OUT completions since the last receive_file_work */
+	atomic_t rx_completed;
+
+	/* pipeline geometry chosen at bind time */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	unsigned tx_reqs;
+	unsigned rx_reqs;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -113,6 +148,13 @@ struct mtp_dev {
 	uint16_t xfer_command;
 	uint32_t xfer_transaction_id;
 	int xfer_result;
+
+	/* throughput of the last file transfers, for debugfs */
+	int64_t send_file_bytes;
+	s64 send_file_usecs;
+	int64_t receive_file_bytes;
+	s64 receive_file_usecs;
+	s64 receive_vfs_usecs;
 };
 
 static struct usb_interface_descriptor mtp_interface_desc = {
@@ -368,7 +410,9 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 	struct mtp_dev *dev = _mtp_dev;
 
 	dev->rx_done = 1;
-	if (req->status != 0)
+	atomic_inc(&dev->rx_completed);
+	/* requests we dequeue ourselves are not an error */
+	if (req->status != 0 && req->status != -ECONNRESET)
 		dev->state = STATE_ERROR;
 
 	wake_up(&dev->read_wq);
@@ -426,17 +470,38 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	dev->tx_reqs = clamp_t(unsigned, mtp_tx_reqs, 1, TX_REQ_MAX);
+	dev->tx_req_len = max_t(unsigned, mtp_tx_req_len, INTR_BUFFER_SIZE);
+retry_tx_alloc:
+	for (i = 0; i < dev->tx_reqs; i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			dev->tx_req_len = MTP_BULK_BUFFER_SIZE;
+			goto retry_tx_alloc;
+		}
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+
+	dev->rx_reqs = clamp_t(unsigned, mtp_rx_reqs, 1, RX_REQ_MAX);
+	dev->rx_req_len = max_t(unsigned, mtp_rx_req_len, INTR_BUFFER_SIZE);
+retry_rx_alloc:
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--) {
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			dev->rx_req_len = MTP_BULK_BUFFER_SIZE;
+			goto retry_rx_alloc;
+		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
@@ -466,7 +531,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%d)\n", count);
 
-	if (count > MTP_BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	/* we will block until we're online */
@@ -596,8 +661,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -646,6 +711,7 @@ static void send_file_work(struct work_struct *data) {
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	ktime_t start_time;
 
 	/* read our parameters */
 	smp_rmb();
@@ -655,6 +721,18 @@ static void send_file_work(struct work_struct *data) {
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	/*
+	 * The whole range is streamed out in order, so let the page cache
+	 * read ahead as it would for POSIX_FADV_SEQUENTIAL. This keeps
+	 * vfs_read hitting cached pages while the bulk queue drains.
+	 */
+	spin_lock(&filp->f_lock);
+	filp->f_ra.ra_pages = filp->f_mapping->backing_dev_info->ra_pages * 2;
+	spin_unlock(&filp->f_lock);
+
+	start_time = ktime_get();
+	dev->send_file_bytes = count;
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -688,8 +766,8 @@ static void send_file_work(struct work_struct *data) {
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -728,22 +806,74 @@ static void send_file_work(struct work_struct *data) {
 	if (req)
 		mtp_req_put(dev, &dev->tx_idle, req);
 
+	dev->send_file_usecs = ktime_to_us(ktime_sub(ktime_get(), start_time));
+
 	DBG(cdev, "send_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
 	smp_wmb();
 }
 
-/* read from USB and write to a local file */
+/*
+ * Queue bulk OUT requests for receive_file_work() until rx_reqs are in
+ * flight or the announced length is covered.  Returns 0 or the error from
+ * usb_ep_queue().
+ */
+static int receive_file_queue(struct mtp_dev *dev, int64_t *count,
+			      unsigned *queued, unsigned written,
+			      bool unknown_length)
+{
+	struct usb_request *req;
+	int ret;
+
+	while (*count > 0 && *queued - written < dev->rx_reqs) {
+		/*
+		 * Without a length the transfer ends at a short packet, so
+		 * only look ahead once the previous read has completed full
+		 * sized.
+		 */
+		if (unknown_length && *queued) {
+			req = dev->rx_req[(*queued - 1) % dev->rx_reqs];
+			if (atomic_read(&dev->rx_completed) != *queued ||
+			    req->actual < req->length)
+				break;
+		}
+
+		req = dev->rx_req[*queued % dev->rx_reqs];
+		req->length = (*count > dev->rx_req_len
+				? dev->rx_req_len : *count);
+		dev->rx_done = 0;
+		ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
+		if (ret < 0)
+			return ret;
+		(*queued)++;
+		if (!unknown_length)
+			*count -= req->length;
+	}
+	return 0;
+}
+
+/*
+ * read from USB and write to a local file
+ *
+ * Up to rx_reqs bulk OUT requests are kept in flight, but never for more
+ * bytes than the host announced, so that we do not swallow data belonging
+ * to the next transaction. The UDC completes OUT requests in order, so
+ * rx_completed tells us how many of the queued requests hold data.
+ */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
 	int64_t count;
-	int ret, cur_buf = 0;
+	unsigned queued = 0, written = 0;
+	bool unknown_length;
+	ktime_t start_time, vfs_start;
+	s64 vfs_usecs = 0;
+	int ret;
 	int r = 0;
 
 	/* read our parameters */
@@ -754,62 +884,83 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
-
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
-			if (ret < 0) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
+	/* if xfer_file_length is 0xFFFFFFFF, then we read until
+	 * we get a zero length packet
+	 */
+	unknown_length = (count == 0xFFFFFFFF);
+	atomic_set(&dev->rx_completed, 0);
+	start_time = ktime_get();
+	dev->receive_file_bytes = 0;
+
+	while (count > 0 || queued != written) {
+		/* keep the bulk OUT pipeline full */
+		ret = receive_file_queue(dev, &count, &queued, written,
+					 unknown_length);
+		if (ret < 0) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto out;
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+		/* wait for the oldest outstanding read to complete */
+		ret = wait_event_interruptible(dev->read_wq,
+			atomic_read(&dev->rx_completed) != written ||
+			dev->state != STATE_BUSY);
+		if (dev->state != STATE_BUSY) {
+			r = (dev->state == STATE_CANCELED) ? -ECANCELED : -EIO;
+			goto out;
 		}
+		if (atomic_read(&dev->rx_completed) == written)
+			continue;
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/* short packet is used to signal EOF for sizes > 4 gig */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+		/*
+		 * A full sized read of unknown length allows the next one to
+		 * be queued now, so that it overlaps with vfs_write().
+		 */
+		ret = receive_file_queue(dev, &count, &queued, written,
+					 unknown_length);
+		if (ret < 0) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto out;
+		}
+
+		req = dev->rx_req[written % dev->rx_reqs];
+		written++;
+
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		vfs_start = ktime_get();
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		vfs_usecs += ktime_to_us(ktime_sub(ktime_get(), vfs_start));
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto out;
+		}
+		dev->receive_file_bytes += req->actual;
 
-			write_req = read_req;
-			read_req = NULL;
+		if (req->actual < req->length) {
+			/* short packet is used to signal EOF for sizes > 4 gig */
+			DBG(cdev, "got short packet\n");
+			count = 0;
+			break;
 		}
 	}
 
+out:
+	/* give back anything still queued after an error or short packet */
+	while (written != queued) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[written % dev->rx_reqs]);
+		written++;
+	}
+	/* the requests are reused by the next transfer: let them complete */
+	wait_event(dev->read_wq, atomic_read(&dev->rx_completed) == queued);
+
+	dev->receive_file_usecs = ktime_to_us(ktime_sub(ktime_get(),
+							start_time));
+	dev->receive_vfs_usecs = vfs_usecs;
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1124,8 +1275,10 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < RX_REQ_MAX; i++) {
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
@@ -1224,6 +1377,64 @@ static int mtp_bind_config(struct usb_configuration *c, bool ptp_config)
 	return usb_add_function(c, &dev->function);
 }
 
+#if defined(CONFIG_DEBUG_FS)
+static struct dentry *mtp_dent;
+
+static unsigned mtp_kbps(int64_t bytes, s64 usecs)
+{
+	if (usecs <= 0)
+		return 0;
+	/* bytes * 10^6 / usecs / 1024 */
+	return div64_s64(bytes * 1000000, usecs) >> 10;
+}
+
+static ssize_t mtp_debug_read_stats(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	struct mtp_dev *dev = _mtp_dev;
+	char buf[384];
+	int temp;
+
+	temp = scnprintf(buf, sizeof(buf),
+			"tx_reqs: %u x %u bytes\n"
+			"rx_reqs: %u x %u bytes\n"
+			"send_file: %lld bytes in %lld us (%u KB/s)\n"
+			"receive_file: %lld bytes in %lld us (%u KB/s), "
+			"vfs_write %lld us\n",
+			dev->tx_reqs, dev->tx_req_len,
+			dev->rx_reqs, dev->rx_req_len,
+			dev->send_file_bytes, dev->send_file_usecs,
+			mtp_kbps(dev->send_file_bytes, dev->send_file_usecs),
+			dev->receive_file_bytes, dev->receive_file_usecs,
+			mtp_kbps(dev->receive_file_bytes,
+				dev->receive_file_usecs),
+			dev->receive_vfs_usecs);
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, temp);
+}
+
+static const struct file_operations mtp_debug_ops = {
+	.read = mtp_debug_read_stats,
+};
+
+static void mtp_debugfs_init(void)
+{
+	mtp_dent = debugfs_create_dir("usb_mtp", 0);
+	if (IS_ERR_OR_NULL(mtp_dent))
+		return;
+
+	debugfs_create_file("status", 0444, mtp_dent, 0, &mtp_debug_ops);
+}
+
+static void mtp_debugfs_remove(void)
+{
+	debugfs_remove_recursive(mtp_dent);
+}
+#else
+static void mtp_debugfs_init(void) { }
+static void mtp_debugfs_remove(void) { }
+#endif
+
 static int mtp_setup(void)
 {
 	struct mtp_dev *dev;
@@ -1256,6 +1467,8 @@ static int mtp_setup(void)
 	if (ret)
 		goto err2;
 
+	mtp_debugfs_init();
+
 	return 0;
 
 err2:
@@ -1274,6 +1487,7 @@ static void mtp_cleanup(void)
 	if (!dev)
 		return;
 
+	mtp_debugfs_remove();
 	misc_deregister(&mtp_device);
 	destroy_workqueue(dev->wq);
 	_mtp_dev = NULL;
@@ -110,6 +110,18 @@ static inline unsigned ncm_bitrate(struct usb_gadget *g)
 #define NTB_DEFAULT_IN_SIZE	USB_CDC_NCM_NTB_MIN_IN_SIZE
 #define NTB_OUT_SIZE		16384
 
+/*
+ * With TX aggregation several datagrams share one IN NTB, so offer the
+ * host the same 16K block it already uses for OUT transfers.
+ */
+#define NTB_AGGR_IN_SIZE	16384
+#define NCM_MAX_TX_AGGR		32
+
+static unsigned int ncm_tx_aggr = 1;
+module_param(ncm_tx_aggr, uint, S_IRUGO);
+MODULE_PARM_DESC(ncm_tx_aggr,
+		"max datagrams packed into one IN NTB (1 disables aggregation)");
+
 /*
  * skbs of size less than that will not be aligned
  * to NCM's dwNtbInMaxSize to save bus bandwidth
@@ -460,7 +472,7 @@ static inline void ncm_reset_values(struct f_ncm *ncm)
 	ncm->port.header_len = 0;
 
 	ncm->port.fixed_out_len = le32_to_cpu(ntb_parameters.dwNtbOutMaxSize);
-	ncm->port.fixed_in_len = NTB_DEFAULT_IN_SIZE;
+	ncm->port.fixed_in_len = le32_to_cpu(ntb_parameters.dwNtbInMaxSize);
 }
 
 /*
@@ -964,6 +976,98 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 	return skb;
 }
 
+/*
+ * Pack as many datagrams from @list as fit in one NTB, in order.  The
+ * ones that don't fit stay on @list for the next transfer.  A datagram
+ * too large for any NTB is dropped, so each call makes progress.
+ */
+static struct sk_buff *ncm_wrap_ntb_multi(struct gether *port,
+					  struct sk_buff_head *list)
+{
+	struct f_ncm	*ncm = func_to_ncm(&port->func);
+	struct ndp_parser_opts *opts = ncm->parser_opts;
+	struct sk_buff	*skb, *skb2;
+	__le16		*tmp, *entry;
+	unsigned	div = le16_to_cpu(ntb_parameters.wNdpInDivisor);
+	unsigned	rem = le16_to_cpu(ntb_parameters.wNdpInPayloadRemainder);
+	unsigned	ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
+	unsigned	max_size = ncm->port.fixed_in_len;
+	unsigned	crc_len = ncm->is_crc ? sizeof(uint32_t) : 0;
+	unsigned	entry_len = 2 * 2 * opts->dgram_item_len;
+	unsigned	ndp_index, ndp_len, offset, size;
+	unsigned	count, n;
+
+	n = min(skb_queue_len(list), port->max_pkts_per_xfer);
+	if (!n)
+		return NULL;
+
+	/* room for n entries plus the zero terminator */
+	ndp_index = ALIGN(opts->nth_size, ndp_align);
+	ndp_len = opts->ndp_size + (n + 1) * entry_len;
+
+	/* size the block for what is queued, not for dwNtbInMaxSize */
+	size = ndp_index + ndp_len;
+	count = 0;
+	skb_queue_walk(list, skb) {
+		if (count++ == n)
+			break;
+		size += div + rem + skb->len + crc_len;
+	}
+	size = min(size, max_size);
+	skb2 = alloc_skb(size, GFP_ATOMIC);
+	if (!skb2)
+		return NULL;
+
+	tmp = (void *) skb_put(skb2, ndp_index + ndp_len);
+	memset(tmp, 0, ndp_index + ndp_len);
+	entry = (void *) tmp + ndp_index + opts->ndp_size;
+
+	for (count = 0; count < n; count++) {
+		skb = skb_peek(list);
+		offset = ALIGN(skb2->len, div) + rem;
+		if (offset + skb->len + crc_len > size)
+			break;
+
+		__skb_unlink(skb, list);
+		memset(skb_put(skb2, offset - skb2->len), 0,
+		       offset - skb2->len);
+		skb_copy_bits(skb, 0, skb_put(skb2, skb->len), skb->len);
+		if (ncm->is_crc) {
+			uint32_t crc;
+
+			crc = ~crc32_le(~0, skb2->data + offset, skb->len);
+			put_unaligned_le32(crc, skb_put(skb2, crc_len));
+		}
+
+		/* (d)wDatagramIndex[count], (d)wDatagramLength[count] */
+		put_ncm(&entry, opts->dgram_item_len, offset);
+		put_ncm(&entry, opts->dgram_item_len, skb->len + crc_len);
+		dev_kfree_skb_any(skb);
+	}
+
+	if (!count) {
+		dev_kfree_skb_any(__skb_dequeue(list));
+		dev_kfree_skb_any(skb2);
+		return NULL;
+	}
+
+	put_unaligned_le32(opts->nth_sign, tmp); /* dwSignature */
+	tmp += 2;
+	/* wHeaderLength */
+	put_unaligned_le16(opts->nth_size, tmp++);
+	tmp++; /* skip wSequence */
+	put_ncm(&tmp, opts->block_length, skb2->len); /* (d)wBlockLength */
+	put_ncm(&tmp, opts->fp_index, ndp_index); /* (d)wFpIndex */
+
+	/* NDP */
+	tmp = (void *) skb2->data + ndp_index;
+	put_unaligned_le32(opts->ndp_sign, tmp); /* dwSignature */
+	tmp += 2;
+	put_unaligned_le16(ndp_len, tmp); /* wLength */
+
+	return skb2;
+}
+
 static int ncm_unwrap_ntb(struct gether *port,
 			  struct sk_buff *skb,
 			  struct sk_buff_head *list)
@@ -1381,6 +1485,11 @@ int __init ncm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN])
 		ethaddr[3], ethaddr[4], ethaddr[5]);
 	ncm_string_defs[1].s = ncm->ethaddr;
 
+	if (ncm_tx_aggr > 1) {
+		ncm_tx_aggr = min(ncm_tx_aggr, (unsigned) NCM_MAX_TX_AGGR);
+		ntb_parameters.dwNtbInMaxSize = cpu_to_le32(NTB_AGGR_IN_SIZE);
+	}
+
 	spin_lock_init(&ncm->lock);
 	ncm_reset_values(ncm);
 	ncm->port.is_fixed = true;
@@ -1397,6 +1506,8 @@ int __init ncm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN])
 
 	ncm->port.wrap = ncm_wrap_ntb;
 	ncm->port.unwrap = ncm_unwrap_ntb;
+	ncm->port.max_pkts_per_xfer = ncm_tx_aggr;
+	ncm->port.wrap_multi = ncm_wrap_ntb_multi;
 
 	status = usb_add_function(c, &ncm->port.func);
 	if (status) {
@@ -68,6 +68,7 @@ struct eth_dev {
 	spinlock_t		req_lock;	/* guard {rx,tx}_reqs */
 	struct list_head	tx_reqs, rx_reqs;
 	unsigned		tx_qlen;
+	unsigned		tx_in_flight;
 
 	struct sk_buff_head	rx_frames;
 
@@ -77,6 +78,14 @@ struct eth_dev {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* multi-datagram IN transfers; tx_aggr is guarded by req_lock */
+	unsigned		max_pkts_per_xfer;
+	struct sk_buff		*(*wrap_multi)(struct gether *,
+						struct sk_buff_head *list);
+	struct sk_buff_head	tx_aggr;
+	bool			tx_aggr_busy;
+	unsigned long		tx_aggr_xfers;
+
 	struct work_struct	work;
 
 	unsigned long		todo;
@@ -461,6 +470,99 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_complete(struct usb_ep *ep, struct usb_request *req);
+
+/*
+ * Pack the held datagrams into as few IN transfers as the free requests
+ * allow.  Only one caller packs at a time so datagrams stay in order; a
+ * concurrent caller just leaves its datagrams for the one already looping.
+ */
+static void eth_tx_aggr_flush(struct eth_dev *dev, struct usb_ep *in)
+{
+	struct sk_buff_head	list;
+	struct usb_request	*req;
+	struct sk_buff		*skb;
+	unsigned long		flags;
+	unsigned		queued;
+	int			length;
+	int			retval;
+
+	__skb_queue_head_init(&list);
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (dev->tx_aggr_busy) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return;
+	}
+	dev->tx_aggr_busy = true;
+
+	while (!skb_queue_empty(&dev->tx_aggr) && !list_empty(&dev->tx_reqs)) {
+		req = container_of(dev->tx_reqs.next, struct usb_request, list);
+		list_del(&req->list);
+		dev->tx_in_flight++;
+		skb_queue_splice_init(&dev->tx_aggr, &list);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+
+		queued = skb_queue_len(&list);
+		skb = NULL;
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb)
+			skb = dev->wrap_multi(dev->port_usb, &list);
+		else
+			__skb_queue_purge(&list);
+		spin_unlock_irqrestore(&dev->lock, flags);
+
+		retval = -ENOMEM;
+		if (skb) {
+			length = skb->len;
+			req->buf = skb->data;
+			req->context = skb;
+			req->complete = tx_complete;
+
+			if (dev->port_usb->is_fixed &&
+			    length == dev->port_usb->fixed_in_len &&
+			    (length % in->maxpacket) == 0)
+				req->zero = 0;
+			else
+				req->zero = 1;
+			if (req->zero && !dev->zlp &&
+			    (length % in->maxpacket) == 0)
+				length++;
+			req->length = length;
+
+			/* one completion already covers many datagrams */
+			req->no_interrupt = 0;
+
+			retval = usb_ep_queue(in, req, GFP_ATOMIC);
+			if (retval) {
+				DBG(dev, "tx queue err %d\n", retval);
+				dev_kfree_skb_any(skb);
+			} else {
+				dev->net->trans_start = jiffies;
+				dev->net->stats.tx_packets +=
+					queued - skb_queue_len(&list);
+				dev->tx_aggr_xfers++;
+			}
+		}
+
+		if (retval)
+			dev->net->stats.tx_dropped +=
+				queued - skb_queue_len(&list);
+
+		spin_lock_irqsave(&dev->req_lock, flags);
+		/* whatever did not fit goes back ahead of newer datagrams */
+		skb_queue_splice_init(&list, &dev->tx_aggr);
+		if (retval) {
+			list_add(&req->list, &dev->tx_reqs);
+			dev->tx_in_flight--;
+			break;
+		}
+	}
+
+	dev->tx_aggr_busy = false;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
@@ -477,13 +579,20 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case 0:
 		dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	/* aggregated datagrams were counted when they were packed */
+	if (!dev->wrap_multi)
+		dev->net->stats.tx_packets++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
+	dev->tx_in_flight--;
 	spin_unlock(&dev->req_lock);
 	dev_kfree_skb_any(skb);
 
+	/* send whatever piled up while this request was busy */
+	if (dev->wrap_multi)
+		eth_tx_aggr_flush(dev, ep);
+
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
@@ -541,6 +650,27 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	/* multi-datagram framing: hold this datagram while earlier
+	 * transfers are still in flight, and pack it with the ones that
+	 * follow once a request frees up or enough are waiting.
+	 */
+	if (dev->wrap_multi) {
+		bool	hold;
+
+		spin_lock_irqsave(&dev->req_lock, flags);
+		__skb_queue_tail(&dev->tx_aggr, skb);
+		hold = dev->tx_in_flight &&
+			skb_queue_len(&dev->tx_aggr) < dev->max_pkts_per_xfer;
+		if (list_empty(&dev->tx_reqs) &&
+		    skb_queue_len(&dev->tx_aggr) >= dev->max_pkts_per_xfer)
+			netif_stop_queue(net);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+
+		if (!hold)
+			eth_tx_aggr_flush(dev, in);
+		return NETDEV_TX_OK;
+	}
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -554,6 +684,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 
 	req = container_of(dev->tx_reqs.next, struct usb_request, list);
 	list_del(&req->list);
+	dev->tx_in_flight++;
 
 	/* temporarily stop TX queue when the freelist empties */
 	if (list_empty(&dev->tx_reqs))
@@ -628,6 +759,7 @@ drop:
 		if (list_empty(&dev->tx_reqs))
 			netif_start_queue(net);
 		list_add(&req->list, &dev->tx_reqs);
+		dev->tx_in_flight--;
 		spin_unlock_irqrestore(&dev->req_lock, flags);
 	}
 	return NETDEV_TX_OK;
@@ -677,6 +809,9 @@ static int eth_stop(struct net_device *net)
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
 		dev->net->stats.rx_errors, dev->net->stats.tx_errors
 		);
+	if (dev->wrap_multi)
+		DBG(dev, "tx packets %ld in %lu transfers\n",
+			dev->net->stats.tx_packets, dev->tx_aggr_xfers);
 
 	/* ensure there are no more active requests */
 	spin_lock_irqsave(&dev->lock, flags);
@@ -695,6 +830,9 @@ static int eth_stop(struct net_device *net)
 		 * their own pace; the network stack can handle old packets.
 		 * For the moment we leave this here, since it works.
 		 */
+		spin_lock(&dev->req_lock);
+		__skb_queue_purge(&dev->tx_aggr);
+		spin_unlock(&dev->req_lock);
 		usb_ep_disable(link->in_ep);
 		usb_ep_disable(link->out_ep);
 		if (netif_carrier_ok(net)) {
@@ -810,6 +948,7 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	skb_queue_head_init(&dev->tx_aggr);
 
 	/* network device setup */
 	dev->net = net;
@@ -922,6 +1061,9 @@ struct net_device *gether_connect(struct gether *link)
 		dev->header_len = link->header_len;
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
+		dev->max_pkts_per_xfer = link->max_pkts_per_xfer;
+		dev->wrap_multi = link->max_pkts_per_xfer > 1 ?
+				link->wrap_multi : NULL;
 
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
@@ -981,6 +1123,9 @@ void gether_disconnect(struct gether *link)
 	 * of all pending i/o.  then free the request objects
 	 * and forget about the endpoints.
 	 */
+	spin_lock(&dev->req_lock);
+	__skb_queue_purge(&dev->tx_aggr);
+	spin_unlock(&dev->req_lock);
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
 	while (!list_empty(&dev->tx_reqs)) {
@@ -1015,6 +1160,7 @@ void gether_disconnect(struct gether *link)
 	dev->header_len = 0;
 	dev->unwrap = NULL;
 	dev->wrap = NULL;
+	dev->wrap_multi = NULL;
 
 	spin_lock(&dev->lock);
 	dev->port_usb = NULL;
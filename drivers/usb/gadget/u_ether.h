@@ -72,6 +72,14 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* optional multi-datagram IN transfers: when max_pkts_per_xfer
+	 * is above one, datagrams are held while the IN queue is busy and
+	 * wrap_multi() packs as many of @list as fit into one transfer.
+	 */
+	unsigned			max_pkts_per_xfer;
+	struct sk_buff			*(*wrap_multi)(struct gether *port,
+						struct sk_buff_head *list);
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
@@ -0,0 +1,450 @@
+/*
+ * linux/fs/ext4/dir_cache.c
+ *
+ * In-memory name index for large directories.
+ *
+ * Every lookup in a directory with tens of thousands of entries walks
+ * the htree and scans a leaf block, or with no index scans the whole
+ * directory, and a lookup for a name that is not there does all of that
+ * for nothing.  Once a large directory has seen enough lookups we read
+ * it in full and hash every live entry by name to the physical block and
+ * offset it is stored at.  A lookup then reads at most the blocks of the
+ * entries whose hash matches, and a name that is not in the index is not
+ * in the directory.
+ *
+ * Directory blocks are never freed or moved while the directory is in
+ * use, so a (block, offset) pair stays valid until the entry at it is
+ * deleted, or moved by an htree leaf split.  Adding, deleting and
+ * splitting all happen under the directory's i_mutex and keep the index
+ * up to date; anything the index cannot follow drops it, and it is
+ * rebuilt after another run of lookups.  Lookups use the index under
+ * i_mutex as well, and a shrinker frees whole indexes of directories
+ * whose i_mutex it can get without waiting.
+ */
+
+#include <linux/fs.h>
+#include <linux/buffer_head.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+
+#include "ext4.h"
+
+/* Directories smaller than this are cheap enough to search on disk */
+#define EXT4_DIR_CACHE_MIN_BLOCKS	16
+/* Lookups in a directory before its index is built */
+#define EXT4_DIR_CACHE_BUILD_LOOKUPS	32
+/* Largest index hash table, and blocks read ahead while building */
+#define EXT4_DIR_CACHE_MAX_BITS		12
+#define EXT4_DIR_CACHE_RA_BLOCKS	16
+
+struct ext4_dir_cache_entry {
+	struct hlist_node	dce_node;
+	ext4_fsblk_t		dce_block;	/* Physical block of the entry */
+	u32			dce_hash;	/* full_name_hash() of the name */
+	u16			dce_offset;	/* Offset of the entry in the block */
+};
+
+struct ext4_dir_cache {
+	struct list_head	dc_lru;		/* On ext4_dir_caches once built */
+	struct inode		*dc_inode;
+	struct hlist_head	*dc_table;	/* NULL until built */
+	unsigned int		dc_bits;
+	unsigned int		dc_nr;		/* Entries in dc_table */
+	unsigned int		dc_lookups;	/* Lookups while not built */
+	int			dc_referenced;
+};
+
+static struct kmem_cache *ext4_dir_cache_cachep;
+static LIST_HEAD(ext4_dir_caches);
+static DEFINE_SPINLOCK(ext4_dir_cache_lock);
+static atomic_t ext4_dir_cache_entries = ATOMIC_INIT(0);
+
+static void ext4_dir_cache_free_table(struct hlist_head *table,
+				      unsigned int bits)
+{
+	struct ext4_dir_cache_entry *dce;
+	struct hlist_node *node, *tmp;
+	int i;
+
+	for (i = 0; i < (1 << bits); i++)
+		hlist_for_each_entry_safe(dce, node, tmp, &table[i], dce_node)
+			kmem_cache_free(ext4_dir_cache_cachep, dce);
+	kfree(table);
+}
+
+/*
+ * Throw away the index of @dc.  Called with i_mutex held, or once the
+ * inode is going away.
+ */
+static void ext4_dir_cache_release(struct ext4_dir_cache *dc)
+{
+	struct hlist_head *table;
+	unsigned int nr, bits;
+
+	spin_lock(&ext4_dir_cache_lock);
+	list_del_init(&dc->dc_lru);
+	table = dc->dc_table;
+	bits = dc->dc_bits;
+	nr = dc->dc_nr;
+	dc->dc_table = NULL;
+	dc->dc_nr = 0;
+	spin_unlock(&ext4_dir_cache_lock);
+
+	if (table) {
+		ext4_dir_cache_free_table(table, bits);
+		atomic_sub(nr, &ext4_dir_cache_entries);
+	}
+}
+
+static inline struct hlist_head *ext4_dir_cache_bucket(
+					struct ext4_dir_cache *dc, u32 hash)
+{
+	return &dc->dc_table[hash_32(hash, dc->dc_bits)];
+}
+
+static int ext4_dir_cache_insert(struct ext4_dir_cache *dc, u32 hash,
+				 ext4_fsblk_t block, unsigned int offset)
+{
+	struct ext4_dir_cache_entry *dce;
+
+	dce = kmem_cache_alloc(ext4_dir_cache_cachep, GFP_NOFS);
+	if (!dce)
+		return -ENOMEM;
+	dce->dce_hash = hash;
+	dce->dce_block = block;
+	dce->dce_offset = offset;
+	hlist_add_head(&dce->dce_node, ext4_dir_cache_bucket(dc, hash));
+	dc->dc_nr++;
+	atomic_inc(&ext4_dir_cache_entries);
+	return 0;
+}
+
+static int ext4_dir_cache_remove(struct ext4_dir_cache *dc, u32 hash,
+				 ext4_fsblk_t block, unsigned int offset)
+{
+	struct ext4_dir_cache_entry *dce;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(dce, node, ext4_dir_cache_bucket(dc, hash),
+			     dce_node) {
+		if (dce->dce_hash == hash && dce->dce_block == block &&
+		    dce->dce_offset == offset) {
+			hlist_del(&dce->dce_node);
+			kmem_cache_free(ext4_dir_cache_cachep, dce);
+			dc->dc_nr--;
+			atomic_dec(&ext4_dir_cache_entries);
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+/* Add or remove every live entry of the directory block @bh */
+static int ext4_dir_cache_scan_block(struct inode *dir,
+				     struct ext4_dir_cache *dc,
+				     struct buffer_head *bh, int add)
+{
+	struct ext4_dir_entry_2 *de;
+	unsigned int offset = 0;
+	u32 hash;
+	int err;
+
+	while (offset < dir->i_sb->s_blocksize) {
+		de = (struct ext4_dir_entry_2 *)(bh->b_data + offset);
+		if (ext4_check_dir_entry(dir, NULL, de, bh, offset))
+			return -EIO;
+		if (de->inode) {
+			hash = full_name_hash(de->name, de->name_len);
+			if (add)
+				err = ext4_dir_cache_insert(dc, hash,
+						bh->b_blocknr, offset);
+			else
+				err = ext4_dir_cache_remove(dc, hash,
+						bh->b_blocknr, offset);
+			if (err)
+				return err;
+		}
+		offset += ext4_rec_len_from_disk(de->rec_len,
+						 dir->i_sb->s_blocksize);
+	}
+	return 0;
+}
+
+/*
+ * Read the whole of @dir and index every live entry in it.
+ */
+static int ext4_dir_cache_build(struct inode *dir, struct ext4_dir_cache *dc)
+{
+	struct super_block *sb = dir->i_sb;
+	struct buffer_head *bh_use[EXT4_DIR_CACHE_RA_BLOCKS];
+	ext4_lblk_t nblocks, block = 0;
+	unsigned int bits;
+	int i, n, err = 0;
+
+	nblocks = dir->i_size >> EXT4_BLOCK_SIZE_BITS(sb);
+	bits = clamp_t(unsigned int, ilog2(nblocks) + 4, 4,
+		       EXT4_DIR_CACHE_MAX_BITS);
+	dc->dc_table = kmalloc(sizeof(struct hlist_head) << bits, GFP_NOFS);
+	if (!dc->dc_table)
+		return -ENOMEM;
+	for (i = 0; i < (1 << bits); i++)
+		INIT_HLIST_HEAD(&dc->dc_table[i]);
+	dc->dc_bits = bits;
+	dc->dc_nr = 0;
+
+	while (block < nblocks && !err) {
+		for (n = 0; n < EXT4_DIR_CACHE_RA_BLOCKS && block < nblocks;
+		     block++) {
+			struct buffer_head *bh;
+
+			bh = ext4_getblk(NULL, dir, block, 0, &err);
+			if (err)
+				break;
+			if (bh)		/* Holes hold no entries */
+				bh_use[n++] = bh;
+		}
+		for (i = 0; i < n; i++)
+			if (!buffer_uptodate(bh_use[i]))
+				ll_rw_block(READ_META, 1, &bh_use[i]);
+		for (i = 0; i < n; i++) {
+			wait_on_buffer(bh_use[i]);
+			if (!err && !buffer_uptodate(bh_use[i]))
+				err = -EIO;
+			if (!err)
+				err = ext4_dir_cache_scan_block(dir, dc,
+								bh_use[i], 1);
+			brelse(bh_use[i]);
+		}
+	}
+
+	spin_lock(&ext4_dir_cache_lock);
+	list_add_tail(&dc->dc_lru, &ext4_dir_caches);
+	spin_unlock(&ext4_dir_cache_lock);
+	if (err)
+		ext4_dir_cache_release(dc);
+	return err;
+}
+
+
+/*
+ * Return the live entry at @offset in @bh, or NULL if there is none.
+ * A cached offset can go stale without the cache noticing, so unlike
+ * ext4_check_dir_entry() a bad entry here is not reported as corruption:
+ * the caller just falls back to the on-disk search, which will.
+ */
+static struct ext4_dir_entry_2 *
+ext4_dir_cache_check_entry(struct inode *dir, struct buffer_head *bh,
+			   unsigned int offset)
+{
+	unsigned int blocksize = dir->i_sb->s_blocksize;
+	struct ext4_dir_entry_2 *de;
+	unsigned int rlen;
+
+	if (offset % 4 || offset + EXT4_DIR_REC_LEN(1) > blocksize)
+		return NULL;
+	de = (struct ext4_dir_entry_2 *)(bh->b_data + offset);
+	rlen = ext4_rec_len_from_disk(de->rec_len, blocksize);
+	if (rlen < EXT4_DIR_REC_LEN(de->name_len) || rlen % 4 ||
+	    offset + rlen > blocksize || !de->inode ||
+	    le32_to_cpu(de->inode) >
+	    le32_to_cpu(EXT4_SB(dir->i_sb)->s_es->s_inodes_count))
+		return NULL;
+	return de;
+}
+/*
+ * Look @d_name up in the index of @dir, building the index first if the
+ * directory is large and busy enough.  Returns 0 if the caller has to
+ * search the directory itself, or 1 if the index answered: then *@bhp is
+ * the buffer holding the entry, returned in *@res_dir, or NULL if @dir
+ * has no such entry.  The caller must hold @dir's i_mutex.
+ */
+int ext4_dir_cache_lookup(struct inode *dir, const struct qstr *d_name,
+			  struct buffer_head **bhp,
+			  struct ext4_dir_entry_2 **res_dir)
+{
+	struct ext4_inode_info *ei = EXT4_I(dir);
+	struct ext4_dir_cache *dc = ei->i_dir_cache;
+	struct ext4_dir_cache_entry *dce;
+	struct ext4_dir_entry_2 *de;
+	struct buffer_head *bh;
+	struct hlist_node *node;
+	u32 hash;
+
+	*bhp = NULL;
+	if (!dc) {
+		if (dir->i_size < (EXT4_DIR_CACHE_MIN_BLOCKS <<
+				   EXT4_BLOCK_SIZE_BITS(dir->i_sb)))
+			return 0;
+		dc = kzalloc(sizeof(*dc), GFP_NOFS);
+		if (!dc)
+			return 0;
+		INIT_LIST_HEAD(&dc->dc_lru);
+		dc->dc_inode = dir;
+		ei->i_dir_cache = dc;
+	}
+	if (!dc->dc_table) {
+		if (++dc->dc_lookups < EXT4_DIR_CACHE_BUILD_LOOKUPS)
+			return 0;
+		dc->dc_lookups = 0;
+		if (ext4_dir_cache_build(dir, dc))
+			return 0;
+	}
+	dc->dc_referenced = 1;
+
+	hash = full_name_hash(d_name->name, d_name->len);
+	hlist_for_each_entry(dce, node, ext4_dir_cache_bucket(dc, hash),
+			     dce_node) {
+		if (dce->dce_hash != hash)
+			continue;
+		bh = sb_bread(dir->i_sb, dce->dce_block);
+		if (!bh)
+			goto fallback;
+		de = ext4_dir_cache_check_entry(dir, bh, dce->dce_offset);
+		if (!de) {
+			brelse(bh);
+			goto fallback;
+		}
+		if (de->name_len == d_name->len &&
+		    !memcmp(de->name, d_name->name, d_name->len)) {
+			*bhp = bh;
+			*res_dir = de;
+			return 1;
+		}
+		brelse(bh);
+	}
+	return 1;
+
+fallback:
+	/* The index no longer matches the directory: search on disk */
+	ext4_dir_cache_release(dc);
+	return 0;
+}
+
+/*
+ * The entry @de in @bh has been added to (@add) or is about to be
+ * removed from @dir.
+ */
+void ext4_dir_cache_update(struct inode *dir, struct buffer_head *bh,
+			   struct ext4_dir_entry_2 *de, int add)
+{
+	struct ext4_dir_cache *dc = EXT4_I(dir)->i_dir_cache;
+	unsigned int offset;
+	u32 hash;
+	int err;
+
+	if (!dc || !dc->dc_table || !de->inode)
+		return;
+	offset = (char *)de - bh->b_data;
+	hash = full_name_hash(de->name, de->name_len);
+	if (add)
+		err = ext4_dir_cache_insert(dc, hash, bh->b_blocknr, offset);
+	else
+		err = ext4_dir_cache_remove(dc, hash, bh->b_blocknr, offset);
+	if (err)
+		ext4_dir_cache_release(dc);
+}
+
+/*
+ * Add or remove all entries of the directory block @bh, around an htree
+ * leaf split moving entries between blocks.
+ */
+void ext4_dir_cache_update_block(struct inode *dir, struct buffer_head *bh,
+				 int add)
+{
+	struct ext4_dir_cache *dc = EXT4_I(dir)->i_dir_cache;
+
+	if (dc && dc->dc_table && ext4_dir_cache_scan_block(dir, dc, bh, add))
+		ext4_dir_cache_release(dc);
+}
+
+/* @dir has changed in a way the index does not follow */
+void ext4_dir_cache_invalidate(struct inode *dir)
+{
+	struct ext4_dir_cache *dc = EXT4_I(dir)->i_dir_cache;
+
+	if (dc)
+		ext4_dir_cache_release(dc);
+}
+
+void ext4_dir_cache_free(struct inode *inode)
+{
+	struct ext4_dir_cache *dc = EXT4_I(inode)->i_dir_cache;
+
+	if (dc) {
+		ext4_dir_cache_release(dc);
+		kfree(dc);
+		EXT4_I(inode)->i_dir_cache = NULL;
+	}
+}
+
+/*
+ * Free the indexes of directories not looked up since the last pass.
+ * A directory whose i_mutex is held may be using its index, so those are
+ * skipped; holding ext4_dir_cache_lock while we have a directory's
+ * i_mutex keeps the inode from being freed under us.
+ */
+static int ext4_dir_cache_shrink(struct shrinker *shrink,
+				 struct shrink_control *sc)
+{
+	int nr_to_scan = sc->nr_to_scan;
+	struct ext4_dir_cache *dc;
+	struct hlist_head *table;
+	struct inode *inode;
+	unsigned int nr, bits;
+
+	if (nr_to_scan) {
+		if (!(sc->gfp_mask & __GFP_FS))
+			return -1;
+		spin_lock(&ext4_dir_cache_lock);
+		while (nr_to_scan > 0 && !list_empty(&ext4_dir_caches)) {
+			dc = list_first_entry(&ext4_dir_caches,
+					      struct ext4_dir_cache, dc_lru);
+			list_move_tail(&dc->dc_lru, &ext4_dir_caches);
+			inode = dc->dc_inode;
+			if (dc->dc_referenced ||
+			    !mutex_trylock(&inode->i_mutex)) {
+				dc->dc_referenced = 0;
+				nr_to_scan--;
+				continue;
+			}
+			list_del_init(&dc->dc_lru);
+			table = dc->dc_table;
+			bits = dc->dc_bits;
+			nr = dc->dc_nr;
+			dc->dc_table = NULL;
+			dc->dc_nr = 0;
+			mutex_unlock(&inode->i_mutex);
+			spin_unlock(&ext4_dir_cache_lock);
+
+			/* dc may be rebuilt or freed once the locks are dropped */
+			ext4_dir_cache_free_table(table, bits);
+			atomic_sub(nr, &ext4_dir_cache_entries);
+			nr_to_scan -= max(nr, 1U);
+			spin_lock(&ext4_dir_cache_lock);
+		}
+		spin_unlock(&ext4_dir_cache_lock);
+	}
+	return (atomic_read(&ext4_dir_cache_entries) / 100) *
+		sysctl_vfs_cache_pressure;
+}
+
+static struct shrinker ext4_dir_cache_shrinker = {
+	.shrink = ext4_dir_cache_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+int __init ext4_init_dir_cache(void)
+{
+	ext4_dir_cache_cachep = KMEM_CACHE(ext4_dir_cache_entry, 0);
+	if (!ext4_dir_cache_cachep)
+		return -ENOMEM;
+	register_shrinker(&ext4_dir_cache_shrinker);
+	return 0;
+}
+
+void ext4_exit_dir_cache(void)
+{
+	unregister_shrinker(&ext4_dir_cache_shrinker);
+	kmem_cache_destroy(ext4_dir_cache_cachep);
+}
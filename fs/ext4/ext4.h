@@ -866,6 +866,15 @@ struct ext4_inode_info {
 	 */
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
+
+	/*
+	 * Transaction in which the inode's changes went beyond what a fast
+	 * commit can log; fsync has to commit it in full.
+	 */
+	tid_t i_fc_ineligible_tid;
+
+	/* In-memory name index of a large directory, see dir_cache.c */
+	struct ext4_dir_cache *i_dir_cache;
 };
 
 /*
@@ -917,6 +926,8 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
 #define EXT4_MOUNT_INIT_INODE_TABLE	0x80000000 /* Initialize uninitialized itables */
 
+#define EXT4_MOUNT2_JOURNAL_FAST_COMMIT	0x00000001 /* Fast commits on fsync */
+
 #define clear_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt &= \
 						~EXT4_MOUNT_##opt
 #define set_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt |= \
@@ -1162,6 +1173,9 @@ struct ext4_sb_info {
 	spinlock_t s_md_lock;
 	unsigned short *s_mb_offsets;
 	unsigned int *s_mb_maxs;
+	/* initialized groups by the order of their largest free extent */
+	struct list_head *s_mb_largest_free_orders;
+	spinlock_t *s_mb_largest_free_orders_locks;
 
 	/* tunables */
 	unsigned long s_stripe;
@@ -1171,10 +1185,10 @@ struct ext4_sb_info {
 	unsigned int s_mb_stats;
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
+	unsigned int s_mb_optimize_scan;
 	unsigned int s_max_writeback_mb_bump;
 	/* where last allocation was done - for stream allocation */
-	unsigned long s_mb_last_group;
-	unsigned long s_mb_last_start;
+	struct ext4_stream_goal __percpu *s_mb_stream_goals;
 
 	/* stats for buddy allocator */
 	atomic_t s_bal_reqs;	/* number of reqs with len > 1 */
@@ -1184,6 +1198,7 @@ struct ext4_sb_info {
 	atomic_t s_bal_goals;	/* goal hits */
 	atomic_t s_bal_breaks;	/* too long searches */
 	atomic_t s_bal_2orders;	/* 2^order hits */
+	atomic_t s_bal_groups_scanned;	/* groups locked and searched */
 	spinlock_t s_bal_lock;
 	unsigned long s_mb_buddies_generated;
 	unsigned long long s_mb_generation_time;
@@ -1762,6 +1777,23 @@ extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 extern int ext4_sync_file(struct file *, int);
 extern int ext4_flush_completed_IO(struct inode *);
 
+/* dir_cache.c */
+extern int ext4_dir_cache_lookup(struct inode *, const struct qstr *,
+				 struct buffer_head **,
+				 struct ext4_dir_entry_2 **);
+extern void ext4_dir_cache_update(struct inode *, struct buffer_head *,
+				  struct ext4_dir_entry_2 *, int);
+extern void ext4_dir_cache_update_block(struct inode *, struct buffer_head *,
+					int);
+extern void ext4_dir_cache_invalidate(struct inode *);
+extern void ext4_dir_cache_free(struct inode *);
+extern int __init ext4_init_dir_cache(void);
+extern void ext4_exit_dir_cache(void);
+
+/* fast_commit.c */
+extern int ext4_fc_commit(struct inode *, tid_t);
+extern int ext4_fc_replay(journal_t *, void *, int);
+
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
 			  dx_hash_info *hinfo);
@@ -2057,7 +2089,10 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_free;	/* total free blocks */
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
+	ext4_group_t	bb_group;	/* group number */
 	struct          list_head bb_prealloc_list;
+	/* on s_mb_largest_free_orders[bb_largest_free_order] */
+	struct          list_head bb_largest_free_order_node;
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
 #endif
@@ -112,6 +112,8 @@ int __ext4_handle_dirty_metadata(const char *where, unsigned int line,
 		if (err)
 			ext4_journal_abort_handle(where, line, __func__,
 						  bh, handle, err);
+		if (inode)
+			ext4_fc_mark_ineligible(handle, inode);
 	} else {
 		if (inode)
 			mark_buffer_dirty_inode(bh, inode);
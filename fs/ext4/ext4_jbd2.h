@@ -258,6 +258,18 @@ static inline void ext4_update_inode_fsync_trans(handle_t *handle,
 	}
 }
 
+/*
+ * Record that @inode changed metadata outside its own inode in the
+ * handle's transaction, so fsync cannot use a fast commit for it.
+ */
+static inline void ext4_fc_mark_ineligible(handle_t *handle,
+					   struct inode *inode)
+{
+	if (ext4_handle_valid(handle))
+		EXT4_I(inode)->i_fc_ineligible_tid =
+			handle->h_transaction->t_tid;
+}
+
 /* super.c */
 int ext4_force_commit(struct super_block *sb);
 
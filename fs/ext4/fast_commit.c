@@ -0,0 +1,252 @@
+/*
+ * linux/fs/ext4/fast_commit.c
+ *
+ * Fast commits: make an fsync()ed file durable by logging a copy of its
+ * on-disk inode in the jbd2 fast commit area, instead of committing the
+ * whole running transaction and everything else that is in it.
+ *
+ * Only changes fully described by the inode and the extents held in it
+ * can be fast committed: overwrites, size and timestamp updates, and
+ * appends to files whose extent tree still fits in the inode.  Anything
+ * that changes other metadata on the inode's behalf (extent tree or
+ * indirect blocks, xattr blocks, links, the orphan list, freed blocks)
+ * calls ext4_fc_mark_ineligible(), and fsync then falls back to a full
+ * commit for the rest of that transaction.
+ *
+ * Replay runs from jbd2 recovery once the log itself has been replayed:
+ * it marks the blocks the logged extents point to as in use and writes
+ * the logged inode back into the inode table.  Both steps are
+ * idempotent, and nothing is ever freed, so a record never needs more
+ * than the last committed state to apply on top of.
+ */
+
+#include <linux/fs.h>
+#include <linux/jbd2.h>
+#include <linux/quotaops.h>
+#include <linux/slab.h>
+
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+
+/* A fast commit record: an inode number and the raw inode after it */
+struct ext4_fc_inode {
+	__le32	fc_ino;
+	__le16	fc_isize;	/* Size of the raw inode that follows */
+	__le16	fc_pad;
+};
+
+static int ext4_fc_eligible(struct inode *inode, tid_t tid)
+{
+	return S_ISREG(inode->i_mode) && inode->i_nlink &&
+		ext4_should_order_data(inode) &&
+		ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS) &&
+		EXT4_I(inode)->i_fc_ineligible_tid != tid &&
+		!sb_any_quota_loaded(inode->i_sb);
+}
+
+/*
+ * Make the changes @inode has in the running transaction @tid durable
+ * with a fast commit.  Returns 0 on success; on any error the caller has
+ * to commit @tid in full.
+ */
+int ext4_fc_commit(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+	journal_t *journal = EXT4_SB(sb)->s_journal;
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	struct address_space *mapping = inode->i_mapping;
+	struct ext4_fc_inode *fi;
+	struct ext4_iloc iloc;
+	int isize = EXT4_INODE_SIZE(sb);
+	int len = sizeof(*fi) + isize;
+	int err;
+
+	if (!ext4_fc_eligible(inode, tid))
+		return -EAGAIN;
+
+	fi = kmalloc(len, GFP_NOFS);
+	if (!fi)
+		return -ENOMEM;
+
+	err = jbd2_fc_begin_commit(journal, tid);
+	if (err)
+		goto out_free;
+
+	err = ext4_get_inode_loc(inode, &iloc);
+	if (err)
+		goto out;
+
+	/*
+	 * Block allocation updates the extent tree and copies it to the
+	 * inode buffer under i_data_sem, so holding it gives us a
+	 * consistent inode.  Pages still dirty or under writeback may have
+	 * had blocks allocated whose data is not on disk yet: data=ordered
+	 * only protects those through a full commit.
+	 */
+	down_read(&ei->i_data_sem);
+	if (!ext4_fc_eligible(inode, tid) ||
+	    mapping_tagged(mapping, PAGECACHE_TAG_DIRTY) ||
+	    mapping_tagged(mapping, PAGECACHE_TAG_WRITEBACK)) {
+		err = -EAGAIN;
+	} else {
+		fi->fc_ino = cpu_to_le32(inode->i_ino);
+		fi->fc_isize = cpu_to_le16(isize);
+		fi->fc_pad = 0;
+		memcpy(fi + 1, ext4_raw_inode(&iloc), isize);
+	}
+	up_read(&ei->i_data_sem);
+	brelse(iloc.bh);
+
+	if (!err)
+		err = jbd2_fc_write(journal, fi, len);
+out:
+	jbd2_fc_end_commit(journal);
+out_free:
+	kfree(fi);
+	return err;
+}
+
+/*
+ * Mark @len blocks from @block in use: a fast committed inode may point
+ * at blocks allocated in a transaction that never committed.
+ */
+static int ext4_fc_replay_blocks(struct super_block *sb, ext4_fsblk_t block,
+				 unsigned int len)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bitmap_bh, *gdp_bh;
+	ext4_group_t group;
+	ext4_grpblk_t offset;
+	unsigned int i, n, count;
+
+	if (!ext4_data_block_valid(sbi, block, len))
+		return -EIO;
+
+	while (len) {
+		ext4_get_group_no_and_offset(sb, block, &group, &offset);
+		n = min_t(unsigned int, len,
+			  EXT4_BLOCKS_PER_GROUP(sb) - offset);
+		gdp = ext4_get_group_desc(sb, group, &gdp_bh);
+		if (!gdp)
+			return -EIO;
+		bitmap_bh = ext4_read_block_bitmap(sb, group);
+		if (!bitmap_bh)
+			return -EIO;
+
+		count = 0;
+		ext4_lock_group(sb, group);
+		for (i = 0; i < n; i++)
+			if (!ext4_set_bit(offset + i, bitmap_bh->b_data))
+				count++;
+		if (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) {
+			gdp->bg_flags &= cpu_to_le16(~EXT4_BG_BLOCK_UNINIT);
+			ext4_free_blks_set(sb, gdp,
+				ext4_free_blocks_after_init(sb, group, gdp));
+		}
+		ext4_free_blks_set(sb, gdp,
+				   ext4_free_blks_count(sb, gdp) - count);
+		gdp->bg_checksum = ext4_group_desc_csum(sbi, group, gdp);
+		ext4_unlock_group(sb, group);
+
+		if (sbi->s_log_groups_per_flex) {
+			ext4_group_t flex_group = ext4_flex_group(sbi, group);
+			atomic64_sub(count,
+				     &sbi->s_flex_groups[flex_group].free_blocks);
+		}
+
+		mark_buffer_dirty(bitmap_bh);
+		mark_buffer_dirty(gdp_bh);
+		brelse(bitmap_bh);
+		block += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb,
+				struct ext4_fc_inode *fi)
+{
+	struct ext4_inode *raw_inode = (struct ext4_inode *)(fi + 1);
+	struct ext4_extent_header *eh;
+	struct ext4_extent *ex;
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	unsigned long ino = le32_to_cpu(fi->fc_ino);
+	int isize = EXT4_INODE_SIZE(sb);
+	unsigned long offset;
+	ext4_fsblk_t block;
+	int i, err;
+
+	if (ino < EXT4_FIRST_INO(sb) ||
+	    ino > le32_to_cpu(EXT4_SB(sb)->s_es->s_inodes_count) ||
+	    le16_to_cpu(fi->fc_isize) != isize)
+		return -EIO;
+
+	/*
+	 * Only a tree held entirely in the inode can have gained extents:
+	 * deeper trees change in extent blocks, which are never fast
+	 * committed.
+	 */
+	if (le32_to_cpu(raw_inode->i_flags) & EXT4_EXTENTS_FL) {
+		eh = (struct ext4_extent_header *)raw_inode->i_block;
+		if (eh->eh_magic != EXT4_EXT_MAGIC ||
+		    le16_to_cpu(eh->eh_entries) > le16_to_cpu(eh->eh_max) ||
+		    le16_to_cpu(eh->eh_max) > (sizeof(raw_inode->i_block) -
+				sizeof(*eh)) / sizeof(*ex))
+			return -EIO;
+		if (eh->eh_depth == 0) {
+			ex = EXT_FIRST_EXTENT(eh);
+			for (i = 0; i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+				err = ext4_fc_replay_blocks(sb,
+						ext4_ext_pblock(ex),
+						ext4_ext_get_actual_len(ex));
+				if (err)
+					return err;
+			}
+		}
+	}
+
+	gdp = ext4_get_group_desc(sb, (ino - 1) / EXT4_INODES_PER_GROUP(sb),
+				  NULL);
+	if (!gdp)
+		return -EIO;
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) * isize;
+	block = ext4_inode_table(sb, gdp) +
+		(offset >> EXT4_BLOCK_SIZE_BITS(sb));
+	bh = sb_bread(sb, block);
+	if (!bh)
+		return -EIO;
+	memcpy(bh->b_data + (offset & (sb->s_blocksize - 1)), raw_inode,
+	       isize);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
+
+/*
+ * jbd2 recovery callback: replay the records of one fast commit block.
+ */
+int ext4_fc_replay(journal_t *journal, void *data, int len)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_fc_inode *fi;
+	int size, err;
+
+	while (len >= (int)sizeof(*fi)) {
+		fi = data;
+		size = sizeof(*fi) + le16_to_cpu(fi->fc_isize);
+		if (size > len)
+			return -EIO;
+		err = ext4_fc_replay_inode(sb, fi);
+		if (err) {
+			ext4_msg(sb, KERN_ERR, "fast commit replay of inode "
+				 "%u failed", le32_to_cpu(fi->fc_ino));
+			return err;
+		}
+		data += size;
+		len -= size;
+	}
+	return 0;
+}
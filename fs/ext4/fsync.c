@@ -212,6 +212,14 @@ int ext4_sync_file(struct file *file, int datasync)
 	}
 
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
+	/*
+	 * A fast commit writes just this inode to the journal and leaves
+	 * the rest of the running transaction alone; when the inode does
+	 * not qualify we fall back to committing the whole transaction.
+	 */
+	if (test_opt2(inode->i_sb, JOURNAL_FAST_COMMIT) &&
+	    !ext4_fc_commit(inode, commit_tid))
+		goto out;
 	if (journal->j_flags & JBD2_BARRIER &&
 	    !jbd2_trans_will_send_data_barrier(journal, commit_tid))
 		needs_barrier = true;
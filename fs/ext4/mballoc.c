@@ -679,23 +679,42 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 
 /*
  * Cache the order of the largest free extent we have available in this block
- * group.
+ * group, and keep the group on the matching s_mb_largest_free_orders list.
+ * Called with the group locked; the list locks nest inside it.
  */
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int old = grp->bb_largest_free_order;
+	int new = -1; /* uninit */
 	int i;
 	int bits;
 
-	grp->bb_largest_free_order = -1; /* uninit */
-
 	bits = sb->s_blocksize_bits + 1;
 	for (i = bits; i >= 0; i--) {
 		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+			new = i;
 			break;
 		}
 	}
+	if (new == old)
+		return;
+
+	if (old >= 0) {
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[old]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		grp->bb_largest_free_order = new;
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[old]);
+	} else {
+		grp->bb_largest_free_order = new;
+	}
+	if (new >= 0) {
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[new]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[new]);
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[new]);
+	}
 }
 
 static noinline_for_stack
@@ -1553,10 +1572,12 @@ static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 	get_page(ac->ac_buddy_page);
 	/* store last allocated for subsequent stream allocation */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		spin_lock(&sbi->s_md_lock);
-		sbi->s_mb_last_group = ac->ac_f_ex.fe_group;
-		sbi->s_mb_last_start = ac->ac_f_ex.fe_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_stream_goal *sg;
+
+		sg = get_cpu_ptr(sbi->s_mb_stream_goals);
+		sg->sg_group = ac->ac_f_ex.fe_group;
+		sg->sg_start = ac->ac_f_ex.fe_start;
+		put_cpu_ptr(sbi->s_mb_stream_goals);
 	}
 }
 
@@ -1954,6 +1975,50 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Pick the next group to try for a 2^N request from the lists of groups
+ * by the order of their largest free extent, rather than walking every
+ * group from the goal.  The group picked goes to the tail of its list,
+ * so concurrent allocations spread over different groups instead of
+ * queueing on one group lock, and a group that turned out not to fit
+ * is not picked again before the others have been tried.
+ */
+static int ext4_mb_next_order_group(struct ext4_allocation_context *ac,
+				    ext4_group_t ngroups, ext4_group_t *group)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int flex_size = ext4_flex_bg_size(sbi);
+	struct ext4_group_info *grp;
+	struct list_head *head;
+	int order, found = 0;
+
+	for (order = ac->ac_2order; order <= sb->s_blocksize_bits + 1;
+	     order++) {
+		head = &sbi->s_mb_largest_free_orders[order];
+		if (list_empty(head))
+			continue;
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+		list_for_each_entry(grp, head, bb_largest_free_order_node) {
+			if (grp->bb_group >= ngroups)
+				continue;
+			/* Same as ext4_mb_good_group() */
+			if ((ac->ac_flags & EXT4_MB_HINT_DATA) &&
+			    (flex_size >= EXT4_FLEX_SIZE_DIR_ALLOC_SCHEME) &&
+			    ((grp->bb_group % flex_size) == 0))
+				continue;
+			list_move_tail(&grp->bb_largest_free_order_node, head);
+			*group = grp->bb_group;
+			found = 1;
+			break;
+		}
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+		if (found)
+			return 1;
+	}
+	return 0;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
@@ -2001,13 +2066,14 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 			ac->ac_2order = i - 1;
 	}
 
-	/* if stream allocation is enabled, use global goal */
+	/* if stream allocation is enabled, use this CPU's stream goal */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		/* TBD: may be hot point */
-		spin_lock(&sbi->s_md_lock);
-		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
-		ac->ac_g_ex.fe_start = sbi->s_mb_last_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_stream_goal *sg;
+
+		sg = get_cpu_ptr(sbi->s_mb_stream_goals);
+		ac->ac_g_ex.fe_group = sg->sg_group;
+		ac->ac_g_ex.fe_start = sg->sg_start;
+		put_cpu_ptr(sbi->s_mb_stream_goals);
 	}
 
 	/* Let's just scan groups to find more-less suitable blocks */
@@ -2026,6 +2092,16 @@ repeat:
 		group = ac->ac_g_ex.fe_group;
 
 		for (i = 0; i < ngroups; group++, i++) {
+			/*
+			 * The goal group keeps related blocks together, so
+			 * it is always tried first; the order lists only
+			 * pick where to look after it.
+			 */
+			if (cr == 0 && sbi->s_mb_optimize_scan && i > 0) {
+				if (!ext4_mb_next_order_group(ac, ngroups,
+							      &group))
+					break;
+			}
 			/*
 			 * Artificially restricted ngroups for non-extent
 			 * files makes group > ngroups possible on first loop.
@@ -2261,9 +2337,11 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	}
 
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_group = group;
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2461,6 +2539,21 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		i++;
 	} while (i <= sb->s_blocksize_bits + 1);
 
+	i = (sb->s_blocksize_bits + 2);
+	sbi->s_mb_largest_free_orders =
+		kmalloc(i * sizeof(struct list_head), GFP_KERNEL);
+	sbi->s_mb_largest_free_orders_locks =
+		kmalloc(i * sizeof(spinlock_t), GFP_KERNEL);
+	if (sbi->s_mb_largest_free_orders == NULL ||
+	    sbi->s_mb_largest_free_orders_locks == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (j = 0; j < i; j++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[j]);
+		spin_lock_init(&sbi->s_mb_largest_free_orders_locks[j]);
+	}
+
 	/* init file for buddy data */
 	ret = ext4_mb_init_backend(sb);
 	if (ret != 0) {
@@ -2476,6 +2569,21 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
+	sbi->s_mb_optimize_scan = MB_DEFAULT_OPTIMIZE_SCAN;
+
+	/* start each CPU's stream allocations in a different group */
+	sbi->s_mb_stream_goals = alloc_percpu(struct ext4_stream_goal);
+	if (sbi->s_mb_stream_goals == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for_each_possible_cpu(i) {
+		struct ext4_stream_goal *sg;
+		sg = per_cpu_ptr(sbi->s_mb_stream_goals, i);
+		sg->sg_group = div_u64((u64)i * ext4_get_groups_count(sb),
+				       nr_cpu_ids);
+		sg->sg_start = 0;
+	}
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
@@ -2499,6 +2607,9 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		sbi->s_journal->j_commit_callback = release_blocks_on_commit;
 out:
 	if (ret) {
+		free_percpu(sbi->s_mb_stream_goals);
+		kfree(sbi->s_mb_largest_free_orders);
+		kfree(sbi->s_mb_largest_free_orders_locks);
 		kfree(sbi->s_mb_offsets);
 		kfree(sbi->s_mb_maxs);
 	}
@@ -2564,9 +2675,11 @@ int ext4_mb_release(struct super_block *sb)
 				atomic_read(&sbi->s_bal_reqs),
 				atomic_read(&sbi->s_bal_success));
 		printk(KERN_INFO
-		      "EXT4-fs: mballoc: %u extents scanned, %u goal hits, "
-				"%u 2^N hits, %u breaks, %u lost\n",
+		      "EXT4-fs: mballoc: %u extents scanned, %u groups "
+				"scanned, %u goal hits, %u 2^N hits, %u breaks, "
+				"%u lost\n",
 				atomic_read(&sbi->s_bal_ex_scanned),
+				atomic_read(&sbi->s_bal_groups_scanned),
 				atomic_read(&sbi->s_bal_goals),
 				atomic_read(&sbi->s_bal_2orders),
 				atomic_read(&sbi->s_bal_breaks),
@@ -2582,6 +2695,9 @@ int ext4_mb_release(struct super_block *sb)
 	}
 
 	free_percpu(sbi->s_locality_groups);
+	free_percpu(sbi->s_mb_stream_goals);
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
 
 	return 0;
 }
@@ -3051,6 +3167,7 @@ static void ext4_mb_collect_stats(struct ext4_allocation_context *ac)
 		if (ac->ac_b_ex.fe_len >= ac->ac_o_ex.fe_len)
 			atomic_inc(&sbi->s_bal_success);
 		atomic_add(ac->ac_found, &sbi->s_bal_ex_scanned);
+		atomic_add(ac->ac_groups_scanned, &sbi->s_bal_groups_scanned);
 		if (ac->ac_g_ex.fe_start == ac->ac_b_ex.fe_start &&
 				ac->ac_g_ex.fe_group == ac->ac_b_ex.fe_group)
 			atomic_inc(&sbi->s_bal_goals);
@@ -4489,6 +4606,7 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 
 	ext4_debug("freeing block %llu\n", block);
 	trace_ext4_free_blocks(inode, block, count, flags);
+	ext4_fc_mark_ineligible(handle, inode);
 
 	if (flags & EXT4_FREE_BLOCKS_FORGET) {
 		struct buffer_head *tbh = bh;
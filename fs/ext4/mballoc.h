@@ -94,6 +94,12 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * pick groups for 2^N requests from the lists of groups by the order
+ * of their largest free extent instead of scanning all groups
+ */
+#define MB_DEFAULT_OPTIMIZE_SCAN	1
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
@@ -162,6 +168,17 @@ struct ext4_locality_group {
 	spinlock_t		lg_prealloc_lock;
 };
 
+/*
+ * Where the last stream allocation on a CPU ended: the goal for the next
+ * one when the inode's own goal is taken.  Kept per CPU so that
+ * concurrent large writers fill different groups instead of competing
+ * for the same one.
+ */
+struct ext4_stream_goal {
+	ext4_group_t		sg_group;
+	ext4_grpblk_t		sg_start;
+};
+
 struct ext4_allocation_context {
 	struct inode *ac_inode;
 	struct super_block *ac_sb;
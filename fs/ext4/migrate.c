@@ -372,6 +372,7 @@ static int ext4_ext_swap_inode_data(handle_t *handle, struct inode *inode,
 		goto err_out;
 	} else
 		ext4_clear_inode_state(inode, EXT4_STATE_EXT_MIGRATE);
+	ext4_fc_mark_ineligible(handle, inode);
 	/*
 	 * We have the extent map build with the tmp inode.
 	 * Now copy the i_data across
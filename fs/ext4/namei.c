@@ -879,6 +879,8 @@ static struct buffer_head * ext4_find_entry (struct inode *dir,
 		nblocks = 1;
 		goto restart;
 	}
+	if (ext4_dir_cache_lookup(dir, d_name, &bh, res_dir))
+		return bh;
 	if (is_dx(dir)) {
 		bh = ext4_dx_find_entry(dir, d_name, res_dir, &err);
 		/*
@@ -1186,6 +1188,8 @@ static struct ext4_dir_entry_2 *do_split(handle_t *handle, struct inode *dir,
 			     blocksize, hinfo, map);
 	map -= count;
 	dx_sort_map(map, count);
+	/* Entries are about to move: index them again once they have */
+	ext4_dir_cache_update_block(dir, *bh, 0);
 	/* Split the existing block in the middle, size-wise */
 	size = 0;
 	move = 0;
@@ -1211,6 +1215,8 @@ static struct ext4_dir_entry_2 *do_split(handle_t *handle, struct inode *dir,
 					   blocksize);
 	de2->rec_len = ext4_rec_len_to_disk(data2 + blocksize - (char *) de2,
 					    blocksize);
+	ext4_dir_cache_update_block(dir, *bh, 1);
+	ext4_dir_cache_update_block(dir, bh2, 1);
 	dxtrace(dx_show_leaf (hinfo, (struct ext4_dir_entry_2 *) data1, blocksize, 1));
 	dxtrace(dx_show_leaf (hinfo, (struct ext4_dir_entry_2 *) data2, blocksize, 1));
 
@@ -1305,6 +1311,7 @@ static int add_dirent_to_buf(handle_t *handle, struct dentry *dentry,
 		de->inode = 0;
 	de->name_len = namelen;
 	memcpy(de->name, name, namelen);
+	ext4_dir_cache_update(dir, bh, de, 1);
 	/*
 	 * XXX shouldn't update any times until successful
 	 * completion of syscall, but too many callers depend
@@ -1358,6 +1365,7 @@ static int make_indexed_dir(handle_t *handle, struct dentry *dentry,
 		brelse(bh);
 		return retval;
 	}
+	ext4_dir_cache_invalidate(dir);
 	root = (struct dx_root *) bh->b_data;
 
 	/* The 0th block becomes the root, move the dirents out */
@@ -1659,6 +1667,7 @@ static int ext4_delete_entry(handle_t *handle,
 				ext4_std_error(dir->i_sb, err);
 				return err;
 			}
+			ext4_dir_cache_update(dir, bh, de, 0);
 			if (pde)
 				pde->rec_len = ext4_rec_len_to_disk(
 					ext4_rec_len_from_disk(pde->rec_len,
@@ -1690,6 +1699,7 @@ static int ext4_delete_entry(handle_t *handle,
  */
 static void ext4_inc_count(handle_t *handle, struct inode *inode)
 {
+	ext4_fc_mark_ineligible(handle, inode);
 	inc_nlink(inode);
 	if (is_dx(inode) && inode->i_nlink > 1) {
 		/* limit is 16-bit i_links_count */
@@ -1707,6 +1717,7 @@ static void ext4_inc_count(handle_t *handle, struct inode *inode)
  */
 static void ext4_dec_count(handle_t *handle, struct inode *inode)
 {
+	ext4_fc_mark_ineligible(handle, inode);
 	drop_nlink(inode);
 	if (S_ISDIR(inode->i_mode) && inode->i_nlink == 0)
 		inc_nlink(inode);
@@ -1980,6 +1991,7 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 	if (!ext4_handle_valid(handle))
 		return 0;
 
+	ext4_fc_mark_ineligible(handle, inode);
 	mutex_lock(&EXT4_SB(sb)->s_orphan_lock);
 	if (!list_empty(&EXT4_I(inode)->i_orphan))
 		goto out_unlock;
@@ -2067,6 +2079,8 @@ int ext4_orphan_del(handle_t *handle, struct inode *inode)
 	if (list_empty(&ei->i_orphan))
 		goto out;
 
+	if (handle)
+		ext4_fc_mark_ineligible(handle, inode);
 	ino_next = NEXT_ORPHAN(inode);
 	prev = ei->i_orphan.prev;
 	sbi = EXT4_SB(inode->i_sb);
@@ -2228,6 +2242,7 @@ static int ext4_unlink(struct inode *dir, struct dentry *dentry)
 	dir->i_ctime = dir->i_mtime = ext4_current_time(dir);
 	ext4_update_dx_flag(dir);
 	ext4_mark_inode_dirty(handle, dir);
+	ext4_fc_mark_ineligible(handle, inode);
 	drop_nlink(inode);
 	if (!inode->i_nlink)
 		ext4_orphan_add(handle, inode);
@@ -2433,6 +2448,7 @@ static int ext4_rename(struct inode *old_dir, struct dentry *old_dentry,
 	retval = -ENOENT;
 	if (!old_bh || le32_to_cpu(old_de->inode) != old_inode->i_ino)
 		goto end_rename;
+	ext4_fc_mark_ineligible(handle, old_inode);
 
 	new_inode = new_dentry->d_inode;
 	new_bh = ext4_find_entry(new_dir, &new_dentry->d_name, &new_de);
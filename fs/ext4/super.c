@@ -871,6 +871,8 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	ei->cur_aio_dio = NULL;
 	ei->i_sync_tid = 0;
 	ei->i_datasync_tid = 0;
+	ei->i_fc_ineligible_tid = 0;
+	ei->i_dir_cache = NULL;
 	atomic_set(&ei->i_ioend_count, 0);
 	atomic_set(&ei->i_aiodio_unwritten, 0);
 
@@ -941,6 +943,7 @@ void ext4_clear_inode(struct inode *inode)
 	end_writeback(inode);
 	dquot_drop(inode);
 	ext4_discard_preallocations(inode);
+	ext4_dir_cache_free(inode);
 	if (EXT4_I(inode)->jinode) {
 		jbd2_journal_release_jbd_inode(EXT4_JOURNAL(inode),
 					       EXT4_I(inode)->jinode);
@@ -1070,6 +1073,8 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 		seq_puts(seq, ",journal_async_commit");
 	else if (test_opt(sb, JOURNAL_CHECKSUM))
 		seq_puts(seq, ",journal_checksum");
+	if (test_opt2(sb, JOURNAL_FAST_COMMIT))
+		seq_puts(seq, ",journal_fast_commit");
 	if (test_opt(sb, I_VERSION))
 		seq_puts(seq, ",i_version");
 	if (!test_opt(sb, DELALLOC) &&
@@ -1294,6 +1299,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
+	Opt_journal_fast_commit,
 };
 
 static const match_table_t tokens = {
@@ -1328,6 +1334,7 @@ static const match_table_t tokens = {
 	{Opt_journal_dev, "journal_dev=%u"},
 	{Opt_journal_checksum, "journal_checksum"},
 	{Opt_journal_async_commit, "journal_async_commit"},
+	{Opt_journal_fast_commit, "journal_fast_commit"},
 	{Opt_abort, "abort"},
 	{Opt_data_journal, "data=journal"},
 	{Opt_data_ordered, "data=ordered"},
@@ -1602,6 +1609,9 @@ static int parse_options(char *options, struct super_block *sb,
 			set_opt(sb, JOURNAL_ASYNC_COMMIT);
 			set_opt(sb, JOURNAL_CHECKSUM);
 			break;
+		case Opt_journal_fast_commit:
+			set_opt2(sb, JOURNAL_FAST_COMMIT);
+			break;
 		case Opt_noload:
 			set_opt(sb, NOLOAD);
 			break;
@@ -2533,6 +2543,7 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_optimize_scan, s_mb_optimize_scan);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2549,6 +2560,7 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_optimize_scan),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -3547,6 +3559,18 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 				JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT);
 	}
 
+	if (test_opt2(sb, JOURNAL_FAST_COMMIT)) {
+		if (!jbd2_journal_set_features(sbi->s_journal, 0, 0,
+				JBD2_FEATURE_INCOMPAT_FAST_COMMIT)) {
+			ext4_msg(sb, KERN_WARNING, "journal too small or busy "
+				 "for fast commits, disabling them");
+			clear_opt2(sb, JOURNAL_FAST_COMMIT);
+		}
+	} else {
+		jbd2_journal_clear_features(sbi->s_journal, 0, 0,
+				JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	}
+
 	/* We have now updated the journal if required, so we can
 	 * validate the data journaling mode. */
 	switch (test_opt(sb, DATA_FLAGS)) {
@@ -4009,6 +4033,7 @@ static int ext4_load_journal(struct super_block *sb,
 		if (save)
 			memcpy(save, ((char *) es) +
 			       EXT4_S_ERR_START, EXT4_S_ERR_LEN);
+		journal->j_fc_replay_callback = ext4_fc_replay;
 		err = jbd2_journal_load(journal);
 		if (save)
 			memcpy(((char *) es) + EXT4_S_ERR_START,
@@ -4977,9 +5002,12 @@ static int __init ext4_init_fs(void)
 	err = ext4_init_xattr();
 	if (err)
 		goto out2;
-	err = init_inodecache();
+	err = ext4_init_dir_cache();
 	if (err)
 		goto out1;
+	err = init_inodecache();
+	if (err)
+		goto out0;
 	register_as_ext3();
 	register_as_ext2();
 	err = register_filesystem(&ext4_fs_type);
@@ -4993,6 +5021,8 @@ out:
 	unregister_as_ext2();
 	unregister_as_ext3();
 	destroy_inodecache();
+out0:
+	ext4_exit_dir_cache();
 out1:
 	ext4_exit_xattr();
 out2:
@@ -5017,6 +5047,7 @@ static void __exit ext4_exit_fs(void)
 	unregister_as_ext3();
 	unregister_filesystem(&ext4_fs_type);
 	destroy_inodecache();
+	ext4_exit_dir_cache();
 	ext4_exit_xattr();
 	ext4_exit_mballoc();
 	ext4_exit_feat_adverts();
@@ -430,6 +430,7 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry, int mode,
 	req->out.args[1].size = sizeof(outopen);
 	req->out.args[1].value = &outopen;
 	fuse_request_send(fc, req);
+	fuse_passthrough_setup(ff, req, &outopen);
 	err = req->out.h.error;
 	if (err) {
 		if (err == -ENOSYS)
@@ -1286,7 +1287,7 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	struct fuse_setattr_in inarg;
 	struct fuse_attr_out outarg;
 	bool is_truncate = false;
-	loff_t oldsize;
+	loff_t oldsize, newsize;
 	int err;
 
 	if (!fuse_allow_task(fc, current))
@@ -1358,7 +1359,10 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	fuse_change_attributes_common(inode, &outarg.attr,
 				      attr_timeout(&outarg));
 	oldsize = inode->i_size;
-	i_size_write(inode, outarg.attr.size);
+	/* see fuse_change_attributes() */
+	if (is_truncate || fuse_size_from_server(inode))
+		i_size_write(inode, outarg.attr.size);
+	newsize = inode->i_size;
 
 	if (is_truncate) {
 		/* NOTE: this may release/reacquire fc->lock */
@@ -1370,8 +1374,8 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	 * Only call invalidate_inode_pages2() after removing
 	 * FUSE_NOWRITE, otherwise fuse_launder_page() would deadlock.
 	 */
-	if (S_ISREG(inode->i_mode) && oldsize != outarg.attr.size) {
-		truncate_pagecache(inode, oldsize, outarg.attr.size);
+	if (S_ISREG(inode->i_mode) && oldsize != newsize) {
+		truncate_pagecache(inode, oldsize, newsize);
 		invalidate_inode_pages2(inode->i_mapping);
 	}
 
@@ -23,8 +23,11 @@
 #include <linux/poll.h>
 #include <linux/workqueue.h>
 
-/** Max number of pages that can be used in a single read request */
-#define FUSE_MAX_PAGES_PER_REQ 32
+/** Default max number of pages that can be used in a single request */
+#define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
+
+/** Upper bound for the max number of pages negotiated with FUSE_MAX_PAGES */
+#define FUSE_MAX_MAX_PAGES 256
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -35,6 +38,8 @@
 /** Number of dentries for each connection in the control filesystem */
 #define FUSE_CTL_NUM_DENTRIES 5
 
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** If the FUSE_DEFAULT_PERMISSIONS flag is given, the filesystem
     module will check permissions based on the file mode.  Otherwise no
     permission checking is done in the kernel */
@@ -138,6 +143,9 @@ struct fuse_file {
 
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
+
+	/** Lower file taking reads and writes if FOPEN_PASSTHROUGH */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -288,7 +296,13 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page **pages;
+
+	/** size of the page vector */
+	unsigned max_pages;
+
+	/** page vector used unless more pages were asked for */
+	struct page *inline_pages[FUSE_DEFAULT_MAX_PAGES_PER_REQ];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -299,6 +313,9 @@ struct fuse_req {
 	/** File used in the request (or NULL) */
 	struct fuse_file *ff;
 
+	/** Lower file named by an OPEN or CREATE reply (or NULL) */
+	struct file *passthrough_filp;
+
 	/** Inode used in the request or NULL */
 	struct inode *inode;
 
@@ -475,6 +492,18 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** Allow open replies to pass file data I/O to a lower file */
+	unsigned passthrough:1;
+
+	/** Device opener may be offered passthrough (has CAP_SYS_ADMIN) */
+	unsigned passthrough_ok:1;
+
+	/** Keep dirty pages in the page cache instead of writing through */
+	unsigned writeback_cache:1;
+
+	/** Maximum number of pages in a READ or WRITE request */
+	unsigned max_pages;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -629,6 +658,12 @@ void fuse_change_attributes(struct inode *inode, struct fuse_attr *attr,
 void fuse_change_attributes_common(struct inode *inode, struct fuse_attr *attr,
 				   u64 attr_valid);
 
+/**
+ * Can the size reported by the filesystem replace the cached one?
+ * Called with fc->lock held
+ */
+bool fuse_size_from_server(struct inode *inode);
+
 /**
  * Initialize the client device
  */
@@ -647,7 +682,12 @@ void fuse_ctl_cleanup(void);
  */
 struct fuse_req *fuse_request_alloc(void);
 
-struct fuse_req *fuse_request_alloc_nofs(void);
+/**
+ * Allocate a request with room for at least npages pages
+ */
+struct fuse_req *fuse_request_alloc_pages(unsigned npages);
+
+struct fuse_req *fuse_request_alloc_nofs(unsigned npages);
 
 /**
  * Free a request
@@ -659,6 +699,11 @@ void fuse_request_free(struct fuse_req *req);
  */
 struct fuse_req *fuse_get_req(struct fuse_conn *fc);
 
+/**
+ * Get a request with room for at least npages pages
+ */
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages);
+
 /**
  * Gets a requests for a file operation, always succeeds
  */
@@ -766,4 +811,16 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+/**
+ * Passthrough of file data I/O to a lower file
+ */
+void fuse_passthrough_setup_req(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_setup(struct fuse_file *ff, struct fuse_req *req,
+			    struct fuse_open_out *outarg);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+
 #endif /* _FS_FUSE_I_H */
@@ -20,6 +20,7 @@
 #include <linux/random.h>
 #include <linux/sched.h>
 #include <linux/exportfs.h>
+#include <linux/security.h>
 
 MODULE_AUTHOR("Miklos Szeredi <miklos@szeredi.hu>");
 MODULE_DESCRIPTION("Filesystem in Userspace");
@@ -47,8 +48,6 @@ MODULE_PARM_DESC(max_user_congthresh,
  "Global limit for the maximum congestion threshold an "
  "unprivileged user can set");
 
-#define FUSE_SUPER_MAGIC 0x65735546
-
 #define FUSE_DEFAULT_BLKSIZE 512
 
 /** Maximum number of outstanding background requests */
@@ -192,6 +191,21 @@ void fuse_change_attributes_common(struct inode *inode, struct fuse_attr *attr,
 	fi->orig_ino = attr->ino;
 }
 
+/*
+ * With a writeback cache the kernel knows the size better than the
+ * filesystem while the file may have writes it has not seen yet: while
+ * it is open for writing, or has dirty pages or writeback in flight.
+ */
+bool fuse_size_from_server(struct inode *inode)
+{
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+
+	return !fc->writeback_cache || !S_ISREG(inode->i_mode) ||
+	       (list_empty(&fi->write_files) && list_empty(&fi->writepages) &&
+		!mapping_tagged(inode->i_mapping, PAGECACHE_TAG_DIRTY));
+}
+
 void fuse_change_attributes(struct inode *inode, struct fuse_attr *attr,
 			    u64 attr_valid, u64 attr_version)
 {
@@ -208,11 +222,12 @@ void fuse_change_attributes(struct inode *inode, struct fuse_attr *attr,
 	fuse_change_attributes_common(inode, attr, attr_valid);
 
 	oldsize = inode->i_size;
-	i_size_write(inode, attr->size);
+	if (fuse_size_from_server(inode))
+		i_size_write(inode, attr->size);
 	spin_unlock(&fc->lock);
 
-	if (S_ISREG(inode->i_mode) && oldsize != attr->size) {
-		truncate_pagecache(inode, oldsize, attr->size);
+	if (S_ISREG(inode->i_mode) && oldsize != inode->i_size) {
+		truncate_pagecache(inode, oldsize, inode->i_size);
 		invalidate_inode_pages2(inode->i_mapping);
 	}
 }
@@ -551,6 +566,7 @@ void fuse_conn_init(struct fuse_conn *fc)
 	atomic_set(&fc->num_waiting, 0);
 	fc->max_background = FUSE_DEFAULT_MAX_BACKGROUND;
 	fc->congestion_threshold = FUSE_DEFAULT_CONGESTION_THRESHOLD;
+	fc->max_pages = FUSE_DEFAULT_MAX_PAGES_PER_REQ;
 	fc->khctr = 0;
 	fc->polled_files = RB_ROOT;
 	fc->reqctr = 0;
@@ -835,6 +851,18 @@ static void process_init_reply(struct fuse_conn *fc, struct fuse_req *req)
 				fc->big_writes = 1;
 			if (arg->flags & FUSE_DONT_MASK)
 				fc->dont_mask = 1;
+			if ((arg->flags & FUSE_PASSTHROUGH) &&
+			    fc->passthrough_ok)
+				fc->passthrough = 1;
+			if (arg->flags & FUSE_WRITEBACK_CACHE)
+				fc->writeback_cache = 1;
+			if (arg->flags & FUSE_MAX_PAGES) {
+				fc->max_pages = clamp_t(unsigned,
+					arg->max_pages, 1, FUSE_MAX_MAX_PAGES);
+				/* let readahead fill the larger requests */
+				fc->bdi.ra_pages = max(fc->bdi.ra_pages,
+						       fc->max_pages);
+			}
 		} else {
 			ra_pages = fc->max_read / PAGE_CACHE_SIZE;
 			fc->no_lock = 1;
@@ -856,9 +884,14 @@ static void fuse_send_init(struct fuse_conn *fc, struct fuse_req *req)
 
 	arg->major = FUSE_KERNEL_VERSION;
 	arg->minor = FUSE_KERNEL_MINOR_VERSION;
-	arg->max_readahead = fc->bdi.ra_pages * PAGE_CACHE_SIZE;
+	/* only a reply with FUSE_MAX_PAGES can raise bdi.ra_pages this far */
+	arg->max_readahead = max_t(unsigned, fc->bdi.ra_pages,
+				   FUSE_MAX_MAX_PAGES) * PAGE_CACHE_SIZE;
 	arg->flags |= FUSE_ASYNC_READ | FUSE_POSIX_LOCKS | FUSE_ATOMIC_O_TRUNC |
-		FUSE_EXPORT_SUPPORT | FUSE_BIG_WRITES | FUSE_DONT_MASK;
+		FUSE_EXPORT_SUPPORT | FUSE_BIG_WRITES | FUSE_DONT_MASK |
+		FUSE_WRITEBACK_CACHE | FUSE_MAX_PAGES;
+	if (fc->passthrough_ok)
+		arg->flags |= FUSE_PASSTHROUGH;
 	req->in.h.opcode = FUSE_INIT;
 	req->in.numargs = 1;
 	req->in.args[0].size = sizeof(*arg);
@@ -984,6 +1017,15 @@ static int fuse_fill_super(struct super_block *sb, void *data, int silent)
 		fc->dont_mask = 1;
 	sb->s_flags |= MS_POSIXACL;
 
+	/*
+	 * Passthrough lets the daemon hand any file it has open to the
+	 * opener, so keep it to daemons privileged enough to do that
+	 * anyway.  Check whoever opened the device, not the mounter, which
+	 * is often the setuid fusermount.
+	 */
+	if (security_capable(&init_user_ns, file->f_cred, CAP_SYS_ADMIN) == 0)
+		fc->passthrough_ok = 1;
+
 	fc->release = fuse_free_conn;
 	fc->flags = d.flags;
 	fc->user_id = d.user_id;
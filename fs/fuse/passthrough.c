@@ -0,0 +1,176 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/aio.h>
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/fsnotify.h>
+#include <linux/pagemap.h>
+
+/*
+ * Called from fuse_dev_do_write() in the context of the replying daemon,
+ * so that passthrough_fd is looked up in the daemon's file table.  The
+ * reference is picked up by the opener in fuse_passthrough_setup().
+ */
+void fuse_passthrough_setup_req(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *lower;
+
+	if (req->in.h.opcode == FUSE_OPEN)
+		outarg = req->out.args[0].value;
+	else if (req->in.h.opcode == FUSE_CREATE)
+		outarg = req->out.args[1].value;
+	else
+		return;
+
+	if (req->out.h.error || !(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	/* fall back to normal I/O unless the lower file is usable */
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+	lower = fget(outarg->passthrough_fd);
+	if (!lower)
+		return;
+
+	if (!S_ISREG(lower->f_path.dentry->d_inode->i_mode) ||
+	    !lower->f_op || !lower->f_op->aio_read ||
+	    !lower->f_op->aio_write ||
+	    lower->f_path.dentry->d_sb->s_magic == FUSE_SUPER_MAGIC) {
+		fput(lower);
+		return;
+	}
+
+	outarg->open_flags |= FOPEN_PASSTHROUGH;
+	req->passthrough_filp = lower;
+}
+
+/*
+ * Take over the lower file of a completed OPEN or CREATE request.
+ */
+void fuse_passthrough_setup(struct fuse_file *ff, struct fuse_req *req,
+			    struct fuse_open_out *outarg)
+{
+	struct file *lower = req->passthrough_filp;
+
+	if (!lower)
+		return;
+
+	req->passthrough_filp = NULL;
+	if (req->out.h.error || (outarg->open_flags & FOPEN_DIRECT_IO)) {
+		outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+		fput(lower);
+		return;
+	}
+	ff->passthrough_filp = lower;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
+
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos, int rw)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	struct file *lower = ff->passthrough_filp;
+	size_t count = iov_length(iov, nr_segs);
+	const struct cred *old_cred;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	if (!(lower->f_mode & (rw == READ ? FMODE_READ : FMODE_WRITE)))
+		return -EBADF;
+
+	/* the daemon opened the lower file, access it with its credentials */
+	old_cred = override_creds(lower->f_cred);
+
+	ret = rw_verify_area(rw, lower, &pos, count);
+	if (ret < 0)
+		goto out;
+	count = ret;
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = count;
+	kiocb.ki_nbytes = count;
+	if (rw == READ)
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, pos);
+	else
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+
+	if (ret > 0) {
+		iocb->ki_pos = kiocb.ki_pos;
+		if (rw == READ)
+			fsnotify_access(lower);
+		else
+			fsnotify_modify(lower);
+	}
+out:
+	revert_creds(old_cred);
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	struct address_space *mapping = iocb->ki_filp->f_mapping;
+	size_t count = iov_length(iov, nr_segs);
+	int err;
+
+	if (!count)
+		return 0;
+
+	/* pages dirtied through a shared mapping are written by the daemon */
+	err = filemap_write_and_wait_range(mapping, pos, pos + count - 1);
+	if (err)
+		return err;
+
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, READ);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	size_t count = iov_length(iov, nr_segs);
+	ssize_t ret;
+
+	if (!count)
+		return 0;
+
+	mutex_lock(&inode->i_mutex);
+	/* our i_size may be stale, the lower file knows where the end is */
+	if (file->f_flags & O_APPEND)
+		pos = i_size_read(ff->passthrough_filp->f_path.dentry->d_inode);
+
+	ret = filemap_write_and_wait_range(mapping, pos, pos + count - 1);
+	if (ret)
+		goto out;
+
+	ret = fuse_passthrough_rw(iocb, iov, nr_segs, pos, WRITE);
+	if (ret > 0) {
+		invalidate_inode_pages2_range(mapping, pos >> PAGE_CACHE_SHIFT,
+				(pos + ret - 1) >> PAGE_CACHE_SHIFT);
+		fuse_write_update_size(inode, pos + ret);
+	}
+	fuse_invalidate_attr(inode);
+out:
+	mutex_unlock(&inode->i_mutex);
+	return ret;
+}
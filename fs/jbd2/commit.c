@@ -173,12 +173,13 @@ static int journal_wait_on_commit_record(journal_t *journal,
  * use writepages() because with dealyed allocation we may be doing
  * block allocation in writepages().
  */
-static int journal_submit_inode_data_buffers(struct address_space *mapping)
+static int journal_submit_inode_data_buffers(struct address_space *mapping,
+		enum writeback_sync_modes sync_mode, long nr_to_write)
 {
 	int ret;
 	struct writeback_control wbc = {
-		.sync_mode =  WB_SYNC_ALL,
-		.nr_to_write = mapping->nrpages * 2,
+		.sync_mode =  sync_mode,
+		.nr_to_write = nr_to_write,
 		.range_start = 0,
 		.range_end = i_size_read(mapping->host),
 	};
@@ -214,7 +215,8 @@ static int journal_submit_data_buffers(journal_t *journal,
 		 * only allocated blocks here.
 		 */
 		trace_jbd2_submit_inode_data(jinode->i_vfs_inode);
-		err = journal_submit_inode_data_buffers(mapping);
+		err = journal_submit_inode_data_buffers(mapping, WB_SYNC_ALL,
+							mapping->nrpages * 2);
 		if (!ret)
 			ret = err;
 		spin_lock(&journal->j_list_lock);
@@ -227,6 +229,55 @@ static int journal_submit_data_buffers(journal_t *journal,
 	return ret;
 }
 
+/*
+ * Start writing out the ordered data of the running transaction while
+ * the commit record of the committing one is in flight, so that its own
+ * commit finds less of it left to flush.  Nothing waits for this I/O
+ * here; we stop as soon as the commit record has made it to disk.
+ *
+ * Each inode gets at most JBD2_PRESUBMIT_PAGES pages per pass, so that
+ * one large file cannot keep us busy long after the commit block has
+ * completed; the commit block is rechecked between inodes.
+ *
+ * New inodes can be added to the running transaction's list under us,
+ * but one is only ever removed with JI_COMMIT_RUNNING clear, so the
+ * inode we are writing out stays on the list.
+ */
+#define JBD2_PRESUBMIT_PAGES	256
+
+static void journal_presubmit_data_buffers(journal_t *journal,
+		struct buffer_head *cbh)
+{
+	transaction_t *transaction;
+	struct jbd2_inode *jinode;
+	struct address_space *mapping;
+
+	read_lock(&journal->j_state_lock);
+	transaction = journal->j_running_transaction;
+	read_unlock(&journal->j_state_lock);
+	if (!transaction)
+		return;
+
+	spin_lock(&journal->j_list_lock);
+	list_for_each_entry(jinode, &transaction->t_inode_list, i_list) {
+		if (!buffer_locked(cbh))
+			break;
+		mapping = jinode->i_vfs_inode->i_mapping;
+		if (!mapping_tagged(mapping, PAGECACHE_TAG_DIRTY))
+			continue;
+		set_bit(__JI_COMMIT_RUNNING, &jinode->i_flags);
+		spin_unlock(&journal->j_list_lock);
+		trace_jbd2_submit_inode_data(jinode->i_vfs_inode);
+		journal_submit_inode_data_buffers(mapping, WB_SYNC_NONE,
+						  JBD2_PRESUBMIT_PAGES);
+		spin_lock(&journal->j_list_lock);
+		clear_bit(__JI_COMMIT_RUNNING, &jinode->i_flags);
+		smp_mb__after_clear_bit();
+		wake_up_bit(&jinode->i_flags, __JI_COMMIT_RUNNING);
+	}
+	spin_unlock(&journal->j_list_lock);
+}
+
 /*
  * Wait for data submitted for writeout, refile inodes to proper
  * transaction if needed.
@@ -294,6 +345,25 @@ static __u32 jbd2_checksum_data(__u32 crc32_sum, struct buffer_head *bh)
 	return checksum;
 }
 
+/*
+ * Account the time since *@start to a commit phase and start the next
+ * one.
+ */
+static inline void jbd2_phase_end(ktime_t *start, u64 *phase_ns)
+{
+	ktime_t now = ktime_get();
+
+	*phase_ns = ktime_to_ns(ktime_sub(now, *start));
+	*start = now;
+}
+
+static void jbd2_hist_add(unsigned long *hist, u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+
+	hist[min(us ? fls64(us) : 0, JBD2_HIST_BUCKETS - 1)]++;
+}
+
 static void write_tag_block(int tag_bytes, journal_block_tag_t *tag,
 				   unsigned long long block)
 {
@@ -318,8 +388,8 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	int flags;
 	int err;
 	unsigned long long blocknr;
-	ktime_t start_time;
-	u64 commit_time;
+	ktime_t start_time, phase_start;
+	u64 commit_time, phase_ns[JBD2_NR_PHASES];
 	char *tagp = NULL;
 	journal_header_t *header;
 	journal_block_tag_t *tag = NULL;
@@ -356,10 +426,23 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 			commit_transaction->t_tid);
 
 	write_lock(&journal->j_state_lock);
+	/*
+	 * A fast commit logs against the running transaction; let it
+	 * finish, after which its blocks are only needed until this
+	 * commit is on disk and the area can be reused.
+	 */
+	while (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+		write_unlock(&journal->j_state_lock);
+		wait_event(journal->j_wait_fc, !(journal->j_flags &
+					JBD2_FAST_COMMIT_ONGOING));
+		write_lock(&journal->j_state_lock);
+	}
+	journal->j_fc_off = 0;
 	commit_transaction->t_state = T_LOCKED;
 
 	trace_jbd2_commit_locking(journal, commit_transaction);
 	stats.run.rs_wait = commit_transaction->t_max_wait;
+	phase_start = ktime_get();
 	stats.run.rs_locked = jiffies;
 	stats.run.rs_running = jbd2_time_diff(commit_transaction->t_start,
 					      stats.run.rs_locked);
@@ -435,6 +518,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	jbd2_journal_switch_revoke_table(journal);
 
 	trace_jbd2_commit_flushing(journal, commit_transaction);
+	jbd2_phase_end(&phase_start, &phase_ns[JBD2_PHASE_LOCKED]);
 	stats.run.rs_flushing = jiffies;
 	stats.run.rs_locked = jbd2_time_diff(stats.run.rs_locked,
 					     stats.run.rs_flushing);
@@ -474,6 +558,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	write_unlock(&journal->j_state_lock);
 
 	trace_jbd2_commit_logging(journal, commit_transaction);
+	jbd2_phase_end(&phase_start, &phase_ns[JBD2_PHASE_FLUSHING]);
 	stats.run.rs_logging = jiffies;
 	stats.run.rs_flushing = jbd2_time_diff(stats.run.rs_flushing,
 					       stats.run.rs_logging);
@@ -807,6 +892,12 @@ wait_for_iobuf:
 	commit_transaction->t_state = T_COMMIT_JFLUSH;
 	write_unlock(&journal->j_state_lock);
 
+	trace_jbd2_commit_record(journal, commit_transaction);
+	jbd2_phase_end(&phase_start, &phase_ns[JBD2_PHASE_LOGGING]);
+	stats.run.rs_committing = jiffies;
+	stats.run.rs_logging = jbd2_time_diff(stats.run.rs_logging,
+					      stats.run.rs_committing);
+
 	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
 				       JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
 		err = journal_submit_commit_record(journal, commit_transaction,
@@ -814,8 +905,15 @@ wait_for_iobuf:
 		if (err)
 			__jbd2_journal_abort_hard(journal);
 	}
-	if (cbh)
+	if (cbh) {
+		/*
+		 * The next transaction is already taking handles; get its
+		 * ordered data moving while we wait for the commit record.
+		 */
+		if (!is_journal_aborted(journal))
+			journal_presubmit_data_buffers(journal, cbh);
 		err = journal_wait_on_commit_record(journal, cbh);
+	}
 	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
 				      JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT) &&
 	    journal->j_flags & JBD2_BARRIER) {
@@ -969,8 +1067,12 @@ restart_loop:
 	J_ASSERT(commit_transaction->t_state == T_COMMIT_JFLUSH);
 
 	commit_transaction->t_start = jiffies;
-	stats.run.rs_logging = jbd2_time_diff(stats.run.rs_logging,
-					      commit_transaction->t_start);
+	stats.run.rs_committing = jbd2_time_diff(stats.run.rs_committing,
+						 commit_transaction->t_start);
+	jbd2_phase_end(&phase_start, &phase_ns[JBD2_PHASE_COMMITTING]);
+	phase_ns[JBD2_PHASE_TOTAL] = phase_ns[JBD2_PHASE_LOCKED] +
+		phase_ns[JBD2_PHASE_FLUSHING] + phase_ns[JBD2_PHASE_LOGGING] +
+		phase_ns[JBD2_PHASE_COMMITTING];
 
 	/*
 	 * File the transaction statistics
@@ -980,6 +1082,8 @@ restart_loop:
 		atomic_read(&commit_transaction->t_handle_count);
 	trace_jbd2_run_stats(journal->j_fs_dev->bd_dev,
 			     commit_transaction->t_tid, &stats.run);
+	trace_jbd2_commit_phases(journal->j_fs_dev->bd_dev,
+				 commit_transaction->t_tid, phase_ns);
 
 	/*
 	 * Calculate overall stats
@@ -991,9 +1095,12 @@ restart_loop:
 	journal->j_stats.run.rs_locked += stats.run.rs_locked;
 	journal->j_stats.run.rs_flushing += stats.run.rs_flushing;
 	journal->j_stats.run.rs_logging += stats.run.rs_logging;
+	journal->j_stats.run.rs_committing += stats.run.rs_committing;
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	for (i = 0; i < JBD2_NR_PHASES; i++)
+		jbd2_hist_add(journal->j_commit_hist[i], phase_ns[i]);
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
@@ -42,6 +42,7 @@
 #include <linux/log2.h>
 #include <linux/vmalloc.h>
 #include <linux/backing-dev.h>
+#include <linux/blkdev.h>
 #include <linux/bitops.h>
 #include <linux/ratelimit.h>
 
@@ -83,6 +84,9 @@ EXPORT_SYMBOL(jbd2_journal_ack_err);
 EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
 EXPORT_SYMBOL(jbd2_log_start_commit);
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+EXPORT_SYMBOL(jbd2_fc_write);
+EXPORT_SYMBOL(jbd2_fc_end_commit);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
 EXPORT_SYMBOL(jbd2_journal_wipe);
@@ -662,6 +666,167 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 	return err;
 }
 
+/*
+ * Fast commits let a client make a small, self-contained change durable
+ * without committing the running transaction: it logs a block of its
+ * own data in the fast commit area at the end of the journal, and
+ * recovery hands those blocks back to it after replaying the last
+ * committed transaction.  The area is reused once the running
+ * transaction commits.
+ */
+
+/**
+ * int jbd2_fc_begin_commit() - start a fast commit of a running transaction
+ * @journal: Journal to act on.
+ * @tid: Transaction holding the changes the client wants to make durable.
+ *
+ * Waits for any other fast commit and for the committing transaction, so
+ * that recovery finds the fast commit blocks right after the last
+ * committed transaction.  Returns 0 if the caller may now log fast commit
+ * blocks for @tid, and must then call jbd2_fc_end_commit().  Any error
+ * means the caller has to commit @tid in full instead.
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	tid_t commit_tid;
+
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return -EOPNOTSUPP;
+
+	write_lock(&journal->j_state_lock);
+	while (1) {
+		if (is_journal_aborted(journal)) {
+			write_unlock(&journal->j_state_lock);
+			return -EIO;
+		}
+		transaction = journal->j_running_transaction;
+		if (!transaction || transaction->t_tid != tid ||
+		    transaction->t_state != T_RUNNING ||
+		    journal->j_fc_off >=
+		    journal->j_fc_last - journal->j_fc_first) {
+			write_unlock(&journal->j_state_lock);
+			return -EAGAIN;
+		}
+		if (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+			write_unlock(&journal->j_state_lock);
+			wait_event(journal->j_wait_fc, !(journal->j_flags &
+						JBD2_FAST_COMMIT_ONGOING));
+			write_lock(&journal->j_state_lock);
+			continue;
+		}
+		if (journal->j_committing_transaction) {
+			commit_tid = journal->j_committing_transaction->t_tid;
+			write_unlock(&journal->j_state_lock);
+			jbd2_log_wait_commit(journal, commit_tid);
+			write_lock(&journal->j_state_lock);
+			continue;
+		}
+		break;
+	}
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	journal->j_fc_tid = tid;
+	journal->j_fc_start = ktime_get();
+	write_unlock(&journal->j_state_lock);
+
+	/*
+	 * Recovery only runs if the superblock says the log is in use, so
+	 * erase the effects of a prior flush just as a commit would.
+	 */
+	if (journal->j_flags & JBD2_FLUSHED)
+		jbd2_journal_update_superblock(journal, 1);
+	return 0;
+}
+
+/**
+ * int jbd2_fc_write() - log a fast commit block
+ * @journal: Journal to act on.
+ * @data: Client data to log.
+ * @len: Length of @data, at most a block less the fast commit header.
+ *
+ * Writes @data to the next block of the fast commit area and waits for
+ * it to reach stable storage, flushing the filesystem device first so
+ * that the file data the client's change refers to is durable before
+ * it.  Returns -ENOSPC once the area is full.
+ */
+int jbd2_fc_write(journal_t *journal, void *data, int len)
+{
+	jbd2_fc_header_t *fh;
+	struct buffer_head *bh;
+	unsigned long long blocknr;
+	int flags = WRITE_SYNC;
+	int err;
+
+	J_ASSERT(journal->j_flags & JBD2_FAST_COMMIT_ONGOING);
+	if (len > journal->j_blocksize - sizeof(jbd2_fc_header_t))
+		return -EINVAL;
+	if (journal->j_fc_off >= journal->j_fc_last - journal->j_fc_first)
+		return -ENOSPC;
+
+	err = jbd2_journal_bmap(journal,
+				journal->j_fc_first + journal->j_fc_off,
+				&blocknr);
+	if (err)
+		return err;
+	bh = __getblk(journal->j_dev, blocknr, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+
+	lock_buffer(bh);
+	memset(bh->b_data, 0, journal->j_blocksize);
+	fh = (jbd2_fc_header_t *)bh->b_data;
+	fh->fc_header.h_magic = cpu_to_be32(JBD2_MAGIC_NUMBER);
+	fh->fc_header.h_blocktype = cpu_to_be32(JBD2_FC_BLOCK);
+	fh->fc_header.h_sequence = cpu_to_be32(journal->j_fc_tid);
+	fh->fc_index = cpu_to_be32(journal->j_fc_off);
+	fh->fc_len = cpu_to_be32(len);
+	memcpy(fh + 1, data, len);
+	fh->fc_chksum = cpu_to_be32(jbd2_fc_chksum(fh));
+
+	if (journal->j_flags & JBD2_BARRIER) {
+		if (journal->j_fs_dev != journal->j_dev)
+			blkdev_issue_flush(journal->j_fs_dev, GFP_NOFS, NULL);
+		flags = WRITE_SYNC | WRITE_FLUSH_FUA;
+	}
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	get_bh(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	submit_bh(flags, bh);
+	wait_on_buffer(bh);
+	if (!buffer_uptodate(bh))
+		err = -EIO;
+	brelse(bh);
+	if (err)
+		return err;
+
+	write_lock(&journal->j_state_lock);
+	journal->j_fc_off++;
+	write_unlock(&journal->j_state_lock);
+
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_fc++;
+	journal->j_stats.ts_fc_time +=
+		ktime_to_ns(ktime_sub(ktime_get(), journal->j_fc_start));
+	spin_unlock(&journal->j_history_lock);
+	return 0;
+}
+
+/**
+ * void jbd2_fc_end_commit() - finish a fast commit
+ * @journal: Journal to act on.
+ *
+ * Lets the next fast commit, or a full commit, proceed.
+ */
+void jbd2_fc_end_commit(journal_t *journal)
+{
+	write_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_wait_fc);
+}
+
 /*
  * Log buffer allocation routines:
  */
@@ -770,6 +935,11 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	seq_printf(seq, "%lu transaction, each up to %u blocks\n",
 			s->stats->ts_tid,
 			s->journal->j_max_transaction_buffers);
+	if (s->stats->ts_fc)
+		seq_printf(seq, "%lu fast commits, %lluus average fast "
+			   "commit time\n", s->stats->ts_fc,
+			   div64_u64(s->stats->ts_fc_time,
+				     (u64)s->stats->ts_fc * NSEC_PER_USEC));
 	if (s->stats->ts_tid == 0)
 		return 0;
 	seq_printf(seq, "average: \n  %ums waiting for transaction\n",
@@ -782,6 +952,8 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    jiffies_to_msecs(s->stats->run.rs_flushing / s->stats->ts_tid));
 	seq_printf(seq, "  %ums logging transaction\n",
 	    jiffies_to_msecs(s->stats->run.rs_logging / s->stats->ts_tid));
+	seq_printf(seq, "  %ums writing commit record\n",
+	    jiffies_to_msecs(s->stats->run.rs_committing / s->stats->ts_tid));
 	seq_printf(seq, "  %lluus average transaction commit time\n",
 		   div_u64(s->journal->j_average_commit_time, 1000));
 	seq_printf(seq, "  %lu handles per transaction\n",
@@ -853,6 +1025,51 @@ static const struct file_operations jbd2_seq_info_fops = {
 	.release        = jbd2_seq_info_release,
 };
 
+/*
+ * commit_hist: one row per latency bucket, one column per commit phase.
+ * Row "<N" counts phases that took less than N microseconds.
+ */
+static int jbd2_seq_hist_show(struct seq_file *seq, void *v)
+{
+	journal_t *journal = seq->private;
+	unsigned long (*hist)[JBD2_HIST_BUCKETS];
+	int i, n;
+
+	hist = kmalloc(sizeof(journal->j_commit_hist), GFP_KERNEL);
+	if (!hist)
+		return -ENOMEM;
+	spin_lock(&journal->j_history_lock);
+	memcpy(hist, journal->j_commit_hist, sizeof(journal->j_commit_hist));
+	spin_unlock(&journal->j_history_lock);
+
+	seq_printf(seq, "%-12s %10s %10s %10s %10s %10s\n", "usecs",
+		   "locked", "flushing", "logging", "committing", "total");
+	for (n = 0; n < JBD2_HIST_BUCKETS; n++) {
+		if (n < JBD2_HIST_BUCKETS - 1)
+			seq_printf(seq, "<%-11lu", 1UL << n);
+		else
+			seq_printf(seq, ">=%-10lu", 1UL << (n - 1));
+		for (i = 0; i < JBD2_NR_PHASES; i++)
+			seq_printf(seq, " %10lu", hist[i][n]);
+		seq_putc(seq, '\n');
+	}
+	kfree(hist);
+	return 0;
+}
+
+static int jbd2_seq_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, jbd2_seq_hist_show, PDE(inode)->data);
+}
+
+static const struct file_operations jbd2_seq_hist_fops = {
+	.owner		= THIS_MODULE,
+	.open		= jbd2_seq_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct proc_dir_entry *proc_jbd2_stats;
 
 static void jbd2_stats_proc_init(journal_t *journal)
@@ -861,11 +1078,14 @@ static void jbd2_stats_proc_init(journal_t *journal)
 	if (journal->j_proc_entry) {
 		proc_create_data("info", S_IRUGO, journal->j_proc_entry,
 				 &jbd2_seq_info_fops, journal);
+		proc_create_data("commit_hist", S_IRUGO, journal->j_proc_entry,
+				 &jbd2_seq_hist_fops, journal);
 	}
 }
 
 static void jbd2_stats_proc_exit(journal_t *journal)
 {
+	remove_proc_entry("commit_hist", journal->j_proc_entry);
 	remove_proc_entry("info", journal->j_proc_entry);
 	remove_proc_entry(journal->j_devname, proc_jbd2_stats);
 }
@@ -894,6 +1114,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_checkpoint);
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
+	init_waitqueue_head(&journal->j_wait_fc);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
@@ -1078,6 +1299,18 @@ static void journal_fail_superblock (journal_t *journal)
 	journal->j_sb_buffer = NULL;
 }
 
+/*
+ * With the FAST_COMMIT feature the last JBD2_FC_BLOCKS blocks of the
+ * journal hold fast commits, and the log itself wraps before them.
+ */
+static void jbd2_fc_setup(journal_t *journal)
+{
+	journal->j_fc_last = journal->j_last;
+	journal->j_last -= JBD2_FC_BLOCKS;
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_off = 0;
+}
+
 /*
  * Given a journal_t structure, initialise the various fields for
  * startup of a new journaling session.  We use this both when creating
@@ -1101,10 +1334,13 @@ static int journal_reset(journal_t *journal)
 
 	journal->j_first = first;
 	journal->j_last = last;
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		jbd2_fc_setup(journal);
 
 	journal->j_head = first;
 	journal->j_tail = first;
-	journal->j_free = last - first;
+	journal->j_free = journal->j_last - first;
 
 	journal->j_tail_sequence = journal->j_transaction_sequence;
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
@@ -1288,6 +1524,17 @@ static int load_superblock(journal_t *journal)
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT)) {
+		if (journal->j_last - journal->j_first <
+		    JBD2_MIN_JOURNAL_BLOCKS + JBD2_FC_BLOCKS) {
+			printk(KERN_WARNING
+			       "JBD2: journal too short for fast commits\n");
+			return -EINVAL;
+		}
+		jbd2_fc_setup(journal);
+	}
+
 	return 0;
 }
 
@@ -1487,6 +1734,41 @@ int jbd2_journal_check_available_features (journal_t *journal, unsigned long com
 	return 0;
 }
 
+/*
+ * The fast commit area can only be added to or removed from the end of a
+ * loaded journal while nothing has been logged since it was reset, as
+ * otherwise recovery could not tell where the log wraps.
+ */
+static int jbd2_fc_resize(journal_t *journal, int enable)
+{
+	int err = 0;
+
+	if (!(journal->j_flags & JBD2_LOADED))
+		return -EINVAL;
+
+	write_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction ||
+	    journal->j_committing_transaction ||
+	    journal->j_checkpoint_transactions ||
+	    journal->j_head != journal->j_first ||
+	    journal->j_tail != journal->j_first) {
+		err = -EBUSY;
+	} else if (enable) {
+		if (journal->j_last - journal->j_first <
+		    JBD2_MIN_JOURNAL_BLOCKS + JBD2_FC_BLOCKS)
+			err = -ENOSPC;
+		else
+			jbd2_fc_setup(journal);
+	} else {
+		journal->j_last = journal->j_fc_last;
+		journal->j_fc_first = journal->j_fc_last = 0;
+	}
+	if (!err)
+		journal->j_free = journal->j_last - journal->j_first;
+	write_unlock(&journal->j_state_lock);
+	return err;
+}
+
 /**
  * int jbd2_journal_set_features () - Mark a given journal feature in the superblock
  * @journal: Journal to act on.
@@ -1503,6 +1785,7 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 			  unsigned long ro, unsigned long incompat)
 {
 	journal_superblock_t *sb;
+	int fast_commit = 0;
 
 	if (jbd2_journal_check_used_features(journal, compat, ro, incompat))
 		return 1;
@@ -1510,6 +1793,14 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 	if (!jbd2_journal_check_available_features(journal, compat, ro, incompat))
 		return 0;
 
+	if ((incompat & JBD2_FEATURE_INCOMPAT_FAST_COMMIT) &&
+	    !JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT)) {
+		if (jbd2_fc_resize(journal, 1))
+			return 0;
+		fast_commit = 1;
+	}
+
 	jbd_debug(1, "Setting new features 0x%lx/0x%lx/0x%lx\n",
 		  compat, ro, incompat);
 
@@ -1519,6 +1810,10 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 	sb->s_feature_ro_compat |= cpu_to_be32(ro);
 	sb->s_feature_incompat  |= cpu_to_be32(incompat);
 
+	/* Recovery must know where the log ends before anything is logged */
+	if (fast_commit)
+		jbd2_journal_update_superblock(journal, 1);
+
 	return 1;
 }
 
@@ -1537,6 +1832,18 @@ void jbd2_journal_clear_features(journal_t *journal, unsigned long compat,
 				unsigned long ro, unsigned long incompat)
 {
 	journal_superblock_t *sb;
+	int fast_commit = 0;
+
+	if ((incompat & JBD2_FEATURE_INCOMPAT_FAST_COMMIT) &&
+	    JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT)) {
+		if (jbd2_fc_resize(journal, 0)) {
+			printk(KERN_WARNING "JBD2: cannot clear fast commit "
+			       "feature on %s\n", journal->j_devname);
+			incompat &= ~JBD2_FEATURE_INCOMPAT_FAST_COMMIT;
+		} else
+			fast_commit = 1;
+	}
 
 	jbd_debug(1, "Clear features 0x%lx/0x%lx/0x%lx\n",
 		  compat, ro, incompat);
@@ -1546,6 +1853,9 @@ void jbd2_journal_clear_features(journal_t *journal, unsigned long compat,
 	sb->s_feature_compat    &= ~cpu_to_be32(compat);
 	sb->s_feature_ro_compat &= ~cpu_to_be32(ro);
 	sb->s_feature_incompat  &= ~cpu_to_be32(incompat);
+
+	if (fast_commit)
+		jbd2_journal_update_superblock(journal, 1);
 }
 EXPORT_SYMBOL(jbd2_journal_clear_features);
 
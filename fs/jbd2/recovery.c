@@ -42,6 +42,7 @@ static int do_one_pass(journal_t *journal,
 				struct recovery_info *info, enum passtype pass);
 static int scan_revoke_records(journal_t *, struct buffer_head *,
 				tid_t, struct recovery_info *);
+static int fc_do_replay(journal_t *journal, tid_t tid);
 
 #ifdef __KERNEL__
 
@@ -250,6 +251,9 @@ int jbd2_journal_recover(journal_t *journal)
 		err = do_one_pass(journal, &info, PASS_REVOKE);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REPLAY);
+	if (!err && JBD2_HAS_INCOMPAT_FEATURE(journal,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		err = fc_do_replay(journal, info.end_transaction);
 
 	jbd_debug(1, "JBD: recovery, exit status %d, "
 		  "recovered transactions %u to %u\n",
@@ -310,6 +314,64 @@ int jbd2_journal_skip_recovery(journal_t *journal)
 	return err;
 }
 
+/*
+ * Checksum of a fast commit block: the header up to the checksum itself,
+ * then the client data.
+ */
+__u32 jbd2_fc_chksum(jbd2_fc_header_t *fh)
+{
+	__u32 crc32_sum;
+
+	crc32_sum = crc32_be(~0, (void *)fh,
+			     offsetof(jbd2_fc_header_t, fc_chksum));
+	return crc32_be(crc32_sum, (void *)(fh + 1),
+			be32_to_cpu(fh->fc_len));
+}
+
+/*
+ * Fast commit blocks belong to the transaction after the last one that
+ * committed, and are written in order from the start of the fast commit
+ * area.  Hand each one to the client until we reach a block that was not
+ * written for this transaction, or not completely.
+ */
+static int fc_do_replay(journal_t *journal, tid_t tid)
+{
+	struct buffer_head *bh;
+	jbd2_fc_header_t *fh;
+	unsigned int off, len;
+	int err = 0;
+
+	if (!journal->j_fc_replay_callback)
+		return 0;
+
+	for (off = 0; off < journal->j_fc_last - journal->j_fc_first; off++) {
+		err = jread(&bh, journal, journal->j_fc_first + off);
+		if (err)
+			break;
+
+		fh = (jbd2_fc_header_t *)bh->b_data;
+		len = be32_to_cpu(fh->fc_len);
+		if (fh->fc_header.h_magic != cpu_to_be32(JBD2_MAGIC_NUMBER) ||
+		    fh->fc_header.h_blocktype != cpu_to_be32(JBD2_FC_BLOCK) ||
+		    be32_to_cpu(fh->fc_header.h_sequence) != tid ||
+		    be32_to_cpu(fh->fc_index) != off ||
+		    len > journal->j_blocksize - sizeof(jbd2_fc_header_t) ||
+		    be32_to_cpu(fh->fc_chksum) != jbd2_fc_chksum(fh)) {
+			brelse(bh);
+			break;
+		}
+
+		err = journal->j_fc_replay_callback(journal, fh + 1, len);
+		brelse(bh);
+		if (err)
+			break;
+	}
+
+	jbd_debug(1, "JBD: replayed %u fast commit blocks for transaction %u\n",
+		  off, tid);
+	return err;
+}
+
 static inline unsigned long long read_tag_block(int tag_bytes, journal_block_tag_t *tag)
 {
 	unsigned long long block = be32_to_cpu(tag->t_blocknr);
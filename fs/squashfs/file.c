@@ -47,6 +47,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/vmalloc.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -371,6 +372,87 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Decompress a datablock straight into the page cache pages it covers,
+ * mapped contiguously with vmap(), rather than into the read_page cache
+ * to be copied from there.  Every page of the block other than
+ * target_page has to be grabbed, unlocked and not up to date; if one
+ * isn't, or the pages can't be mapped, -EAGAIN is returned with nothing
+ * read and the caller falls back to the read_page cache.
+ */
+static int squashfs_readpage_direct(struct page *target_page, u64 block,
+	int bsize, int bytes)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int pages = (bytes + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	int i, grabbed = 0, res = -EAGAIN;
+	struct page **page;
+	void **buffer;
+	void *vaddr;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	buffer = kmalloc(pages * sizeof(*buffer), GFP_KERNEL);
+	if (page == NULL || buffer == NULL)
+		goto out;
+
+	for (grabbed = 0; grabbed < pages; grabbed++) {
+		int n = start_index + grabbed;
+
+		page[grabbed] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+		if (page[grabbed] == NULL)
+			goto release_pages;
+		if (PageUptodate(page[grabbed])) {
+			grabbed++;
+			goto release_pages;
+		}
+	}
+
+	vaddr = vmap(page, pages, VM_MAP, PAGE_KERNEL);
+	if (vaddr == NULL)
+		goto release_pages;
+
+	for (i = 0; i < pages; i++)
+		buffer[i] = vaddr + i * PAGE_CACHE_SIZE;
+
+	/*
+	 * Bound the block by the pages we have: the last block of a file
+	 * covers fewer pages than block_size, and a corrupt length must
+	 * not be copied or decompressed past them.
+	 */
+	res = squashfs_read_data(inode->i_sb, buffer, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+	if (res > pages * PAGE_CACHE_SIZE)
+		res = -EIO;
+	if (res >= 0)
+		memset(vaddr + res, 0, pages * PAGE_CACHE_SIZE - res);
+	flush_kernel_vmap_range(vaddr, pages * PAGE_CACHE_SIZE);
+	vunmap(vaddr);
+
+	for (i = 0; i < pages && res >= 0; i++) {
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+	}
+	if (res > 0)
+		res = 0;
+
+release_pages:
+	for (i = 0; i < grabbed; i++) {
+		if (page[i] == target_page)
+			continue;
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+out:
+	kfree(buffer);
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -403,15 +485,28 @@ static int squashfs_readpage(struct file *file, struct page *page)
 		if (bsize < 0)
 			goto error_out;
 
+		bytes = index == file_end ?
+			(i_size_read(inode) & (msblk->block_size - 1)) :
+			 msblk->block_size;
+
 		if (bsize == 0) { /* hole */
-			bytes = index == file_end ?
-				(i_size_read(inode) & (msblk->block_size - 1)) :
-				 msblk->block_size;
 			sparse = 1;
 		} else {
 			/*
-			 * Read and decompress datablock.
+			 * Read and decompress datablock, straight into the
+			 * page cache if we can.
 			 */
+			int res = squashfs_readpage_direct(page, block, bsize,
+				bytes);
+			if (res == 0) {
+				unlock_page(page);
+				return 0;
+			} else if (res != -EAGAIN) {
+				ERROR("Unable to read page, block %llx, size %x"
+					"\n", block, bsize);
+				goto error_out;
+			}
+
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
 			if (buffer->error) {
@@ -34,11 +34,16 @@
 #include "yaffs_allocator.h"
 
 #include "yaffs_attribs.h"
+#include "yaffs_summary.h"
 
-/* Note YAFFS_GC_GOOD_ENOUGH must be <= YAFFS_GC_PASSIVE_THRESHOLD */
-#define YAFFS_GC_GOOD_ENOUGH 2
 #define YAFFS_GC_PASSIVE_THRESHOLD 4
 
+/* Block age, in blocks allocated since, beyond which all blocks look old */
+#define YAFFS_GC_MAX_AGE 4096
+
+/* Most blocks collected by one urgent background gc call */
+#define YAFFS_BG_GC_MAX_BLOCKS 4
+
 #include "yaffs_ecc.h"
 
 /* Forward declarations */
@@ -477,6 +482,7 @@ static int yaffs_alloc_chunk(struct yaffs_dev *dev, int use_reserver,
 		/* If the block is full set the state to full */
 		if (dev->alloc_page >= dev->param.chunks_per_block) {
 			bi->block_state = YAFFS_BLOCK_STATE_FULL;
+			yaffs_gc_index_update(dev, dev->alloc_block);
 			dev->alloc_block = -1;
 		}
 
@@ -515,6 +521,7 @@ void yaffs_skip_rest_of_block(struct yaffs_dev *dev)
 		    yaffs_get_block_info(dev, dev->alloc_block);
 		if (bi->block_state == YAFFS_BLOCK_STATE_ALLOCATING) {
 			bi->block_state = YAFFS_BLOCK_STATE_FULL;
+			yaffs_gc_index_update(dev, dev->alloc_block);
 			dev->alloc_block = -1;
 		}
 	}
@@ -609,6 +616,8 @@ static int yaffs_write_new_chunk(struct yaffs_dev *dev,
 
 	if (!write_ok)
 		chunk = -1;
+	else
+		yaffs_summary_add(dev, tags, chunk);
 
 	if (attempts > 1) {
 		yaffs_trace(YAFFS_TRACE_ERROR,
@@ -662,6 +671,7 @@ static void yaffs_retire_block(struct yaffs_dev *dev, int flash_block)
 	bi->block_state = YAFFS_BLOCK_STATE_DEAD;
 	bi->gc_prioritise = 0;
 	bi->needs_retiring = 0;
+	yaffs_gc_index_update(dev, flash_block);
 
 	dev->n_retired_blocks++;
 }
@@ -1201,6 +1211,7 @@ static void yaffs_soft_del_chunk(struct yaffs_dev *dev, int chunk)
 		the_block->soft_del_pages++;
 		dev->n_free_chunks++;
 		yaffs2_update_oldest_dirty_seq(dev, block_no, the_block);
+		yaffs_gc_index_update(dev, block_no);
 	}
 }
 
@@ -2298,6 +2309,99 @@ struct yaffs_obj *yaffs_link_obj(struct yaffs_obj *parent, const YCHAR * name,
 
 /*------------------------- Block Management and Page Allocation ----------------*/
 
+/*
+ * GC victim index.
+ * Every FULL block with at least one chunk not in use sits in the bucket
+ * for its number of chunks in use, so the victim search only looks at
+ * blocks worth collecting, emptiest first.
+ */
+
+static inline struct yaffs_gc_index_entry *yaffs_gc_index_entry(struct
+								yaffs_dev
+								*dev, int blk)
+{
+	return &dev->gc_index[blk - dev->internal_start_block];
+}
+
+static void yaffs_gc_index_unlink(struct yaffs_dev *dev, int blk)
+{
+	struct yaffs_gc_index_entry *e = yaffs_gc_index_entry(dev, blk);
+
+	if (e->prev >= 0)
+		yaffs_gc_index_entry(dev, e->prev)->next = e->next;
+	else
+		dev->gc_bucket_head[e->bucket] = e->next;
+
+	if (e->next >= 0)
+		yaffs_gc_index_entry(dev, e->next)->prev = e->prev;
+	else
+		dev->gc_bucket_tail[e->bucket] = e->prev;
+
+	e->bucket = -1;
+}
+
+static void yaffs_gc_index_link(struct yaffs_dev *dev, int blk, int bucket)
+{
+	struct yaffs_gc_index_entry *e = yaffs_gc_index_entry(dev, blk);
+
+	/* Add at the tail so the head tends to hold the longest waiting */
+	e->bucket = bucket;
+	e->next = -1;
+	e->prev = dev->gc_bucket_tail[bucket];
+
+	if (e->prev >= 0)
+		yaffs_gc_index_entry(dev, e->prev)->next = blk;
+	else
+		dev->gc_bucket_head[bucket] = blk;
+	dev->gc_bucket_tail[bucket] = blk;
+}
+
+/*
+ * Re-file a block after its state or number of chunks in use changed.
+ */
+void yaffs_gc_index_update(struct yaffs_dev *dev, int blk)
+{
+	struct yaffs_block_info *bi;
+	struct yaffs_gc_index_entry *e;
+	int pages_used;
+	int bucket = -1;
+
+	if (!dev->gc_index)
+		return;
+
+	bi = yaffs_get_block_info(dev, blk);
+	e = yaffs_gc_index_entry(dev, blk);
+	pages_used = bi->pages_in_use - bi->soft_del_pages;
+
+	if (bi->block_state == YAFFS_BLOCK_STATE_FULL &&
+	    pages_used >= 0 && pages_used < dev->param.chunks_per_block)
+		bucket = pages_used;
+
+	if (bucket == e->bucket)
+		return;
+
+	if (e->bucket >= 0)
+		yaffs_gc_index_unlink(dev, blk);
+	if (bucket >= 0)
+		yaffs_gc_index_link(dev, blk, bucket);
+}
+
+/* Rebuild the whole index, eg. after a scan or checkpoint restore */
+static void yaffs_gc_index_rebuild(struct yaffs_dev *dev)
+{
+	int i;
+
+	for (i = 0; i < dev->param.chunks_per_block; i++) {
+		dev->gc_bucket_head[i] = -1;
+		dev->gc_bucket_tail[i] = -1;
+	}
+
+	for (i = dev->internal_start_block; i <= dev->internal_end_block; i++) {
+		yaffs_gc_index_entry(dev, i)->bucket = -1;
+		yaffs_gc_index_update(dev, i);
+	}
+}
+
 static int yaffs_init_blocks(struct yaffs_dev *dev)
 {
 	int n_blocks = dev->internal_end_block - dev->internal_start_block + 1;
@@ -2333,9 +2437,27 @@ static int yaffs_init_blocks(struct yaffs_dev *dev)
 	}
 
 	if (dev->block_info && dev->chunk_bits) {
+		int index_bytes =
+		    n_blocks * sizeof(struct yaffs_gc_index_entry) +
+		    2 * dev->param.chunks_per_block * sizeof(int);
+
+		dev->gc_index = kmalloc(index_bytes, GFP_NOFS);
+		if (!dev->gc_index) {
+			dev->gc_index = vmalloc(index_bytes);
+			dev->gc_index_alt = 1;
+		} else {
+			dev->gc_index_alt = 0;
+		}
+	}
+
+	if (dev->block_info && dev->chunk_bits && dev->gc_index) {
 		memset(dev->block_info, 0,
 		       n_blocks * sizeof(struct yaffs_block_info));
 		memset(dev->chunk_bits, 0, dev->chunk_bit_stride * n_blocks);
+		dev->gc_bucket_head = (int *)(dev->gc_index + n_blocks);
+		dev->gc_bucket_tail =
+		    dev->gc_bucket_head + dev->param.chunks_per_block;
+		yaffs_gc_index_rebuild(dev);
 		return YAFFS_OK;
 	}
 
@@ -2359,6 +2481,15 @@ static void yaffs_deinit_blocks(struct yaffs_dev *dev)
 		kfree(dev->chunk_bits);
 	dev->chunk_bits_alt = 0;
 	dev->chunk_bits = NULL;
+
+	if (dev->gc_index_alt && dev->gc_index)
+		vfree(dev->gc_index);
+	else if (dev->gc_index)
+		kfree(dev->gc_index);
+	dev->gc_index_alt = 0;
+	dev->gc_index = NULL;
+	dev->gc_bucket_head = NULL;
+	dev->gc_bucket_tail = NULL;
 }
 
 void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no)
@@ -2379,6 +2510,7 @@ void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no)
 	yaffs2_clear_oldest_dirty_seq(dev, bi);
 
 	bi->block_state = YAFFS_BLOCK_STATE_DIRTY;
+	yaffs_gc_index_update(dev, block_no);
 
 	/* If this is the block being garbage collected then stop gc'ing this block */
 	if (block_no == dev->gc_block)
@@ -2468,8 +2600,10 @@ static int yaffs_gc_block(struct yaffs_dev *dev, int block, int whole_block)
 
 	/*yaffs_verify_free_chunks(dev); */
 
-	if (bi->block_state == YAFFS_BLOCK_STATE_FULL)
+	if (bi->block_state == YAFFS_BLOCK_STATE_FULL) {
 		bi->block_state = YAFFS_BLOCK_STATE_COLLECTING;
+		yaffs_gc_index_update(dev, block);
+	}
 
 	bi->has_shrink_hdr = 0;	/* clear the flag so that the block can erase */
 
@@ -2679,6 +2813,7 @@ static int yaffs_gc_block(struct yaffs_dev *dev, int block, int whole_block)
 		 * because checkpointing does not restore gc.
 		 */
 		bi->block_state = YAFFS_BLOCK_STATE_FULL;
+		yaffs_gc_index_update(dev, block);
 	} else {
 		/* The gc completed. */
 		/* Do any required cleanups */
@@ -2715,6 +2850,88 @@ static int yaffs_gc_block(struct yaffs_dev *dev, int block, int whole_block)
 	return ret_val;
 }
 
+/*
+ * Cost-benefit score of collecting a block: the space it frees times how
+ * long its data has stayed put, over the cost of reading the block and
+ * copying what is still in use. Old blocks are unlikely to get any
+ * emptier by waiting, so they are worth collecting with more in use.
+ */
+static u32 yaffs_gc_score(struct yaffs_dev *dev, int pages_used, u32 age)
+{
+	u32 n_free = dev->param.chunks_per_block - pages_used;
+
+	if (age > YAFFS_GC_MAX_AGE)
+		age = YAFFS_GC_MAX_AGE;
+
+	return n_free * (age + 1) * 64 /
+	    (dev->param.chunks_per_block + pages_used);
+}
+
+static u32 yaffs_block_age(struct yaffs_dev *dev, struct yaffs_block_info *bi)
+{
+	if (!dev->param.is_yaffs2 || bi->seq_number > dev->seq_number)
+		return 0;
+
+	return dev->seq_number - bi->seq_number;
+}
+
+/*
+ * Search the gc index for the block with the best cost-benefit score
+ * among those with at most threshold chunks in use, looking at no more
+ * than max_checks blocks. The result is left in gc_dirtiest.
+ */
+static void yaffs_gc_index_find(struct yaffs_dev *dev, int threshold,
+				int max_checks)
+{
+	struct yaffs_block_info *bi;
+	int pages_used;
+	int blk;
+	int next;
+	u32 score;
+	u32 best_score = 0;
+
+	dev->gc_dirtiest = 0;
+	dev->gc_pages_in_use = 0;
+
+	if (threshold >= dev->param.chunks_per_block)
+		threshold = dev->param.chunks_per_block - 1;
+
+	for (pages_used = 0; pages_used <= threshold && max_checks > 0;
+	     pages_used++) {
+		/* Nothing fuller can beat the best so far, even if ancient */
+		if (dev->gc_dirtiest > 0 &&
+		    yaffs_gc_score(dev, pages_used, YAFFS_GC_MAX_AGE) <=
+		    best_score)
+			break;
+
+		for (blk = dev->gc_bucket_head[pages_used];
+		     blk >= 0 && max_checks > 0; blk = next) {
+			next = yaffs_gc_index_entry(dev, blk)->next;
+			max_checks--;
+
+			bi = yaffs_get_block_info(dev, blk);
+			if (bi->block_state != YAFFS_BLOCK_STATE_FULL ||
+			    bi->pages_in_use - bi->soft_del_pages !=
+			    pages_used) {
+				/* Missed an update, put it right */
+				yaffs_gc_index_update(dev, blk);
+				continue;
+			}
+
+			if (!yaffs_block_ok_for_gc(dev, bi))
+				continue;
+
+			score = yaffs_gc_score(dev, pages_used,
+					       yaffs_block_age(dev, bi));
+			if (dev->gc_dirtiest < 1 || score > best_score) {
+				dev->gc_dirtiest = blk;
+				dev->gc_pages_in_use = pages_used;
+				best_score = score;
+			}
+		}
+	}
+}
+
 /*
  * FindBlockForgarbageCollection is used to select the dirtiest block (or close enough)
  * for garbage collection.
@@ -2770,7 +2987,6 @@ static unsigned yaffs_find_gc_block(struct yaffs_dev *dev,
 	 */
 
 	if (!selected) {
-		int pages_used;
 		int n_blocks =
 		    dev->internal_end_block - dev->internal_start_block + 1;
 		if (aggressive) {
@@ -2787,7 +3003,13 @@ static unsigned yaffs_find_gc_block(struct yaffs_dev *dev,
 			if (max_threshold < YAFFS_GC_PASSIVE_THRESHOLD)
 				max_threshold = YAFFS_GC_PASSIVE_THRESHOLD;
 
-			threshold = background ? (dev->gc_not_done + 2) * 2 : 0;
+			/* Urgent background gc takes what it can get */
+			if (background > 1)
+				threshold = max_threshold;
+			else if (background)
+				threshold = (dev->gc_not_done + 2) * 2;
+			else
+				threshold = 0;
 			if (threshold < YAFFS_GC_PASSIVE_THRESHOLD)
 				threshold = YAFFS_GC_PASSIVE_THRESHOLD;
 			if (threshold > max_threshold)
@@ -2798,29 +3020,7 @@ static unsigned yaffs_find_gc_block(struct yaffs_dev *dev,
 				iterations = 100;
 		}
 
-		for (i = 0;
-		     i < iterations &&
-		     (dev->gc_dirtiest < 1 ||
-		      dev->gc_pages_in_use > YAFFS_GC_GOOD_ENOUGH); i++) {
-			dev->gc_block_finder++;
-			if (dev->gc_block_finder < dev->internal_start_block ||
-			    dev->gc_block_finder > dev->internal_end_block)
-				dev->gc_block_finder =
-				    dev->internal_start_block;
-
-			bi = yaffs_get_block_info(dev, dev->gc_block_finder);
-
-			pages_used = bi->pages_in_use - bi->soft_del_pages;
-
-			if (bi->block_state == YAFFS_BLOCK_STATE_FULL &&
-			    pages_used < dev->param.chunks_per_block &&
-			    (dev->gc_dirtiest < 1
-			     || pages_used < dev->gc_pages_in_use)
-			    && yaffs_block_ok_for_gc(dev, bi)) {
-				dev->gc_dirtiest = dev->gc_block_finder;
-				dev->gc_pages_in_use = pages_used;
-			}
-		}
+		yaffs_gc_index_find(dev, threshold, iterations);
 
 		if (dev->gc_dirtiest > 0 && dev->gc_pages_in_use <= threshold)
 			selected = dev->gc_dirtiest;
@@ -2865,8 +3065,8 @@ static unsigned yaffs_find_gc_block(struct yaffs_dev *dev,
 	} else {
 		dev->gc_not_done++;
 		yaffs_trace(YAFFS_TRACE_GC,
-			"GC none: finder %d skip %d threshold %d dirtiest %d using %d oldest %d%s",
-			dev->gc_block_finder, dev->gc_not_done, threshold,
+			"GC none: skip %d threshold %d dirtiest %d using %d oldest %d%s",
+			dev->gc_not_done, threshold,
 			dev->gc_dirtiest, dev->gc_pages_in_use,
 			dev->oldest_dirty_block, background ? " bg" : "");
 	}
@@ -2882,7 +3082,26 @@ static unsigned yaffs_find_gc_block(struct yaffs_dev *dev,
  *
  * The idea is to help clear out space in a more spread-out manner.
  * Dunno if it really does anything useful.
+ *
+ * background is 0 for gc done on behalf of a writer, 1 for background gc
+ * and 2 for background gc that should collect whole blocks because the
+ * erased block reserve is running low.
  */
+static void yaffs_gc_account(struct yaffs_dev *dev, int background,
+			     ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	if (background) {
+		dev->gc_bg_time_us += us;
+	} else {
+		dev->fg_gcs++;
+		dev->gc_fg_time_us += us;
+		if (us > dev->gc_fg_max_us)
+			dev->gc_fg_max_us = us;
+	}
+}
+
 static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 {
 	int aggressive = 0;
@@ -2891,6 +3110,7 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 	int min_erased;
 	int erased_chunks;
 	int checkpt_block_adjust;
+	ktime_t start;
 
 	if (dev->param.gc_control && (dev->param.gc_control(dev) & 1) == 0)
 		return YAFFS_OK;
@@ -2922,6 +3142,12 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 			    && erased_chunks > (dev->n_free_chunks / 4))
 				break;
 
+			/* Leave passive gc to the background thread while
+			 * it is keeping up with its reserve. */
+			if (!background && dev->param.bg_gc_reserve &&
+			    dev->n_erased_blocks >= dev->param.bg_gc_reserve)
+				break;
+
 			if (dev->gc_skip > 20)
 				dev->gc_skip = 20;
 			if (erased_chunks < dev->n_free_chunks / 2 ||
@@ -2958,7 +3184,10 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 				"yaffs: GC n_erased_blocks %d aggressive %d",
 				dev->n_erased_blocks, aggressive);
 
-			gc_ok = yaffs_gc_block(dev, dev->gc_block, aggressive);
+			start = ktime_get();
+			gc_ok = yaffs_gc_block(dev, dev->gc_block,
+					       aggressive || background > 1);
+			yaffs_gc_account(dev, background, start);
 		}
 
 		if (dev->n_erased_blocks < (dev->param.n_reserved_blocks)
@@ -2977,15 +3206,31 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 /*
  * yaffs_bg_gc()
  * Garbage collects. Intended to be called from a background thread.
+ * With urgency above 1 whole blocks are collected, a few at a time,
+ * until bg_gc_reserve blocks are erased.
  * Returns non-zero if at least half the free chunks are erased.
  */
 int yaffs_bg_gc(struct yaffs_dev *dev, unsigned urgency)
 {
-	int erased_chunks = dev->n_erased_blocks * dev->param.chunks_per_block;
+	int erased_chunks;
+	int erased_before;
+	int n = 0;
 
 	yaffs_trace(YAFFS_TRACE_BACKGROUND, "Background gc %u", urgency);
 
-	yaffs_check_gc(dev, 1);
+	if (urgency > 1) {
+		do {
+			erased_before = dev->n_erased_blocks;
+			yaffs_check_gc(dev, 2);
+			n++;
+		} while (n < YAFFS_BG_GC_MAX_BLOCKS &&
+			 dev->n_erased_blocks < dev->param.bg_gc_reserve &&
+			 dev->n_erased_blocks > erased_before);
+	} else {
+		yaffs_check_gc(dev, 1);
+	}
+
+	erased_chunks = dev->n_erased_blocks * dev->param.chunks_per_block;
 	return erased_chunks > dev->n_free_chunks / 2;
 }
 
@@ -3061,6 +3306,7 @@ void yaffs_chunk_del(struct yaffs_dev *dev, int chunk_id, int mark_flash,
 		yaffs_clear_chunk_bit(dev, block, page);
 
 		bi->pages_in_use--;
+		yaffs_gc_index_update(dev, block);
 
 		if (bi->pages_in_use == 0 &&
 		    !bi->has_shrink_hdr &&
@@ -4764,6 +5010,7 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	int init_failed = 0;
 	unsigned x;
 	int bits;
+	unsigned long mount_start;
 
 	yaffs_trace(YAFFS_TRACE_TRACING, "yaffs: yaffs_guts_initialise()" );
 
@@ -4916,7 +5163,6 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	dev->passive_gc_count = 0;
 	dev->oldest_dirty_gc_count = 0;
 	dev->bg_gcs = 0;
-	dev->gc_block_finder = 0;
 	dev->buffered_block = -1;
 	dev->doing_buffered_block_rewrite = 0;
 	dev->n_deleted_files = 0;
@@ -4983,6 +5229,9 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	if (dev->param.is_yaffs2)
 		dev->param.use_header_file_size = 1;
 
+	if (!init_failed && !yaffs_summary_init(dev))
+		init_failed = 1;
+
 	if (!init_failed && !yaffs_init_blocks(dev))
 		init_failed = 1;
 
@@ -4991,6 +5240,11 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	if (!init_failed && !yaffs_create_initial_dir(dev))
 		init_failed = 1;
 
+	dev->scan_sum_blocks = 0;
+	dev->scan_full_blocks = 0;
+	dev->scan_tags_reads = 0;
+	mount_start = jiffies;
+
 	if (!init_failed) {
 		/* Now scan the flash. */
 		if (dev->param.is_yaffs2) {
@@ -5036,8 +5290,18 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 		yaffs_fix_hanging_objs(dev);
 		if (dev->param.empty_lost_n_found)
 			yaffs_empty_l_n_f(dev);
+
+		/* Block states were loaded behind the index's back */
+		if (!init_failed)
+			yaffs_gc_index_rebuild(dev);
 	}
 
+	dev->mount_time_ms = jiffies_to_msecs(jiffies - mount_start);
+	yaffs_trace(YAFFS_TRACE_MOUNT,
+		"yaffs: mount took %u ms, %u blocks from summaries, %u blocks scanned, %u tags read",
+		dev->mount_time_ms, dev->scan_sum_blocks,
+		dev->scan_full_blocks, dev->scan_tags_reads);
+
 	if (init_failed) {
 		/* Clean up the mess */
 		yaffs_trace(YAFFS_TRACE_TRACING,
@@ -5053,6 +5317,11 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	dev->n_erasures = 0;
 	dev->n_gc_copies = 0;
 	dev->n_retired_writes = 0;
+	dev->n_summaries_written = 0;
+	dev->gc_fg_time_us = 0;
+	dev->gc_bg_time_us = 0;
+	dev->gc_fg_max_us = 0;
+	dev->fg_gcs = 0;
 
 	dev->n_retired_blocks = 0;
 
@@ -5089,6 +5358,7 @@ void yaffs_deinitialise(struct yaffs_dev *dev)
 		}
 
 		kfree(dev->gc_cleanup_list);
+		yaffs_summary_deinit(dev);
 
 		for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++)
 			kfree(dev->temp_buffer[i].buffer);
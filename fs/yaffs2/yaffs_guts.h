@@ -83,6 +83,9 @@
 #define YAFFS_OBJECTID_CHECKPOINT_DATA	0x20
 #define YAFFS_SEQUENCE_CHECKPOINT_DATA  0x21
 
+/* Pseudo object id for block summary chunks */
+#define YAFFS_OBJECTID_SUMMARY		0x10
+
 #define YAFFS_MAX_SHORT_OP_CACHES	20
 
 #define YAFFS_N_TEMP_BUFFERS		6
@@ -286,6 +289,16 @@ struct yaffs_block_info {
 
 };
 
+/*
+ * GC victim index entry. FULL blocks that could be collected are kept on
+ * per-bucket lists, one bucket per number of chunks in use.
+ */
+struct yaffs_gc_index_entry {
+	int prev;		/* Previous block in the bucket, -1 if first */
+	int next;		/* Next block in the bucket, -1 if last */
+	int bucket;		/* Bucket the block is in, -1 if none */
+};
+
 /* -------------------------- Object structure -------------------------------*/
 /* This is the object structure as stored on NAND */
 
@@ -570,6 +583,10 @@ struct yaffs_param {
 
 	int defered_dir_update;	/* Set to defer directory updates */
 
+	int bg_gc_reserve;	/* Erased blocks the background gc keeps, 0 if no background gc */
+
+	int disable_summary;	/* yaffs2 only: Set to disable block summaries */
+
 #ifdef CONFIG_YAFFS_AUTO_UNICODE
 	int auto_unicode;
 #endif
@@ -641,11 +658,22 @@ struct yaffs_dev {
 				 * Must be consistent with chunks_per_block.
 				 */
 
+	/* GC victim index */
+	struct yaffs_gc_index_entry *gc_index;	/* One entry per block */
+	int *gc_bucket_head;	/* First block of each bucket, -1 if empty */
+	int *gc_bucket_tail;	/* Last block of each bucket, -1 if empty */
+	unsigned gc_index_alt:1;	/* gc_index was allocated using alternative strategy */
+
 	int n_erased_blocks;
 	int alloc_block;	/* Current block being allocated off */
 	u32 alloc_page;
 	int alloc_block_finder;	/* Used to search for next allocation block */
 
+	/* Block summaries */
+	int chunks_per_summary;	/* Chunks covered by a summary, 0 if disabled */
+	struct yaffs_summary_tags *sum_tags;	/* Tags collected for sum_block */
+	int sum_block;		/* Block being summarised, -1 if none */
+
 	/* Object and Tnode memory management */
 	void *allocator;
 	int n_obj;
@@ -664,7 +692,6 @@ struct yaffs_dev {
 
 	unsigned has_pending_prioritised_gc;	/* We think this device might have pending prioritised gcs */
 	unsigned gc_disable;
-	unsigned gc_block_finder;
 	unsigned gc_dirtiest;
 	unsigned gc_pages_in_use;
 	unsigned gc_not_done;
@@ -734,6 +761,17 @@ struct yaffs_dev {
 	u32 n_unmarked_deletions;
 	u32 refresh_count;
 	u32 cache_hits;
+	u32 n_summaries_written;
+	u64 gc_fg_time_us;	/* Time spent collecting blocks in the foreground */
+	u64 gc_bg_time_us;	/* Time spent collecting blocks in the background */
+	u32 gc_fg_max_us;	/* Longest single foreground collection */
+	u32 fg_gcs;		/* Foreground collection passes */
+
+	/* Mount statistics */
+	u32 mount_time_ms;	/* Time taken to restore checkpoint or scan */
+	u32 scan_sum_blocks;	/* Blocks scanned using their summary */
+	u32 scan_full_blocks;	/* Blocks scanned chunk by chunk */
+	u32 scan_tags_reads;	/* Chunk tags read from NAND while scanning */
 
 };
 
@@ -885,6 +923,7 @@ void yaffs_add_obj_to_dir(struct yaffs_obj *directory, struct yaffs_obj *obj);
 YCHAR *yaffs_clone_str(const YCHAR * str);
 void yaffs_link_fixup(struct yaffs_dev *dev, struct yaffs_obj *hard_list);
 void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no);
+void yaffs_gc_index_update(struct yaffs_dev *dev, int blk);
 int yaffs_update_oh(struct yaffs_obj *in, const YCHAR * name,
 		    int force, int is_shrink, int shadows,
 		    struct yaffs_xattr_mod *xop);
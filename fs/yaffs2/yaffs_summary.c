@@ -0,0 +1,311 @@
+/*
+ * YAFFS: Yet Another Flash File System. A NAND-flash specific file system.
+ *
+ * Copyright (C) 2002-2010 Aleph One Ltd.
+ *   for Toby Churchill Ltd and Brightstar Engineering
+ *
+ * Created by Charles Manning <charles@aleph1.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Block summaries.
+ *
+ * When a yaffs2 block has been filled up to its last few chunks, the
+ * packed tags of all the chunks written so far are written into those
+ * remaining chunks. A scan can then read one or two chunks per block
+ * instead of the tags of every chunk.
+ *
+ * The summary chunks are never in use: once written they count as
+ * deleted chunks, so garbage collection and free space accounting do
+ * not need to know about them. A scan that cannot use the summary of a
+ * block skips them like chunks with bad tags.
+ *
+ * A summary is only written for a block whose every chunk was written
+ * since mount. Blocks without a valid summary are scanned as before.
+ */
+
+#include "yaffs_summary.h"
+#include "yaffs_packedtags2.h"
+#include "yaffs_nand.h"
+#include "yaffs_getblockinfo.h"
+#include "yaffs_tagsvalidity.h"
+
+#define YAFFS_SUMMARY_VERSION	1
+
+struct yaffs_summary_header {
+	u32 version;		/* Must match YAFFS_SUMMARY_VERSION */
+	u32 block;		/* Must be this block */
+	u32 seq;		/* Must be this block's sequence number */
+	u32 sum;		/* Byte sum of all the summary tags */
+};
+
+static int yaffs_summary_n_chunks(struct yaffs_dev *dev)
+{
+	return dev->param.chunks_per_block - dev->chunks_per_summary;
+}
+
+static void yaffs_summary_clear(struct yaffs_dev *dev)
+{
+	memset(dev->sum_tags, 0,
+	       dev->chunks_per_summary * sizeof(struct yaffs_summary_tags));
+}
+
+static u32 yaffs_summary_sum(struct yaffs_dev *dev,
+			     struct yaffs_summary_tags *st)
+{
+	u8 *sum_buffer = (u8 *) st;
+	int i = dev->chunks_per_summary * sizeof(struct yaffs_summary_tags);
+	u32 sum = 0;
+
+	while (i > 0) {
+		sum += *sum_buffer;
+		sum_buffer++;
+		i--;
+	}
+	return sum;
+}
+
+int yaffs_summary_init(struct yaffs_dev *dev)
+{
+	int sum_bytes;
+	int bytes_per_chunk;
+	int n_chunks;
+
+	dev->chunks_per_summary = 0;
+	dev->sum_tags = NULL;
+	dev->sum_block = -1;
+
+	if (!dev->param.is_yaffs2 || dev->param.disable_summary)
+		return YAFFS_OK;
+
+	sum_bytes = dev->param.chunks_per_block *
+	    sizeof(struct yaffs_summary_tags);
+	bytes_per_chunk = dev->data_bytes_per_chunk -
+	    sizeof(struct yaffs_summary_header);
+	n_chunks = (sum_bytes + bytes_per_chunk - 1) / bytes_per_chunk;
+
+	/* Not worth it if the summary eats a big part of each block */
+	if (n_chunks * 4 > dev->param.chunks_per_block) {
+		yaffs_trace(YAFFS_TRACE_ALWAYS,
+			"yaffs: block summaries disabled, %d chunks per block",
+			dev->param.chunks_per_block);
+		return YAFFS_OK;
+	}
+
+	dev->chunks_per_summary = dev->param.chunks_per_block - n_chunks;
+	dev->sum_tags = kmalloc(dev->chunks_per_summary *
+				sizeof(struct yaffs_summary_tags), GFP_NOFS);
+	if (!dev->sum_tags) {
+		dev->chunks_per_summary = 0;
+		return YAFFS_FAIL;
+	}
+
+	yaffs_summary_clear(dev);
+	return YAFFS_OK;
+}
+
+void yaffs_summary_deinit(struct yaffs_dev *dev)
+{
+	kfree(dev->sum_tags);
+	dev->sum_tags = NULL;
+	dev->chunks_per_summary = 0;
+}
+
+/*
+ * Write the collected tags into the rest of the allocation block and
+ * close the block.
+ */
+static void yaffs_summary_write(struct yaffs_dev *dev, int blk)
+{
+	struct yaffs_block_info *bi = yaffs_get_block_info(dev, blk);
+	struct yaffs_summary_header hdr;
+	struct yaffs_ext_tags tags;
+	int bytes_per_chunk = dev->data_bytes_per_chunk - sizeof(hdr);
+	u8 *sum_buffer = (u8 *) dev->sum_tags;
+	int n_bytes;
+	int this_tx;
+	int chunk;
+	int result = YAFFS_OK;
+	u8 *buffer;
+
+	buffer = yaffs_get_temp_buffer(dev, __LINE__);
+
+	hdr.version = YAFFS_SUMMARY_VERSION;
+	hdr.block = blk;
+	hdr.seq = bi->seq_number;
+	hdr.sum = yaffs_summary_sum(dev, dev->sum_tags);
+
+	yaffs_init_tags(&tags);
+	tags.obj_id = YAFFS_OBJECTID_SUMMARY;
+	tags.chunk_id = 1;
+
+	n_bytes = dev->chunks_per_summary * sizeof(struct yaffs_summary_tags);
+
+	while (n_bytes > 0 && result == YAFFS_OK) {
+		this_tx = min(n_bytes, bytes_per_chunk);
+
+		memset(buffer, 0xff, dev->data_bytes_per_chunk);
+		memcpy(buffer, &hdr, sizeof(hdr));
+		memcpy(buffer + sizeof(hdr), sum_buffer, this_tx);
+		tags.n_bytes = this_tx + sizeof(hdr);
+
+		chunk = blk * dev->param.chunks_per_block + dev->alloc_page;
+		result = yaffs_wr_chunk_tags_nand(dev, chunk, buffer, &tags);
+
+		/* Written or not, the chunk is now discarded space */
+		dev->alloc_page++;
+
+		n_bytes -= this_tx;
+		sum_buffer += this_tx;
+		tags.chunk_id++;
+	}
+
+	yaffs_release_temp_buffer(dev, buffer, __LINE__);
+
+	if (result == YAFFS_OK) {
+		dev->n_summaries_written++;
+	} else {
+		yaffs_trace(YAFFS_TRACE_ERROR,
+			"**>> yaffs summary write failed in block %d", blk);
+		yaffs_handle_chunk_error(dev, bi);
+	}
+
+	/* Nothing else goes in this block */
+	bi->block_state = YAFFS_BLOCK_STATE_FULL;
+	yaffs_gc_index_update(dev, blk);
+	dev->alloc_block = -1;
+
+	if (bi->pages_in_use == 0 && !bi->has_shrink_hdr)
+		yaffs_block_became_dirty(dev, blk);
+}
+
+/*
+ * Record the tags of a chunk that has just been written. Called for
+ * every chunk written through yaffs_write_new_chunk().
+ */
+void yaffs_summary_add(struct yaffs_dev *dev, struct yaffs_ext_tags *tags,
+		       int nand_chunk)
+{
+	struct yaffs_packed_tags2_tags_only tags_only;
+	struct yaffs_summary_tags *st;
+	int blk = nand_chunk / dev->param.chunks_per_block;
+	int chunk_in_block = nand_chunk % dev->param.chunks_per_block;
+
+	if (!dev->chunks_per_summary)
+		return;
+
+	/* Only collect for blocks we have seen from their first chunk */
+	if (chunk_in_block == 0) {
+		yaffs_summary_clear(dev);
+		dev->sum_block = blk;
+	}
+
+	if (blk != dev->sum_block || chunk_in_block >= dev->chunks_per_summary)
+		return;
+
+	yaffs_pack_tags2_tags_only(&tags_only, tags);
+	st = &dev->sum_tags[chunk_in_block];
+	st->obj_id = tags_only.obj_id;
+	st->chunk_id = tags_only.chunk_id;
+	st->n_bytes = tags_only.n_bytes;
+
+	if (chunk_in_block == dev->chunks_per_summary - 1) {
+		dev->sum_block = -1;
+		if (dev->alloc_block == blk &&
+		    dev->alloc_page == dev->chunks_per_summary)
+			yaffs_summary_write(dev, blk);
+	}
+}
+
+/*
+ * Read and check the summary of a block into st.
+ * Returns YAFFS_OK if the block has a valid summary.
+ */
+int yaffs_summary_read(struct yaffs_dev *dev, struct yaffs_summary_tags *st,
+		       int blk)
+{
+	struct yaffs_block_info *bi = yaffs_get_block_info(dev, blk);
+	struct yaffs_summary_header hdr;
+	struct yaffs_ext_tags tags;
+	int bytes_per_chunk = dev->data_bytes_per_chunk - sizeof(hdr);
+	u8 *sum_buffer = (u8 *) st;
+	int n_bytes;
+	int this_tx;
+	int chunk;
+	int i;
+	int result = YAFFS_OK;
+	u8 *buffer;
+
+	if (!dev->chunks_per_summary)
+		return YAFFS_FAIL;
+
+	buffer = yaffs_get_temp_buffer(dev, __LINE__);
+
+	n_bytes = dev->chunks_per_summary * sizeof(struct yaffs_summary_tags);
+	chunk = blk * dev->param.chunks_per_block + dev->chunks_per_summary;
+
+	for (i = 0; n_bytes > 0 && result == YAFFS_OK; i++) {
+		this_tx = min(n_bytes, bytes_per_chunk);
+
+		result = yaffs_rd_chunk_tags_nand(dev, chunk + i, buffer,
+						  &tags);
+		if (result != YAFFS_OK)
+			break;
+
+		memcpy(&hdr, buffer, sizeof(hdr));
+
+		if (!tags.chunk_used ||
+		    tags.ecc_result == YAFFS_ECC_RESULT_UNFIXED ||
+		    tags.obj_id != YAFFS_OBJECTID_SUMMARY ||
+		    tags.chunk_id != i + 1 ||
+		    tags.n_bytes != this_tx + sizeof(hdr) ||
+		    tags.seq_number != bi->seq_number ||
+		    hdr.version != YAFFS_SUMMARY_VERSION ||
+		    hdr.block != blk || hdr.seq != bi->seq_number) {
+			result = YAFFS_FAIL;
+			break;
+		}
+
+		memcpy(sum_buffer, buffer + sizeof(hdr), this_tx);
+		n_bytes -= this_tx;
+		sum_buffer += this_tx;
+	}
+
+	yaffs_release_temp_buffer(dev, buffer, __LINE__);
+
+	if (result == YAFFS_OK && hdr.sum != yaffs_summary_sum(dev, st)) {
+		yaffs_trace(YAFFS_TRACE_SCAN,
+			"Summary of block %d has a bad checksum", blk);
+		result = YAFFS_FAIL;
+	}
+
+	return result;
+}
+
+/*
+ * Rebuild the tags of a chunk from a summary read by
+ * yaffs_summary_read(). Chunks the summary knows nothing about, such as
+ * ones whose write failed, have to be read from NAND instead.
+ */
+int yaffs_summary_fetch(struct yaffs_dev *dev, struct yaffs_ext_tags *tags,
+			struct yaffs_summary_tags *st, int chunk_in_block)
+{
+	struct yaffs_packed_tags2_tags_only tags_only;
+
+	if (chunk_in_block < 0 || chunk_in_block >= dev->chunks_per_summary ||
+	    st[chunk_in_block].obj_id == 0)
+		return YAFFS_FAIL;
+
+	st += chunk_in_block;
+	tags_only.obj_id = st->obj_id;
+	tags_only.chunk_id = st->chunk_id;
+	tags_only.n_bytes = st->n_bytes;
+	tags_only.seq_number = 0;
+	yaffs_unpack_tags2_tags_only(tags, &tags_only);
+
+	return YAFFS_OK;
+}
@@ -96,6 +96,7 @@ unsigned int yaffs_wr_attempts = YAFFS_WR_ATTEMPTS;
 unsigned int yaffs_auto_checkpoint = 1;
 unsigned int yaffs_gc_control = 1;
 unsigned int yaffs_bg_enable = 1;
+unsigned int yaffs_bg_gc_reserve = 16;
 
 /* Module Parameters */
 module_param(yaffs_trace_mask, uint, 0644);
@@ -103,6 +104,7 @@ module_param(yaffs_wr_attempts, uint, 0644);
 module_param(yaffs_auto_checkpoint, uint, 0644);
 module_param(yaffs_gc_control, uint, 0644);
 module_param(yaffs_bg_enable, uint, 0644);
+module_param(yaffs_bg_gc_reserve, uint, 0644);
 
 
 #define yaffs_inode_to_obj_lv(iptr) ((iptr)->i_private)
@@ -1545,12 +1547,20 @@ static void yaffs_flush_super(struct super_block *sb, int do_checkpoint)
 		yaffs_checkpoint_save(dev);
 }
 
+/*
+ * Urgency 2 makes the background gc collect whole blocks. That happens
+ * when the erased block reserve runs low, when free space is badly
+ * scattered, or when there is work to do and nothing has been written
+ * since the last run, so writers do not have to collect blocks
+ * themselves.
+ */
 static unsigned yaffs_bg_gc_urgency(struct yaffs_dev *dev)
 {
 	unsigned erased_chunks =
 	    dev->n_erased_blocks * dev->param.chunks_per_block;
 	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
 	unsigned scattered = 0;	/* Free chunks not in an erased block */
+	int idle = (dev->n_page_writes == context->bg_page_writes);
 
 	if (erased_chunks < dev->n_free_chunks)
 		scattered = (dev->n_free_chunks - erased_chunks);
@@ -1559,8 +1569,12 @@ static unsigned yaffs_bg_gc_urgency(struct yaffs_dev *dev)
 		return 0;
 	else if (scattered < (dev->param.chunks_per_block * 2))
 		return 0;
+	else if (dev->n_erased_blocks < dev->param.bg_gc_reserve)
+		return 2;
 	else if (erased_chunks > dev->n_free_chunks / 2)
 		return 0;
+	else if (idle)
+		return 2;
 	else if (erased_chunks > dev->n_free_chunks / 4)
 		return 1;
 	else
@@ -1649,10 +1663,15 @@ static int yaffs_bg_thread_fn(void *data)
 			next_dir_update = now + HZ;
 		}
 
+		/* Writers leave passive gc to us while we keep a reserve */
+		dev->param.bg_gc_reserve = yaffs_bg_enable ?
+		    yaffs_bg_gc_reserve : 0;
+
 		if (time_after(now, next_gc) && yaffs_bg_enable) {
 			if (!dev->is_checkpointed) {
 				urgency = yaffs_bg_gc_urgency(dev);
 				gc_result = yaffs_bg_gc(dev, urgency);
+				context->bg_page_writes = dev->n_page_writes;
 				if (urgency > 1)
 					next_gc = now + HZ / 20 + 1;
 				else if (urgency > 0)
@@ -1719,6 +1738,9 @@ static void yaffs_bg_stop(struct yaffs_dev *dev)
 		kthread_stop(ctxt->bg_thread);
 		ctxt->bg_thread = NULL;
 	}
+
+	/* Writers have to do all their own gc again */
+	dev->param.bg_gc_reserve = 0;
 }
 
 static void yaffs_write_super(struct super_block *sb)
@@ -1762,6 +1784,8 @@ struct yaffs_options {
 	int lazy_loading_overridden;
 	int empty_lost_and_found;
 	int empty_lost_and_found_overridden;
+	int summary_enabled;
+	int summary_overridden;
 };
 
 #define MAX_OPT_LEN 30
@@ -1809,6 +1833,12 @@ static int yaffs_parse_options(struct yaffs_options *options,
 		} else if (!strcmp(cur_opt, "empty-lost-and-found-on")) {
 			options->empty_lost_and_found = 1;
 			options->empty_lost_and_found_overridden = 1;
+		} else if (!strcmp(cur_opt, "summary-off")) {
+			options->summary_enabled = 0;
+			options->summary_overridden = 1;
+		} else if (!strcmp(cur_opt, "summary-on")) {
+			options->summary_enabled = 1;
+			options->summary_overridden = 1;
 		} else if (!strcmp(cur_opt, "no-cache")) {
 			options->no_cache = 1;
 		} else if (!strcmp(cur_opt, "no-checkpoint-read")) {
@@ -2254,6 +2284,12 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	if (options.empty_lost_and_found_overridden)
 		param->empty_lost_n_found = options.empty_lost_and_found;
 
+#ifdef CONFIG_YAFFS_DISABLE_SUMMARY
+	param->disable_summary = 1;
+#endif
+	if (options.summary_overridden)
+		param->disable_summary = !options.summary_enabled;
+
 	/* ... and the functions. */
 	if (yaffs_version == 2) {
 		param->write_chunk_tags_fn = nandmtd2_write_chunk_tags;
@@ -2437,6 +2473,8 @@ static char *yaffs_dump_dev_part0(char *buf, struct yaffs_dev *dev)
 			param->n_reserved_blocks);
 	buf += sprintf(buf, "always_check_erased... %d\n",
 			param->always_check_erased);
+	buf += sprintf(buf, "disable_summary....... %d\n",
+			param->disable_summary);
 
 	return buf;
 }
@@ -2452,6 +2490,15 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	    sprintf(buf, "n_erased_blocks....... %d\n", dev->n_erased_blocks);
 	buf +=
 	    sprintf(buf, "blocks_in_checkpt..... %d\n", dev->blocks_in_checkpt);
+	buf +=
+	    sprintf(buf, "chunks_per_summary.... %d\n",
+		    dev->chunks_per_summary);
+	buf += sprintf(buf, "\n");
+	buf += sprintf(buf, "mount_time_ms......... %u\n", dev->mount_time_ms);
+	buf += sprintf(buf, "scan_sum_blocks....... %u\n", dev->scan_sum_blocks);
+	buf +=
+	    sprintf(buf, "scan_full_blocks...... %u\n", dev->scan_full_blocks);
+	buf += sprintf(buf, "scan_tags_reads....... %u\n", dev->scan_tags_reads);
 	buf += sprintf(buf, "\n");
 	buf += sprintf(buf, "n_tnodes.............. %d\n", dev->n_tnodes);
 	buf += sprintf(buf, "n_obj................. %d\n", dev->n_obj);
@@ -2469,6 +2516,18 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 		    dev->oldest_dirty_gc_count);
 	buf += sprintf(buf, "n_gc_blocks........... %u\n", dev->n_gc_blocks);
 	buf += sprintf(buf, "bg_gcs................ %u\n", dev->bg_gcs);
+	buf += sprintf(buf, "fg_gcs................ %u\n", dev->fg_gcs);
+	buf +=
+	    sprintf(buf, "gc_fg_time_us......... %llu\n",
+		    (unsigned long long)dev->gc_fg_time_us);
+	buf +=
+	    sprintf(buf, "gc_fg_max_us.......... %u\n", dev->gc_fg_max_us);
+	buf +=
+	    sprintf(buf, "gc_bg_time_us......... %llu\n",
+		    (unsigned long long)dev->gc_bg_time_us);
+	buf +=
+	    sprintf(buf, "bg_gc_reserve......... %d\n",
+		    dev->param.bg_gc_reserve);
 	buf +=
 	    sprintf(buf, "n_retired_writes...... %u\n", dev->n_retired_writes);
 	buf +=
@@ -2481,6 +2540,9 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	    sprintf(buf, "n_tags_ecc_unfixed.... %u\n",
 		    dev->n_tags_ecc_unfixed);
 	buf += sprintf(buf, "cache_hits............ %u\n", dev->cache_hits);
+	buf +=
+	    sprintf(buf, "n_summaries_written... %u\n",
+		    dev->n_summaries_written);
 	buf +=
 	    sprintf(buf, "n_deleted_files....... %u\n", dev->n_deleted_files);
 	buf +=
@@ -20,6 +20,7 @@
 #include "yaffs_getblockinfo.h"
 #include "yaffs_verify.h"
 #include "yaffs_attribs.h"
+#include "yaffs_summary.h"
 
 /*
  * Checkpoints are really no benefit on very small partitions.
@@ -987,6 +988,9 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 	struct yaffs_block_index *block_index = NULL;
 	int alt_block_index = 0;
 
+	struct yaffs_summary_tags *sum_tags = NULL;
+	int summary_available;
+
 	yaffs_trace(YAFFS_TRACE_SCAN,
 		"yaffs2_scan_backwards starts  intstartblk %d intendblk %d...",
 		dev->internal_start_block, dev->internal_end_block);
@@ -1011,6 +1015,12 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 	dev->blocks_in_checkpt = 0;
 
+	/* Separate from dev->sum_tags, which belongs to the allocator */
+	if (dev->chunks_per_summary)
+		sum_tags = kmalloc(dev->chunks_per_summary *
+				   sizeof(struct yaffs_summary_tags),
+				   GFP_NOFS);
+
 	chunk_data = yaffs_get_temp_buffer(dev, __LINE__);
 
 	/* Scan all the blocks to determine their state */
@@ -1102,9 +1112,26 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 		deleted = 0;
 
+		/*
+		 * A block with a summary holds nothing but discarded
+		 * summary chunks past chunks_per_summary.
+		 */
+		summary_available = sum_tags &&
+		    yaffs_summary_read(dev, sum_tags, blk) == YAFFS_OK;
+
+		if (summary_available) {
+			dev->scan_sum_blocks++;
+			dev->n_free_chunks += dev->param.chunks_per_block -
+			    dev->chunks_per_summary;
+			c = dev->chunks_per_summary - 1;
+		} else {
+			dev->scan_full_blocks++;
+			c = dev->param.chunks_per_block - 1;
+		}
+
 		/* For each chunk in each block that needs scanning.... */
 		found_chunks = 0;
-		for (c = dev->param.chunks_per_block - 1;
+		for (/* c is already initialised */;
 		     !alloc_failed && c >= 0 &&
 		     (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING ||
 		      state == YAFFS_BLOCK_STATE_ALLOCATING); c--) {
@@ -1114,8 +1141,15 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 			chunk = blk * dev->param.chunks_per_block + c;
 
-			result = yaffs_rd_chunk_tags_nand(dev, chunk, NULL,
-							  &tags);
+			if (summary_available &&
+			    yaffs_summary_fetch(dev, &tags, sum_tags, c) ==
+			    YAFFS_OK) {
+				tags.seq_number = bi->seq_number;
+			} else {
+				result = yaffs_rd_chunk_tags_nand(dev, chunk,
+								  NULL, &tags);
+				dev->scan_tags_reads++;
+			}
 
 			/* Let's have a good look at this chunk... */
 
@@ -1177,6 +1211,7 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 				dev->n_free_chunks++;
 
 			} else if (tags.obj_id > YAFFS_MAX_OBJECT_ID ||
+				   tags.obj_id == YAFFS_OBJECTID_SUMMARY ||
 				   tags.chunk_id > YAFFS_MAX_CHUNK_ID ||
 				   (tags.chunk_id > 0
 				    && tags.n_bytes > dev->data_bytes_per_chunk)
@@ -1580,6 +1615,8 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 	else
 		kfree(block_index);
 
+	kfree(sum_tags);
+
 	/* Ok, we've done all the scanning.
 	 * Fix up the hard link chains.
 	 * We should now have scanned all the objects, now it's time to add these
@@ -371,6 +371,12 @@ extern struct cpufreq_governor cpufreq_gov_interactive;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_interactive)
 #endif
 
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE
+extern void cpufreq_interactive_hint(void);
+#else
+static inline void cpufreq_interactive_hint(void) { }
+#endif
+
 
 /*********************************************************************
  *                     FREQUENCY TABLE HELPERS                       *
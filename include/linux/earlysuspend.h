@@ -29,6 +29,9 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ * Handlers that set async do not depend on the order of the other handlers of
+ * their level and may be called concurrently with them; a level only starts
+ * once every handler of the previous level has returned.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
@@ -41,6 +44,12 @@ struct early_suspend {
 	int level;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
+	bool async;
+	/* Last and longest handler run times in microseconds */
+	unsigned long suspend_us;
+	unsigned long suspend_max_us;
+	unsigned long resume_us;
+	unsigned long resume_max_us;
 #endif
 };
 
@@ -924,6 +924,9 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+#ifdef CONFIG_READAHEAD_TRACE
+	unsigned int trace;		/* See mm/readahead_trace.c */
+#endif
 };
 
 /*
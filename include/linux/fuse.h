@@ -145,16 +145,24 @@ struct fuse_file_lock {
  * FOPEN_DIRECT_IO: bypass page cache for this open file
  * FOPEN_KEEP_CACHE: don't invalidate the data cache on open
  * FOPEN_NONSEEKABLE: the file is not seekable
+ * FOPEN_PASSTHROUGH: do reads and writes on the file given in passthrough_fd
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
 #define FOPEN_NONSEEKABLE	(1 << 2)
+#define FOPEN_PASSTHROUGH	(1 << 31)
 
 /**
  * INIT request/reply flags
  *
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
+ * FUSE_WRITEBACK_CACHE: buffer writes in the page cache and write back
+ *			 dirty pages in batches
+ * FUSE_MAX_PAGES: init_out.max_pages contains the maximum number of
+ *		   pages in a single READ or WRITE request
+ * FUSE_PASSTHROUGH: OPEN and CREATE replies may set FOPEN_PASSTHROUGH;
+ *		     only offered to daemons with CAP_SYS_ADMIN
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -163,6 +171,10 @@ struct fuse_file_lock {
 #define FUSE_EXPORT_SUPPORT	(1 << 4)
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
+#define FUSE_WRITEBACK_CACHE	(1 << 16)
+#define FUSE_MAX_PAGES		(1 << 22)
+/* upstream uses bit 26 only for DAX mapping alignment (virtiofs) */
+#define FUSE_PASSTHROUGH	(1 << 26)
 
 /**
  * CUSE INIT request/reply flags
@@ -380,7 +392,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	__u64	fh;
 	__u32	open_flags;
-	__u32	padding;
+	__u32	passthrough_fd;	/* descriptor in the replying process */
 };
 
 struct fuse_release_in {
@@ -483,6 +495,9 @@ struct fuse_init_out {
 	__u16   max_background;
 	__u16   congestion_threshold;
 	__u32	max_write;
+	__u32	unused;
+	__u16	max_pages;
+	__u16	padding;
 };
 
 #define CUSE_INIT_INFO_MAX 4096
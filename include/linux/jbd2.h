@@ -130,6 +130,7 @@ typedef struct journal_s	journal_t;	/* Journal control structure */
 #define JBD2_SUPERBLOCK_V1	3
 #define JBD2_SUPERBLOCK_V2	4
 #define JBD2_REVOKE_BLOCK	5
+#define JBD2_FC_BLOCK		6
 
 /*
  * Standard header for all descriptor blocks:
@@ -192,6 +193,22 @@ typedef struct jbd2_journal_revoke_header_s
 	__be32		 r_count;	/* Count of bytes used in the block */
 } jbd2_journal_revoke_header_t;
 
+/*
+ * The fast commit header: each block in the fast commit area carries
+ * one self-contained piece of client data for the running transaction
+ * (h_sequence), to be replayed after the last committed transaction.
+ */
+typedef struct jbd2_fc_header_s
+{
+	journal_header_t fc_header;
+	__be32		 fc_index;	/* Block offset in the fast commit area */
+	__be32		 fc_len;	/* Bytes of client data that follow */
+	__be32		 fc_chksum;	/* crc32_be of the header and data */
+} jbd2_fc_header_t;
+
+/* Blocks set aside at the end of the journal for fast commits */
+#define JBD2_FC_BLOCKS		64
+
 
 /* Definitions for the journal tag flags word: */
 #define JBD2_FLAG_ESCAPE		1	/* on-disk block is escaped */
@@ -263,13 +280,15 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_REVOKE		0x00000001
 #define JBD2_FEATURE_INCOMPAT_64BIT		0x00000002
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT	0x00000040
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
 #define JBD2_KNOWN_ROCOMPAT_FEATURES	0
 #define JBD2_KNOWN_INCOMPAT_FEATURES	(JBD2_FEATURE_INCOMPAT_REVOKE | \
 					JBD2_FEATURE_INCOMPAT_64BIT | \
-					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)
+					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
 
 #ifdef __KERNEL__
 
@@ -676,6 +695,7 @@ struct transaction_run_stats_s {
 	unsigned long		rs_locked;
 	unsigned long		rs_flushing;
 	unsigned long		rs_logging;
+	unsigned long		rs_committing;
 
 	__u32			rs_handle_count;
 	__u32			rs_blocks;
@@ -684,9 +704,27 @@ struct transaction_run_stats_s {
 
 struct transaction_stats_s {
 	unsigned long		ts_tid;
+	unsigned long		ts_fc;		/* Fast commits written */
+	u64			ts_fc_time;	/* Total fast commit time, in ns */
 	struct transaction_run_stats_s run;
 };
 
+/*
+ * Commit phases timed for the latency histogram in
+ * /proc/fs/jbd2/<dev>/commit_hist
+ */
+enum {
+	JBD2_PHASE_LOCKED,	/* Waiting for running handles to finish */
+	JBD2_PHASE_FLUSHING,	/* Writing ordered data */
+	JBD2_PHASE_LOGGING,	/* Writing metadata and control blocks */
+	JBD2_PHASE_COMMITTING,	/* Writing the commit record, retiring */
+	JBD2_PHASE_TOTAL,
+	JBD2_NR_PHASES,
+};
+
+/* Bucket n counts phases that took less than 2^n microseconds */
+#define JBD2_HIST_BUCKETS	24
+
 static inline unsigned long
 jbd2_time_diff(unsigned long start, unsigned long end)
 {
@@ -728,6 +766,12 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_free: Journal free - how many free blocks are there in the journal?
  * @j_first: The block number of the first usable block
  * @j_last: The block number one beyond the last usable block
+ * @j_fc_first: The block number of the first fast commit block
+ * @j_fc_last: The block number one beyond the last fast commit block
+ * @j_fc_off: Offset of the next free block in the fast commit area
+ * @j_fc_tid: Transaction the current fast commit is logged against
+ * @j_fc_start: When the current fast commit started
+ * @j_wait_fc: Wait queue for waiting for a fast commit to finish
  * @j_dev: Device where we store the journal
  * @j_blocksize: blocksize for the location where we store the journal.
  * @j_blk_offset: starting block offset for into the device where we store the
@@ -765,6 +809,7 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_history_lock: Protect the transactions statistics history
  * @j_proc_entry: procfs entry for the jbd statistics directory
  * @j_stats: Overall statistics
+ * @j_commit_hist: Latency histogram of each commit phase
  * @j_private: An opaque pointer to fs-private information.
  */
 
@@ -874,6 +919,21 @@ struct journal_s
 	unsigned long		j_first;
 	unsigned long		j_last;
 
+	/*
+	 * Fast commit area, carved off the end of the journal when the
+	 * FAST_COMMIT feature is set, and the offset of the next block to
+	 * use in it.  Fast commits are serialised by
+	 * JBD2_FAST_COMMIT_ONGOING. [j_state_lock]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_last;
+	unsigned long		j_fc_off;
+	tid_t			j_fc_tid;
+	ktime_t			j_fc_start;
+
+	/* Wait queue for waiting for a fast commit to finish */
+	wait_queue_head_t	j_wait_fc;
+
 	/*
 	 * Device, blocksize and starting block offset for the location where we
 	 * store the journal.
@@ -987,12 +1047,20 @@ struct journal_s
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
 
+	/*
+	 * Called by recovery with the data of each valid fast commit
+	 * block, in order, after the log itself has been replayed.
+	 */
+	int			(*j_fc_replay_callback)(journal_t *,
+							void *, int);
+
 	/*
 	 * Journal statistics
 	 */
 	spinlock_t		j_history_lock;
 	struct proc_dir_entry	*j_proc_entry;
 	struct transaction_stats_s j_stats;
+	unsigned long		j_commit_hist[JBD2_NR_PHASES][JBD2_HIST_BUCKETS];
 
 	/* Failed journal commit ID */
 	unsigned int		j_failed_commit;
@@ -1016,6 +1084,8 @@ struct journal_s
 #define JBD2_ABORT_ON_SYNCDATA_ERR	0x040	/* Abort the journal on file
 						 * data write error in ordered
 						 * mode */
+#define JBD2_FAST_COMMIT_ONGOING	0x080	/* A fast commit is being
+						 * written */
 
 /*
  * Function declarations for the journaling transaction and buffer
@@ -1214,6 +1284,7 @@ extern int	jbd2_journal_set_revoke(journal_t *, unsigned long long, tid_t);
 extern int	jbd2_journal_test_revoke(journal_t *, unsigned long long, tid_t);
 extern void	jbd2_journal_clear_revoke(journal_t *);
 extern void	jbd2_journal_switch_revoke_table(journal_t *journal);
+extern __u32	jbd2_fc_chksum(jbd2_fc_header_t *);
 
 /*
  * The log thread user interface:
@@ -1230,6 +1301,9 @@ int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid);
+int jbd2_fc_write(journal_t *journal, void *data, int len);
+void jbd2_fc_end_commit(journal_t *journal);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
 extern void __jbd2_journal_drop_transaction(journal_t *, transaction_t *);
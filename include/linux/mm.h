@@ -1522,6 +1522,24 @@ unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
 
+/* readahead_trace.c */
+#ifdef CONFIG_READAHEAD_TRACE
+extern int readahead_trace_active;
+void __readahead_trace_access(struct file *file, pgoff_t index, int cached);
+
+static inline void readahead_trace_access(struct file *file, pgoff_t index,
+					  int cached)
+{
+	if (unlikely(readahead_trace_active))
+		__readahead_trace_access(file, index, cached);
+}
+#else
+static inline void readahead_trace_access(struct file *file, pgoff_t index,
+					  int cached)
+{
+}
+#endif
+
 /* Generic expand stack which grows the stack according to GROWS{UP,DOWN} */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 
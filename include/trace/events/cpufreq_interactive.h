@@ -82,6 +82,27 @@ DEFINE_EVENT(loadeval, cpufreq_interactive_notyet,
 	    TP_ARGS(cpu_id, load, curtarg, curactual, newtarg)
 );
 
+TRACE_EVENT(cpufreq_interactive_sample,
+	    TP_PROTO(unsigned long cpu_id, u64 now, u64 now_idle),
+	    TP_ARGS(cpu_id, now, now_idle),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned long, cpu_id    )
+		    __field(u64,           now       )
+		    __field(u64,           now_idle  )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu_id = cpu_id;
+		    __entry->now = now;
+		    __entry->now_idle = now_idle;
+	    ),
+
+	    TP_printk("cpu=%lu now=%llu idle=%llu",
+		      __entry->cpu_id, (unsigned long long)__entry->now,
+		      (unsigned long long)__entry->now_idle)
+);
+
 TRACE_EVENT(cpufreq_interactive_boost,
 	    TP_PROTO(const char *s),
 	    TP_ARGS(s),
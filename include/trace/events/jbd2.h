@@ -81,6 +81,13 @@ DEFINE_EVENT(jbd2_commit, jbd2_commit_logging,
 	TP_ARGS(journal, commit_transaction)
 );
 
+DEFINE_EVENT(jbd2_commit, jbd2_commit_record,
+
+	TP_PROTO(journal_t *journal, transaction_t *commit_transaction),
+
+	TP_ARGS(journal, commit_transaction)
+);
+
 TRACE_EVENT(jbd2_end_commit,
 	TP_PROTO(journal_t *journal, transaction_t *commit_transaction),
 
@@ -138,6 +145,7 @@ TRACE_EVENT(jbd2_run_stats,
 		__field(	unsigned long,	locked		)
 		__field(	unsigned long,	flushing	)
 		__field(	unsigned long,	logging		)
+		__field(	unsigned long,	committing	)
 		__field(		__u32,	handle_count	)
 		__field(		__u32,	blocks		)
 		__field(		__u32,	blocks_logged	)
@@ -151,23 +159,61 @@ TRACE_EVENT(jbd2_run_stats,
 		__entry->locked		= stats->rs_locked;
 		__entry->flushing	= stats->rs_flushing;
 		__entry->logging	= stats->rs_logging;
+		__entry->committing	= stats->rs_committing;
 		__entry->handle_count	= stats->rs_handle_count;
 		__entry->blocks		= stats->rs_blocks;
 		__entry->blocks_logged	= stats->rs_blocks_logged;
 	),
 
 	TP_printk("dev %s tid %lu wait %u running %u locked %u flushing %u "
-		  "logging %u handle_count %u blocks %u blocks_logged %u",
+		  "logging %u committing %u handle_count %u blocks %u "
+		  "blocks_logged %u",
 		  jbd2_dev_to_name(__entry->dev), __entry->tid,
 		  jiffies_to_msecs(__entry->wait),
 		  jiffies_to_msecs(__entry->running),
 		  jiffies_to_msecs(__entry->locked),
 		  jiffies_to_msecs(__entry->flushing),
 		  jiffies_to_msecs(__entry->logging),
+		  jiffies_to_msecs(__entry->committing),
 		  __entry->handle_count, __entry->blocks,
 		  __entry->blocks_logged)
 );
 
+TRACE_EVENT(jbd2_commit_phases,
+	TP_PROTO(dev_t dev, unsigned long tid, u64 *phase_ns),
+
+	TP_ARGS(dev, tid, phase_ns),
+
+	TP_STRUCT__entry(
+		__field(		dev_t,	dev		)
+		__field(	unsigned long,	tid		)
+		__field(		  u64,	locked		)
+		__field(		  u64,	flushing	)
+		__field(		  u64,	logging		)
+		__field(		  u64,	committing	)
+		__field(		  u64,	total		)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= dev;
+		__entry->tid		= tid;
+		__entry->locked		= phase_ns[JBD2_PHASE_LOCKED];
+		__entry->flushing	= phase_ns[JBD2_PHASE_FLUSHING];
+		__entry->logging	= phase_ns[JBD2_PHASE_LOGGING];
+		__entry->committing	= phase_ns[JBD2_PHASE_COMMITTING];
+		__entry->total		= phase_ns[JBD2_PHASE_TOTAL];
+	),
+
+	TP_printk("dev %s tid %lu locked %lluus flushing %lluus "
+		  "logging %lluus committing %lluus total %lluus",
+		  jbd2_dev_to_name(__entry->dev), __entry->tid,
+		  div_u64(__entry->locked, NSEC_PER_USEC),
+		  div_u64(__entry->flushing, NSEC_PER_USEC),
+		  div_u64(__entry->logging, NSEC_PER_USEC),
+		  div_u64(__entry->committing, NSEC_PER_USEC),
+		  div_u64(__entry->total, NSEC_PER_USEC))
+);
+
 TRACE_EVENT(jbd2_checkpoint_stats,
 	TP_PROTO(dev_t dev, unsigned long tid,
 		 struct transaction_chp_stats_s *stats),
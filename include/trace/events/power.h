@@ -48,6 +48,34 @@ DEFINE_EVENT(cpu, cpu_frequency,
 	TP_ARGS(frequency, cpu_id)
 );
 
+TRACE_EVENT(cpu_frequency_switch,
+
+	TP_PROTO(unsigned int cpu_id, unsigned int start_freq,
+		 unsigned int end_freq, unsigned int latency_us),
+
+	TP_ARGS(cpu_id, start_freq, end_freq, latency_us),
+
+	TP_STRUCT__entry(
+		__field(	u32,		cpu_id		)
+		__field(	u32,		start_freq	)
+		__field(	u32,		end_freq	)
+		__field(	u32,		latency_us	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->start_freq = start_freq;
+		__entry->end_freq = end_freq;
+		__entry->latency_us = latency_us;
+	),
+
+	TP_printk("cpu_id=%lu start_freq=%lu end_freq=%lu latency_us=%lu",
+		  (unsigned long)__entry->cpu_id,
+		  (unsigned long)__entry->start_freq,
+		  (unsigned long)__entry->end_freq,
+		  (unsigned long)__entry->latency_us)
+);
+
 TRACE_EVENT(machine_suspend,
 
 	TP_PROTO(unsigned int state),
@@ -13,10 +13,14 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
 
@@ -30,8 +34,12 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+static bool async_handlers = true;
+module_param(async_handlers, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
+static LIST_HEAD(early_suspend_domain);
 static void early_suspend(struct work_struct *work);
 static void late_resume(struct work_struct *work);
 static DECLARE_WORK(early_suspend_work, early_suspend);
@@ -70,11 +78,61 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+static void early_suspend_call(struct early_suspend *h, bool resume)
+{
+	ktime_t start = ktime_get();
+	unsigned long us;
+
+	if (resume) {
+		if (debug_mask & DEBUG_VERBOSE)
+			pr_info("late_resume: calling %pf\n", h->resume);
+		h->resume(h);
+	} else {
+		if (debug_mask & DEBUG_VERBOSE)
+			pr_info("early_suspend: calling %pf\n", h->suspend);
+		h->suspend(h);
+	}
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	if (resume) {
+		h->resume_us = us;
+		if (us > h->resume_max_us)
+			h->resume_max_us = us;
+	} else {
+		h->suspend_us = us;
+		if (us > h->suspend_max_us)
+			h->suspend_max_us = us;
+	}
+}
+
+static void async_early_suspend(void *data, async_cookie_t cookie)
+{
+	early_suspend_call(data, false);
+}
+
+static void async_late_resume(void *data, async_cookie_t cookie)
+{
+	early_suspend_call(data, true);
+}
+
+/*
+ * The last handler of a level runs in the calling worker so that it does
+ * useful work while the others run, and a level of one costs no thread.
+ */
+static bool early_suspend_level_end(struct early_suspend *h,
+				    struct list_head *next)
+{
+	return next == &early_suspend_handlers ||
+		list_entry(next, struct early_suspend, link)->level != h->level;
+}
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = 0;
+	ktime_t start;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -93,13 +151,25 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("early_suspend: calling %pf\n", pos->suspend);
-			pos->suspend(pos);
+		if (pos->level != level) {
+			async_synchronize_full_domain(&early_suspend_domain);
+			level = pos->level;
 		}
+		if (pos->suspend == NULL)
+			continue;
+		if (async_handlers && pos->async &&
+		    !early_suspend_level_end(pos, pos->link.next))
+			async_schedule_domain(async_early_suspend, pos,
+					      &early_suspend_domain);
+		else
+			early_suspend_call(pos, false);
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("early_suspend: handlers done in %lld us\n",
+			ktime_to_us(ktime_sub(ktime_get(), start)));
 	mutex_unlock(&early_suspend_lock);
 
 	suspend_sys_sync_queue();
@@ -115,6 +185,8 @@ static void late_resume(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = 0;
+	ktime_t start;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -131,16 +203,25 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("late_resume: calling %pf\n", pos->resume);
-
-			pos->resume(pos);
+		if (pos->level != level) {
+			async_synchronize_full_domain(&early_suspend_domain);
+			level = pos->level;
 		}
+		if (pos->resume == NULL)
+			continue;
+		if (async_handlers && pos->async &&
+		    !early_suspend_level_end(pos, pos->link.prev))
+			async_schedule_domain(async_late_resume, pos,
+					      &early_suspend_domain);
+		else
+			early_suspend_call(pos, true);
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: done\n");
+		pr_info("late_resume: done in %lld us\n",
+			ktime_to_us(ktime_sub(ktime_get(), start)));
 abort:
 	mutex_unlock(&early_suspend_lock);
 }
@@ -181,3 +262,45 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_stats_show(struct seq_file *m, void *unused)
+{
+	struct early_suspend *pos;
+
+	seq_printf(m, "level\tsuspend_us\tsuspend_max_us\tresume_us"
+		   "\tresume_max_us\thandler\n");
+	mutex_lock(&early_suspend_lock);
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(m, "%d\t%lu\t%lu\t%lu\t%lu\t%pf\n", pos->level,
+			   pos->suspend_us, pos->suspend_max_us,
+			   pos->resume_us, pos->resume_max_us,
+			   pos->suspend ? (void *)pos->suspend :
+			   (void *)pos->resume);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open		= early_suspend_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debug_init(void)
+{
+	if (!debugfs_create_file("early_suspend_stats", S_IRUGO, NULL, NULL,
+				 &early_suspend_stats_fops)) {
+		pr_err("Failed to create early_suspend_stats debug file\n");
+		return -ENOMEM;
+	}
+	return 0;
+}
+late_initcall(early_suspend_debug_init);
+#endif
@@ -17,6 +17,8 @@
 #include <linux/module.h>
 #include <linux/wakelock.h>
 #include <linux/slab.h>
+#include <linux/dcache.h>
+#include <linux/hash.h>
 
 #include "power.h"
 
@@ -39,12 +41,28 @@ struct user_wake_lock {
 };
 struct rb_root user_wake_locks;
 
+/*
+ * User wake locks are never freed, so recently used ones are remembered by
+ * name hash and repeated writes of the same name skip the rbtree walk.
+ */
+#define LOOKUP_CACHE_BITS	4
+static struct user_wake_lock *lookup_cache[1 << LOOKUP_CACHE_BITS];
+
+static inline struct user_wake_lock **lookup_cache_slot(
+	const char *name, int name_len)
+{
+	unsigned int hash = full_name_hash(name, name_len);
+
+	return &lookup_cache[hash_32(hash, LOOKUP_CACHE_BITS)];
+}
+
 static struct user_wake_lock *lookup_wake_lock_name(
 	const char *buf, int allocate, long *timeoutptr)
 {
 	struct rb_node **p = &user_wake_locks.rb_node;
 	struct rb_node *parent = NULL;
 	struct user_wake_lock *l;
+	struct user_wake_lock **slot;
 	int diff;
 	u64 timeout;
 	int name_len;
@@ -78,6 +96,15 @@ static struct user_wake_lock *lookup_wake_lock_name(
 	else if (timeoutptr)
 		*timeoutptr = 0;
 
+	/* Try the cache before the rbtree */
+	slot = lookup_cache_slot(buf, name_len);
+	l = *slot;
+	if (l && !strncmp(buf, l->name, name_len) && !l->name[name_len]) {
+		if (debug_mask & DEBUG_LOOKUP)
+			pr_info("lookup_wake_lock_name: %s cached\n", l->name);
+		return l;
+	}
+
 	/* Lookup wake lock in rbtree */
 	while (*p) {
 		parent = *p;
@@ -93,8 +120,10 @@ static struct user_wake_lock *lookup_wake_lock_name(
 			p = &(*p)->rb_left;
 		else if (diff > 0)
 			p = &(*p)->rb_right;
-		else
+		else {
+			*slot = l;
 			return l;
+		}
 	}
 
 	/* Allocate and add new wakelock to rbtree */
@@ -117,6 +146,7 @@ static struct user_wake_lock *lookup_wake_lock_name(
 	wake_lock_init(&l->wake_lock, WAKE_LOCK_SUSPEND, l->name);
 	rb_link_node(&l->node, parent, p);
 	rb_insert_color(&l->node, &user_wake_locks);
+	*slot = l;
 	return l;
 
 bad_arg:
@@ -43,6 +43,15 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+/*
+ * Active locks without a timeout are only counted. Active locks with a
+ * timeout are also kept in a tree ordered by expiry, so the next lock to
+ * expire and the last one are found without walking the active list.
+ * The counts change under list_lock but may be read without it.
+ */
+static atomic_t untimed_active[WAKE_LOCK_TYPE_COUNT];
+static atomic_t timed_active[WAKE_LOCK_TYPE_COUNT];
+static struct rb_root timed_wake_locks[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 static int suspend_sys_sync_count;
 static DEFINE_SPINLOCK(suspend_sys_sync_lock);
@@ -198,12 +207,49 @@ static void update_sleep_wait_stats_locked(int done)
 }
 #endif
 
+/* Caller must acquire the list_lock spinlock */
+static void wake_lock_enqueue_locked(struct wake_lock *lock, int type)
+{
+	struct rb_node **p = &timed_wake_locks[type].rb_node;
+	struct rb_node *parent = NULL;
+	struct wake_lock *l;
+
+	if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE)) {
+		atomic_inc(&untimed_active[type]);
+		return;
+	}
+	while (*p) {
+		parent = *p;
+		l = rb_entry(parent, struct wake_lock, expire_node);
+		if (time_before(lock->expires, l->expires))
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+	rb_link_node(&lock->expire_node, parent, p);
+	rb_insert_color(&lock->expire_node, &timed_wake_locks[type]);
+	atomic_inc(&timed_active[type]);
+}
+
+/* Caller must acquire the list_lock spinlock */
+static void wake_lock_dequeue_locked(struct wake_lock *lock, int type)
+{
+	if (!(lock->flags & WAKE_LOCK_ACTIVE))
+		return;
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
+		rb_erase(&lock->expire_node, &timed_wake_locks[type]);
+		atomic_dec(&timed_active[type]);
+	} else {
+		atomic_dec(&untimed_active[type]);
+	}
+}
 
 static void expire_wake_lock(struct wake_lock *lock)
 {
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
+	wake_lock_dequeue_locked(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
@@ -236,27 +282,44 @@ static void print_active_locks(int type)
 
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct rb_node *n;
+	struct wake_lock *lock;
+	unsigned long now = jiffies;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	if (atomic_read(&untimed_active[type]))
+		return -1;
+	/* Timed out locks are only retired here, earliest first */
+	while ((n = rb_first(&timed_wake_locks[type]))) {
+		lock = rb_entry(n, struct wake_lock, expire_node);
+		if (time_after(lock->expires, now))
+			break;
+		expire_wake_lock(lock);
 	}
-	return max_timeout;
+	n = rb_last(&timed_wake_locks[type]);
+	if (!n)
+		return 0;
+	lock = rb_entry(n, struct wake_lock, expire_node);
+	return lock->expires - now;
 }
 
 long has_wake_lock(int type)
 {
 	long ret;
 	unsigned long irqflags;
+
+	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
+	/*
+	 * Idle and suspend poll this often. Answer from the counts when
+	 * no timeout has to be checked and nothing has to be printed.
+	 */
+	if (!atomic_read(&untimed_active[type]) &&
+	    !atomic_read(&timed_active[type]))
+		return 0;
+	if (atomic_read(&untimed_active[type]) &&
+	    !(type == WAKE_LOCK_SUSPEND && (debug_mask & DEBUG_WAKEUP)))
+		return -1;
+
 	spin_lock_irqsave(&list_lock, irqflags);
 	ret = has_wake_lock_locked(type);
 	if (ret && (debug_mask & DEBUG_WAKEUP) && type == WAKE_LOCK_SUSPEND)
@@ -466,7 +529,9 @@ void wake_lock_destroy(struct wake_lock *lock)
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
-	lock->flags &= ~WAKE_LOCK_INITIALIZED;
+	wake_lock_dequeue_locked(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
+	lock->flags &= ~(WAKE_LOCK_INITIALIZED | WAKE_LOCK_ACTIVE |
+			 WAKE_LOCK_AUTO_EXPIRE);
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
 		deleted_wake_locks.stat.count += lock->stat.count;
@@ -511,6 +576,7 @@ static void wake_lock_internal(
 		lock->stat.last_time = ktime_get();
 	}
 #endif
+	wake_lock_dequeue_locked(lock, type);
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
@@ -533,6 +599,7 @@ static void wake_lock_internal(
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
 		list_add(&lock->link, &active_wake_locks[type]);
 	}
+	wake_lock_enqueue_locked(lock, type);
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
 #ifdef CONFIG_WAKELOCK_STAT
@@ -585,6 +652,7 @@ void wake_unlock(struct wake_lock *lock)
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	wake_lock_dequeue_locked(lock, type);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
@@ -1097,6 +1097,7 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 		cond_resched();
 find_page:
 		page = find_get_page(mapping, index);
+		readahead_trace_access(filp, index, page != NULL);
 		if (!page) {
 			page_cache_sync_readahead(mapping,
 					ra, filp,
@@ -1640,6 +1641,7 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	 * Do we have something in the page cache already?
 	 */
 	page = find_get_page(mapping, offset);
+	readahead_trace_access(file, offset, page != NULL);
 	if (likely(page)) {
 		/*
 		 * We found the page, so try async readahead before
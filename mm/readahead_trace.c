@@ -0,0 +1,387 @@
+/*
+ * mm/readahead_trace.c - record file access traces and replay them as
+ * readahead
+ *
+ * Readahead only detects sequential streams, but starting an application
+ * faults in scattered pages of a few large files, one synchronous read
+ * at a time.  While a process is being recorded, every page it reads or
+ * faults in is added to a trace for its file, keyed by device, inode
+ * number and generation.  When recording stops the traces are sorted and
+ * merged into ranges.  The next time a file with a trace misses in the
+ * page cache, the whole trace is read ahead in one batch, so the I/O of
+ * a cold start is issued up front instead of behind each page fault.
+ *
+ * Controlled and accounted through /sys/kernel/mm/readahead_trace/, see
+ * Documentation/ABI/testing/sysfs-kernel-mm-readahead_trace.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/hash.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/jiffies.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/init.h>
+
+#define RA_TRACE_HASH_BITS		8
+#define RA_TRACE_MAX_FILES		1024
+#define RA_TRACE_MAX_PAGES		8192	/* Recorded per file */
+#define RA_TRACE_MERGE_GAP		4	/* Pages read to join ranges */
+#define RA_TRACE_REPLAY_INTERVAL	(10 * HZ)
+
+/* file->f_ra.trace */
+enum {
+	RA_TRACE_UNKNOWN,		/* Not looked up yet */
+	RA_TRACE_NONE,			/* The file has no trace */
+	RA_TRACE_REPLAYED,		/* The file's trace has been replayed */
+};
+
+struct ra_trace_range {
+	pgoff_t			start;
+	unsigned long		len;
+};
+
+struct ra_trace {
+	struct hlist_node	hash;
+	dev_t			dev;
+	unsigned long		ino;
+	u32			generation;
+	loff_t			size;
+	unsigned int		session;	/* Session that recorded it */
+	pgoff_t			*pages;		/* While recording */
+	unsigned int		nr_pages;
+	unsigned int		max_pages;
+	struct ra_trace_range	*ranges;	/* Once recording stopped */
+	unsigned int		nr_ranges;
+	unsigned long		replayed;	/* jiffies of the last replay */
+};
+
+static DEFINE_MUTEX(ra_trace_mutex);
+static struct hlist_head ra_trace_hash[1 << RA_TRACE_HASH_BITS];
+static unsigned int ra_trace_files;
+static unsigned int ra_trace_session;
+static pid_t ra_trace_tgid;		/* Process being recorded, or 0 */
+static int ra_trace_replay = 1;
+int readahead_trace_active __read_mostly;
+
+static unsigned long ra_trace_recorded_pages;
+static unsigned long ra_trace_replays;
+static atomic_long_t ra_trace_replayed_pages = ATOMIC_LONG_INIT(0);
+static atomic_long_t ra_trace_hits = ATOMIC_LONG_INIT(0);
+static atomic_long_t ra_trace_misses = ATOMIC_LONG_INIT(0);
+
+static void ra_trace_update_active(void)
+{
+	readahead_trace_active = ra_trace_tgid || ra_trace_files;
+}
+
+static void ra_trace_free(struct ra_trace *t)
+{
+	hlist_del(&t->hash);
+	kfree(t->pages);
+	kfree(t->ranges);
+	kfree(t);
+	ra_trace_files--;
+	ra_trace_update_active();
+}
+
+/*
+ * Find the trace of @inode, dropping one left by a file since replaced,
+ * and create an empty one if @create is set.
+ */
+static struct ra_trace *ra_trace_find(struct inode *inode, int create)
+{
+	dev_t dev = inode->i_sb->s_dev;
+	struct hlist_head *head;
+	struct hlist_node *node;
+	struct ra_trace *t;
+
+	head = &ra_trace_hash[hash_long(inode->i_ino ^ dev,
+					RA_TRACE_HASH_BITS)];
+	hlist_for_each_entry(t, node, head, hash) {
+		if (t->dev != dev || t->ino != inode->i_ino)
+			continue;
+		if (t->generation == inode->i_generation &&
+		    t->size == i_size_read(inode))
+			return t;
+		ra_trace_free(t);
+		break;
+	}
+
+	if (!create || ra_trace_files >= RA_TRACE_MAX_FILES)
+		return NULL;
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return NULL;
+	t->dev = dev;
+	t->ino = inode->i_ino;
+	t->generation = inode->i_generation;
+	t->size = i_size_read(inode);
+	t->session = ra_trace_session;
+	hlist_add_head(&t->hash, head);
+	ra_trace_files++;
+	ra_trace_update_active();
+	return t;
+}
+
+static void ra_trace_record(struct inode *inode, pgoff_t index)
+{
+	struct ra_trace *t = ra_trace_find(inode, 1);
+	pgoff_t *pages;
+	unsigned int max;
+
+	if (!t)
+		return;
+	if (t->session != ra_trace_session) {
+		/* Recorded again: the new trace replaces the old one */
+		kfree(t->ranges);
+		t->ranges = NULL;
+		t->nr_ranges = 0;
+		t->session = ra_trace_session;
+	}
+	if (t->nr_pages && t->pages[t->nr_pages - 1] == index)
+		return;
+	if (t->nr_pages == t->max_pages) {
+		if (t->max_pages >= RA_TRACE_MAX_PAGES)
+			return;
+		max = t->max_pages ? t->max_pages * 2 : 16;
+		pages = krealloc(t->pages, max * sizeof(*pages), GFP_KERNEL);
+		if (!pages)
+			return;
+		t->pages = pages;
+		t->max_pages = max;
+	}
+	t->pages[t->nr_pages++] = index;
+	ra_trace_recorded_pages++;
+}
+
+static int ra_trace_cmp(const void *a, const void *b)
+{
+	pgoff_t x = *(const pgoff_t *)a, y = *(const pgoff_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Turn the pages recorded for @t into sorted, merged ranges */
+static void ra_trace_finish(struct ra_trace *t)
+{
+	struct ra_trace_range *r;
+	unsigned int i, n;
+
+	sort(t->pages, t->nr_pages, sizeof(*t->pages), ra_trace_cmp, NULL);
+	for (i = 0, n = 0; i < t->nr_pages; i++)
+		if (!i || t->pages[i] > t->pages[i - 1] + RA_TRACE_MERGE_GAP)
+			n++;
+
+	r = kmalloc(n * sizeof(*r), GFP_KERNEL);
+	if (r) {
+		for (i = 0, n = 0; i < t->nr_pages; i++) {
+			if (n && t->pages[i] <= r[n - 1].start +
+					r[n - 1].len - 1 + RA_TRACE_MERGE_GAP) {
+				r[n - 1].len = t->pages[i] - r[n - 1].start + 1;
+				continue;
+			}
+			r[n].start = t->pages[i];
+			r[n].len = 1;
+			n++;
+		}
+		t->ranges = r;
+		t->nr_ranges = n;
+	}
+	t->replayed = jiffies - RA_TRACE_REPLAY_INTERVAL;
+	kfree(t->pages);
+	t->pages = NULL;
+	t->nr_pages = t->max_pages = 0;
+}
+
+static void ra_trace_stop(void)
+{
+	struct hlist_node *node, *tmp;
+	struct ra_trace *t;
+	int i;
+
+	for (i = 0; i < (1 << RA_TRACE_HASH_BITS); i++)
+		hlist_for_each_entry_safe(t, node, tmp, &ra_trace_hash[i],
+					  hash) {
+			if (t->pages)
+				ra_trace_finish(t);
+			if (!t->ranges)
+				ra_trace_free(t);
+		}
+	ra_trace_tgid = 0;
+	ra_trace_update_active();
+}
+
+/*
+ * Called for every page cache lookup of a read() or a page fault on
+ * @file, @cached telling whether the page at @index was found.
+ */
+void __readahead_trace_access(struct file *file, pgoff_t index, int cached)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct file_ra_state *ra = &file->f_ra;
+	struct ra_trace_range *ranges = NULL;
+	unsigned int i, nr = 0;
+	struct ra_trace *t;
+	int ret;
+
+	if (ra_trace_tgid && current->tgid == ra_trace_tgid) {
+		mutex_lock(&ra_trace_mutex);
+		if (current->tgid == ra_trace_tgid)
+			ra_trace_record(inode, index);
+		mutex_unlock(&ra_trace_mutex);
+		return;
+	}
+
+	if (ra->trace == RA_TRACE_REPLAYED) {
+		if (cached)
+			atomic_long_inc(&ra_trace_hits);
+		else
+			atomic_long_inc(&ra_trace_misses);
+		return;
+	}
+	if (cached || ra->trace == RA_TRACE_NONE || !ra_trace_replay)
+		return;
+
+	mutex_lock(&ra_trace_mutex);
+	t = ra_trace_find(inode, 0);
+	if (!t) {
+		ra->trace = RA_TRACE_NONE;
+	} else if (t->ranges) {
+		ra->trace = RA_TRACE_REPLAYED;
+		if (time_after_eq(jiffies,
+				  t->replayed + RA_TRACE_REPLAY_INTERVAL)) {
+			ranges = kmemdup(t->ranges,
+					 t->nr_ranges * sizeof(*ranges),
+					 GFP_KERNEL);
+			if (ranges) {
+				nr = t->nr_ranges;
+				t->replayed = jiffies;
+				ra_trace_replays++;
+			}
+		}
+	}
+	mutex_unlock(&ra_trace_mutex);
+
+	if (ra->trace != RA_TRACE_REPLAYED)
+		return;
+	atomic_long_inc(&ra_trace_misses);
+	for (i = 0; i < nr; i++) {
+		ret = force_page_cache_readahead(file->f_mapping, file,
+						 ranges[i].start,
+						 ranges[i].len);
+		if (ret > 0)
+			atomic_long_add(ret, &ra_trace_replayed_pages);
+	}
+	kfree(ranges);
+}
+
+/* see Documentation/ABI/testing/sysfs-kernel-mm-readahead_trace */
+
+static ssize_t record_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", ra_trace_tgid);
+}
+
+static ssize_t record_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct hlist_node *node, *tmp;
+	struct ra_trace *t;
+	int err, pid, i;
+
+	err = kstrtoint(buf, 10, &pid);
+	if (err || pid < -1)
+		return -EINVAL;
+
+	mutex_lock(&ra_trace_mutex);
+	if (ra_trace_tgid)
+		ra_trace_stop();
+	if (pid == -1) {
+		for (i = 0; i < (1 << RA_TRACE_HASH_BITS); i++)
+			hlist_for_each_entry_safe(t, node, tmp,
+						  &ra_trace_hash[i], hash)
+				ra_trace_free(t);
+	} else if (pid) {
+		ra_trace_session++;
+		ra_trace_tgid = pid;
+		ra_trace_update_active();
+	}
+	mutex_unlock(&ra_trace_mutex);
+
+	return count;
+}
+static struct kobj_attribute record_attr =
+	__ATTR(record, 0644, record_show, record_store);
+
+static ssize_t replay_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", ra_trace_replay);
+}
+
+static ssize_t replay_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	int err, val;
+
+	err = kstrtoint(buf, 10, &val);
+	if (err || val < 0 || val > 1)
+		return -EINVAL;
+	ra_trace_replay = val;
+
+	return count;
+}
+static struct kobj_attribute replay_attr =
+	__ATTR(replay, 0644, replay_show, replay_store);
+
+#define RA_TRACE_ATTR_RO(_name, _value)					\
+	static ssize_t _name##_show(struct kobject *kobj,		\
+				    struct kobj_attribute *attr,	\
+				    char *buf)				\
+	{								\
+		return sprintf(buf, "%lu\n", (unsigned long)(_value));	\
+	}								\
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+
+RA_TRACE_ATTR_RO(files, ra_trace_files);
+RA_TRACE_ATTR_RO(recorded_pages, ra_trace_recorded_pages);
+RA_TRACE_ATTR_RO(replays, ra_trace_replays);
+RA_TRACE_ATTR_RO(replayed_pages, atomic_long_read(&ra_trace_replayed_pages));
+RA_TRACE_ATTR_RO(hits, atomic_long_read(&ra_trace_hits));
+RA_TRACE_ATTR_RO(misses, atomic_long_read(&ra_trace_misses));
+
+static struct attribute *ra_trace_attrs[] = {
+	&record_attr.attr,
+	&replay_attr.attr,
+	&files_attr.attr,
+	&recorded_pages_attr.attr,
+	&replays_attr.attr,
+	&replayed_pages_attr.attr,
+	&hits_attr.attr,
+	&misses_attr.attr,
+	NULL,
+};
+
+static struct attribute_group ra_trace_attr_group = {
+	.attrs = ra_trace_attrs,
+	.name = "readahead_trace",
+};
+
+static int __init readahead_trace_init(void)
+{
+	int i;
+
+	for (i = 0; i < (1 << RA_TRACE_HASH_BITS); i++)
+		INIT_HLIST_HEAD(&ra_trace_hash[i]);
+	return sysfs_create_group(mm_kobj, &ra_trace_attr_group);
+}
+module_init(readahead_trace_init)
@@ -0,0 +1,188 @@
+/*
+ * fsync-lat: measure fsync() latency under an SQLite-like workload
+ *
+ * Each transaction appends one page to a write-ahead log and fsyncs it,
+ * then overwrites a few random pages of a preallocated database file and
+ * fsyncs that, the way SQLite does in WAL mode with synchronous=FULL.
+ * The latency of every fsync() is recorded and summarized at the end.
+ *
+ * Run it on an ext4 file system mounted with and without
+ * journal_fast_commit and compare; /proc/fs/jbd2/<dev>/info shows how
+ * many of the fsyncs were fast commits.
+ *
+ * Compile by:
+ *
+ * gcc -O2 -o fsync-lat fsync-lat.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+static int page_size = 4096;
+static int db_pages = 1024;
+static int pages_per_txn = 2;
+static int transactions = 1000;
+
+static unsigned long *lat;
+static int nr_lat;
+
+static void usage(void)
+{
+	printf("fsync-lat [-d dir] [-t transactions] [-p pages per transaction]\n"
+		"          [-s page size] [-S database pages]\n"
+		"\n"
+		"-d|--dir          Directory for the test files (default .)\n"
+		"-t|--transactions Number of transactions (default %d)\n"
+		"-p|--pages        Database pages written per transaction (default %d)\n"
+		"-s|--page-size    Page size in bytes (default %d)\n"
+		"-S|--db-pages     Size of the database file in pages (default %d)\n",
+		transactions, pages_per_txn, page_size, db_pages);
+}
+
+static void fatal(const char *msg)
+{
+	fprintf(stderr, "fsync-lat: %s: %s\n", msg, strerror(errno));
+	exit(1);
+}
+
+static unsigned long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+static void timed_fsync(int fd)
+{
+	unsigned long start = now_us();
+
+	if (fsync(fd))
+		fatal("fsync");
+	lat[nr_lat++] = now_us() - start;
+}
+
+static void pwrite_all(int fd, const char *buf, size_t len, off_t off)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = pwrite(fd, buf, len, off);
+		if (ret < 0)
+			fatal("pwrite");
+		buf += ret;
+		len -= ret;
+		off += ret;
+	}
+}
+
+static int cmp_ulong(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option opts[] = {
+		{ "dir", 1, NULL, 'd' },
+		{ "transactions", 1, NULL, 't' },
+		{ "pages", 1, NULL, 'p' },
+		{ "page-size", 1, NULL, 's' },
+		{ "db-pages", 1, NULL, 'S' },
+		{ "help", 0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const char *dir = ".";
+	char db_name[4096], wal_name[4096];
+	unsigned long long total = 0;
+	off_t wal_off = 0;
+	int db, wal;
+	char *buf;
+	int c, i, j;
+
+	while ((c = getopt_long(argc, argv, "d:t:p:s:S:h", opts, NULL)) != -1) {
+		switch (c) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 't':
+			transactions = atoi(optarg);
+			break;
+		case 'p':
+			pages_per_txn = atoi(optarg);
+			break;
+		case 's':
+			page_size = atoi(optarg);
+			break;
+		case 'S':
+			db_pages = atoi(optarg);
+			break;
+		default:
+			usage();
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (transactions <= 0 || pages_per_txn <= 0 || page_size <= 0 ||
+	    db_pages <= 0) {
+		usage();
+		return 1;
+	}
+
+	snprintf(db_name, sizeof(db_name), "%s/fsync-lat.db", dir);
+	snprintf(wal_name, sizeof(wal_name), "%s/fsync-lat.db-wal", dir);
+
+	buf = malloc(page_size);
+	lat = malloc(sizeof(*lat) * transactions * 2);
+	if (!buf || !lat)
+		fatal("malloc");
+	memset(buf, 0x5a, page_size);
+
+	db = open(db_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (db < 0)
+		fatal(db_name);
+	wal = open(wal_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (wal < 0)
+		fatal(wal_name);
+
+	/* allocate the database up front, as a long-lived database would be */
+	for (i = 0; i < db_pages; i++)
+		pwrite_all(db, buf, page_size, (off_t)i * page_size);
+	if (fsync(db))
+		fatal("fsync");
+
+	srand(1);
+	for (i = 0; i < transactions; i++) {
+		buf[0] = i;
+		pwrite_all(wal, buf, page_size, wal_off);
+		wal_off += page_size;
+		timed_fsync(wal);
+
+		for (j = 0; j < pages_per_txn; j++)
+			pwrite_all(db, buf, page_size,
+				   (off_t)(rand() % db_pages) * page_size);
+		timed_fsync(db);
+	}
+
+	close(wal);
+	close(db);
+	unlink(wal_name);
+	unlink(db_name);
+
+	qsort(lat, nr_lat, sizeof(*lat), cmp_ulong);
+	for (i = 0; i < nr_lat; i++)
+		total += lat[i];
+	printf("%d fsyncs: min %luus avg %lluus p50 %luus p99 %luus max %luus\n",
+	       nr_lat, lat[0], total / nr_lat, lat[nr_lat / 2],
+	       lat[nr_lat * 99 / 100], lat[nr_lat - 1]);
+	return 0;
+}